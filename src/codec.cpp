@@ -0,0 +1,582 @@
+/**
+ * @file      codec.cpp
+ * @brief     Codecs of the streams of a chunk
+ * @author    Morteza Hosseini  (seyedmorteza@ua.pt)
+ * @author    Diogo Pratas      (pratas@ua.pt)
+ * @author    Armando J. Pinho  (ap@ua.pt)
+ * @copyright The GNU General Public License v3.0
+ */
+
+#include <algorithm>
+#include <memory>
+#include "codec.hpp"
+#include "assert.hpp"
+#include "cryptopp/zdeflate.h"
+#include "cryptopp/zinflate.h"
+#include "cryptopp/filters.h"
+using CryptoPP::Deflator;
+using CryptoPP::Inflator;
+using CryptoPP::StringSink;
+
+/**
+ * @brief Append an unsigned integer, 7 bits in each byte. The high bit is set
+ *        in all bytes, except the last one
+ * @param[out] out  Output
+ * @param[in]  n    Integer
+ */
+void put_varint (string& out, u64 n) {
+  for (; n >= 0x80; n >>= 7)    out += (char) ((n & 0x7F) | 0x80);
+  out += (char) n;
+}
+
+/**
+ * @brief  Read an unsigned integer, written by put_varint
+ * @param  i    Input iterator. It goes to the byte after the integer
+ * @param  end  End of the input
+ * @return Integer
+ */
+u64 get_varint (citer_t& i, citer_t end) {
+  u64 n = 0;
+  for (byte shift = 0; shift < 64; shift += 7) {
+    assert(i == end, WRONG_KEY);
+    const auto b = (byte) *i++;
+    n |= (u64) (b & 0x7F) << shift;
+    if (!(b & 0x80))    return n;
+  }
+  throw runtime_error(WRONG_KEY);
+}
+
+/**
+ * @brief  Read a number of items, each one of 1 byte at least, written by
+ *         put_varint
+ * @param  i    Input iterator. It goes to the byte after the integer
+ * @param  end  End of the input
+ * @return Number of items, no more than the bytes left
+ */
+u64 get_count (citer_t& i, citer_t end) {
+  const u64 n = get_varint(i, end);
+  assert(n > (u64) (end - i), WRONG_KEY);
+  return n;
+}
+
+/**
+ * @brief  Encapsulate 4 DNA bases in 1 byte, when there are only A, C, G, T.
+ *         The lengths of the lines come first
+ * @param  out   Output
+ * @param  text  Lines of bases, each one ending with '\n'
+ * @return false, if a symbol is not A, C, G, T or '\n'
+ */
+bool two_bit_encode (string& out, const string& text) {
+  byte code[256];
+  std::fill(code, code+256, 255);
+  code['A']=0;    code['C']=1;    code['G']=2;    code['T']=3;
+
+  string bases;    bases.reserve(text.size());
+  vector<u64> lens;
+  u64 len = 0;
+  for (char c : text) {
+    if (c == '\n') { lens.push_back(len);    len = 0; }
+    else if (code[(byte) c] == 255)    return false;
+    else { bases += c;    ++len; }
+  }
+
+  put_varint(out, lens.size());
+  for (u64 l : lens)    put_varint(out, l);
+
+  byte b = 0;
+  u64  n = 0;
+  for (char c : bases) {
+    b = (byte) (b << 2 | code[(byte) c]);
+    if (++n % 4 == 0) { out += (char) b;    b = 0; }
+  }
+  if (n % 4)    out += (char) (b << 2*(4 - n%4));    // Last byte, left aligned
+  return true;
+}
+
+/**
+ * @brief Unpack 1 byte to 4 DNA bases
+ * @param[out] text  Lines of bases, each one ending with '\n'
+ * @param[in]  beg   Beginning of the encoded stream
+ * @param[in]  end   End of the encoded stream
+ */
+void two_bit_decode (string& text, citer_t beg, citer_t end) {
+  static const char base[4] = {'A', 'C', 'G', 'T'};
+  auto i = beg;
+  vector<u64> lens(get_count(i, end));
+  const u64 maxBases = 4 * (u64) (end - beg);
+  u64 total = 0;
+  for (auto& l : lens) {
+    l = get_varint(i, end);
+    assert(l > maxBases - total, WRONG_KEY);
+    total += l;
+  }
+  assert((u64) (end - i) != (total + 3) / 4, WRONG_KEY);
+
+  byte shift = 0;    // Bases of the current byte, already unpacked
+  for (u64 l : lens) {
+    for (; l--; shift = (byte) ((shift + 1) % 4)) {
+      text += base[((byte) *i >> (6 - 2*shift)) & 3];
+      if (shift == 3)    ++i;
+    }
+    text += '\n';
+  }
+}
+
+/**
+ * @brief Range asymmetric numeral system (rANS), order-0. Byte frequencies,
+ *        scaled to RANS_TOTAL, then the state goes to bytes in reverse order
+ * @param[out] out   Output
+ * @param[in]  text  Input
+ */
+void rans_encode (string& out, const string& text) {
+  u64 count[256] = {0};
+  for (char c : text)    ++count[(byte) c];
+
+  // Scale the frequencies. Each symbol in the text keeps a frequency >= 1.
+  // What the rounding leaves, or takes, goes to the most frequent symbols
+  u32 freq[256] = {0};
+  u32 sum = 0;
+  for (u16 s = 0; s != 256; ++s)
+    if (count[s]) {
+      freq[s] = std::max((u32) (count[s] * RANS_TOTAL / text.size()), 1u);
+      sum += freq[s];
+    }
+  if (!text.empty()) {
+    byte order[256];
+    for (u16 s = 0; s != 256; ++s)    order[s] = (byte) s;
+    std::stable_sort(order, order+256,
+                     [&freq] (byte a, byte b) { return freq[a] > freq[b]; });
+    if (sum < RANS_TOTAL)    freq[order[0]] += RANS_TOTAL - sum;
+    for (u16 k = 0; sum > RANS_TOTAL; ++k) {
+      const u32 take = std::min(sum - RANS_TOTAL, freq[order[k]] - 1);
+      freq[order[k]] -= take;
+      sum            -= take;
+    }
+  }
+  u32 start[256];
+  for (u32 s = 0, c = 0; s != 256; c += freq[s++])    start[s] = c;
+
+  // Header: size of text and (symbol, frequency) pairs
+  put_varint(out, text.size());
+  put_varint(out, (u64) std::count_if(freq, freq+256,
+                                      [] (u32 f) { return f != 0; }));
+  for (u16 s = 0; s != 256; ++s)
+    if (freq[s]) { out += (char) s;    put_varint(out, freq[s]); }
+
+  // Encode backwards, so that the decoder goes forwards
+  string rev;    rev.reserve(text.size());
+  u32 x = RANS_L;
+  for (auto i = text.rbegin(); i != text.rend(); ++i) {
+    const auto s = (byte) *i;
+    const u32  xMax = ((RANS_L >> RANS_SCALE_BITS) << 8) * freq[s];
+    for (; x >= xMax; x >>= 8)    rev += (char) (x & 0xFF);
+    x = ((x / freq[s]) << RANS_SCALE_BITS) + (x % freq[s]) + start[s];
+  }
+  for (byte b = 4; b--;)    rev += (char) (x >> 8*b);
+  out.append(rev.rbegin(), rev.rend());
+}
+
+/**
+ * @brief Range asymmetric numeral system (rANS), order-0
+ * @param[out] text  Output
+ * @param[in]  beg   Beginning of the encoded stream
+ * @param[in]  end   End of the encoded stream
+ */
+void rans_decode (string& text, citer_t beg, citer_t end) {
+  auto i = beg;
+  u64  size = get_varint(i, end);
+  u32  freq[256] = {0},  start[256] = {0};
+  u64  sum = 0;
+  for (u64 n = get_varint(i, end); n--;) {
+    assert(n >= 256 || i == end, WRONG_KEY);
+    const auto s = (byte) *i++;
+    const u64  f = get_varint(i, end);
+    assert(freq[s] || f > RANS_TOTAL, WRONG_KEY);
+    sum += freq[s] = (u32) f;
+  }
+  // The slots are filled by the frequencies, which sum up to RANS_TOTAL
+  assert(size && (sum != RANS_TOTAL || end - i < 4), WRONG_KEY);
+  byte slotSym[RANS_TOTAL];
+  for (u32 s = 0, c = 0; s != 256; c += freq[s++]) {
+    start[s] = c;
+    std::fill(slotSym+c, slotSym+c+freq[s], (byte) s);
+  }
+
+  // The state stays >= RANS_L, and is RANS_L at the end, as the encoder
+  // began, with all the bytes read
+  u32 x = 0;
+  for (byte b = 0; b != 4; ++b)    x |= (u32) (byte) *i++ << 8*b;
+  assert(x < RANS_L, WRONG_KEY);
+  // Reserved up to a bound by the bytes, before the size can be trusted
+  text.reserve(text.size() + std::min(size, RANS_TOTAL * (u64) (end - beg)));
+  for (; size--;) {
+    const u32  slot = x & (RANS_TOTAL - 1);
+    const byte s    = slotSym[slot];
+    text += (char) s;
+    x = freq[s] * (x >> RANS_SCALE_BITS) + slot - start[s];
+    for (; x < RANS_L && i != end; ++i)    x = x << 8 | (byte) *i;
+    assert(x < RANS_L, WRONG_KEY);
+  }
+  assert(x != RANS_L || i != end, WRONG_KEY);
+}
+
+/**
+ * @brief Deflate (LZ77 + Huffman), by Crypto++
+ * @param[out] out    Output
+ * @param[in]  text   Input
+ * @param[in]  level  1 (fast) to 9 (small)
+ */
+void deflate_encode (string& out, const string& text, byte level) {
+  // A deflator of each thread, for the streams of all chunks. It is reset at
+  // the end of each message, so its tables are made once
+  thread_local std::unique_ptr<Deflator> deflator;
+  thread_local byte deflLevel = 0;
+  if (!deflator || deflLevel != level) {
+    deflator.reset(new Deflator(nullptr, level));
+    deflLevel = level;
+  }
+  deflator->Detach(new StringSink(out));
+  deflator->Put((const byte*) text.data(), text.size());
+  deflator->MessageEnd();
+  deflator->Detach();
+}
+
+/**
+ * @brief Inflate, by Crypto++
+ * @param[out] text  Output
+ * @param[in]  beg   Beginning of the encoded stream
+ * @param[in]  end   End of the encoded stream
+ */
+void deflate_decode (string& text, citer_t beg, citer_t end) {
+  Inflator inflator(new StringSink(text));
+  try {
+    inflator.Put((const byte*) &*beg, (size_t) (end - beg));
+    inflator.MessageEnd();
+  }
+  catch (CryptoPP::Exception&) { throw runtime_error(WRONG_KEY); }
+}
+
+/**
+ * @brief  Run lengths. The symbols of the runs and their lengths are apart,
+ *         each one by rANS
+ * @param  out   Output
+ * @param  text  Input
+ * @return false, if the runs are shorter than RLE_MIN_RUN, on average
+ */
+bool rle_encode (string& out, const string& text) {
+  string sym, len;
+  for (auto i = text.begin(); i != text.end();) {
+    const char c = *i;
+    const auto run = std::find_if(i, text.end(),
+                                  [c] (char s) { return s != c; });
+    sym += c;
+    put_varint(len, (u64) (run - i));
+    i = run;
+  }
+  if (sym.size() * RLE_MIN_RUN > text.size())    return false;
+
+  string enc;
+  rans_encode(enc, sym);
+  put_varint(out, enc.size());
+  out += enc;
+  rans_encode(out, len);
+  return true;
+}
+
+/**
+ * @brief Run lengths. A run is filled at once, as by memset
+ * @param[out] text  Output
+ * @param[in]  beg   Beginning of the encoded stream
+ * @param[in]  end   End of the encoded stream
+ */
+void rle_decode (string& text, citer_t beg, citer_t end) {
+  auto i = beg;
+  const auto symSize = (i64) get_varint(i, end);
+  assert(symSize < 0 || symSize > end - i, WRONG_KEY);
+  string sym, len;
+  rans_decode(sym, i, i + symSize);
+  rans_decode(len, i + symSize, end);
+
+  u64 size = 0,  nRun = 0;
+  for (citer_t l = len.begin(); l != len.end(); ++nRun)
+    size += get_varint(l, len.end());
+  assert(nRun != sym.size(), WRONG_KEY);
+  text.reserve(text.size() + size);
+  citer_t l = len.begin();
+  for (char c : sym)    text.append(get_varint(l, len.end()), c);
+}
+
+namespace {
+/**
+ * @brief Range coder, carryless (Subbotin). Total frequency <= RC_BOT
+ */
+class RangeEncoder {
+ public:
+  explicit RangeEncoder (string& out_) : out(out_) {}
+
+  void encode (u32 cum, u32 freq, u32 total) {
+    range /= total;
+    low   += cum * range;
+    range *= freq;
+    for (; (low ^ (low+range)) < RC_TOP ||
+           (range < RC_BOT && ((range = -low & (RC_BOT-1)), true));
+         low <<= 8, range <<= 8)
+      out += (char) (low >> 24);
+  }
+
+  void flush () {
+    for (byte b = 4; b--; low <<= 8)    out += (char) (low >> 24);
+  }
+
+ private:
+  string& out;
+  u32     low   = 0;
+  u32     range = 0xFFFFFFFF;
+};
+
+/**
+ * @brief Range decoder, carryless (Subbotin)
+ */
+class RangeDecoder {
+ public:
+  RangeDecoder (citer_t beg, citer_t end_) : i(beg), end(end_) {
+    for (byte b = 4; b--;)    code = code << 8 | next();
+  }
+
+  u32 get_freq (u32 total) {
+    range /= total;
+    const u32 v = (code - low) / range;
+    return (v < total) ? v : total - 1;
+  }
+
+  void decode (u32 cum, u32 freq) {
+    low   += cum * range;
+    range *= freq;
+    for (; (low ^ (low+range)) < RC_TOP ||
+           (range < RC_BOT && ((range = -low & (RC_BOT-1)), true));
+         low <<= 8, range <<= 8)
+      code = code << 8 | next();
+  }
+
+ private:
+  citer_t i, end;
+  u32     low = 0,  range = 0xFFFFFFFF,  code = 0;
+
+  u32 next () { return (i != end) ? (byte) *i++ : 0u; }
+};
+
+/**
+ * @brief Finite-context models of DNA, of orders 2, 11, 16 and 20, mixed by
+ *        their recent performance. The same model runs in the encoder and in
+ *        the decoder, in integers, so that both see the same frequencies.
+ *        The tables are sized by the number of bases, and every worker has
+ *        its own model
+ */
+class CMModel {
+ public:
+  static constexpr byte N_MDL = 4;    /**< @brief Number of models */
+
+  explicit CMModel (u64 nBases) {
+    byte bits = 10;
+    while (bits != CM_HASH_BITS && (1ull << bits) < 2*nBases)    ++bits;
+    shift = (byte) (64 - bits);
+    for (byte m = 1; m != N_MDL; ++m)    tbl[m].assign(4ull << bits, 0);
+    tbl[0].assign(4 * 16, 0);
+    std::fill(w, w+N_MDL, 65536u / N_MDL);
+  }
+
+  /** @brief Frequencies of the next base. Sum <= RC_BOT */
+  void predict (u32 freq[4]) {
+    for (byte m = 0; m != N_MDL; ++m) {
+      const byte* c = cell(m, ctx);
+      const u32 a   = (m == 0) ? 1 : 16;     // Estimator: alpha = 1/a
+      const u32 sum = c[0] + c[1] + c[2] + c[3];
+      for (byte s = 0; s != 4; ++s)
+        p[m][s] = (u32) (((u64) (c[s]*a + 1) << 16) / (sum*a + 4));
+    }
+    for (byte s = 0; s != 4; ++s) {
+      u64 mix = 0;
+      for (byte m = 0; m != N_MDL; ++m)    mix += (u64) w[m] * p[m][s];
+      freq[s] = (u32) (mix >> 17) + 1;
+    }
+  }
+
+  /** @brief Update the weights and the counts, by the actual base */
+  void update (byte sym) {
+    u64 wp[N_MDL],  sum = 0;
+    for (byte m = 0; m != N_MDL; ++m)    sum += wp[m] = (u64) w[m] * p[m][sym];
+    for (byte m = 0; m != N_MDL; ++m)    // Bayes, then forget a little
+      w[m] = (u32) ((((wp[m] << 16) / sum) * 248 + (65536/N_MDL) * 8) >> 8);
+
+    for (byte m = 0; m != N_MDL; ++m)    count(cell(m, ctx), sym);
+    ctx = ctx << 2 | sym;
+
+    // Inverted repeats. On the other strand, the complement of the base k
+    // back follows the reverse complement of the last k bases
+    for (byte m = 1; m != N_MDL; ++m) {
+      const byte k = ORDER[m];
+      ir[m] = ir[m] >> 2 | (u64) (3 - sym) << 2*(k-1);
+      count(cell(m, ir[m]), (byte) (3 - (ctx >> 2*k & 3)));
+    }
+  }
+
+ private:
+  static constexpr byte ORDER[N_MDL] = {2, 11, 16, 20};
+  vector<byte> tbl[N_MDL];     // 4 counts per context
+  u32  p[N_MDL][4];          // Probabilities of the models, 16 bits
+  u32  w[N_MDL];             // Weights, 16 bits
+  u64  ctx   = 0;            // Last 32 bases
+  u64  ir[N_MDL] {};         // Contexts of inverted repeats
+  byte shift = 0;            // For hashing
+
+  byte* cell (byte m, u64 c) {
+    const u64 k = c & ((1ull << 2*ORDER[m]) - 1);
+    if (m == 0)    return &tbl[0][4 * k];
+    return &tbl[m][4 * ((k * 0x9E3779B97F4A7C15ull + m) >> shift)];
+  }
+
+  static void count (byte* c, byte sym) {
+    if (++c[sym] == 255)
+      for (byte s = 0; s != 4; ++s)    c[s] >>= 1;
+  }
+};
+constexpr byte CMModel::ORDER[CMModel::N_MDL];
+}
+
+/**
+ * @brief Context mixing, for sequences. The lengths of the lines, the runs of
+ *        lowercase and the runs of other symbols than A, C, G, T come first,
+ *        then the bases, by a range coder and CMModel
+ * @param[out] out   Output
+ * @param[in]  text  Lines of bases, each one ending with '\n'
+ */
+void cm_encode (string& out, const string& text) {
+  string bases;    bases.reserve(text.size());
+  vector<u64> lens;    // (length, count) runs
+  u64 len = 0;
+  for (char c : text) {
+    if (c != '\n') { bases += c;    ++len;    continue; }
+    if (!lens.empty() && lens[lens.size()-2] == len)    ++lens.back();
+    else { lens.push_back(len);    lens.push_back(1); }
+    len = 0;
+  }
+  put_varint(out, lens.size() / 2);
+  for (u64 l : lens)    put_varint(out, l);
+
+  // Lowercase runs: (gap, length)
+  string side;
+  u64 nRun = 0,  last = 0;
+  for (u64 i = 0; i != bases.size();) {
+    if (bases[i] < 'a' || bases[i] > 'z') { ++i;    continue; }
+    const u64 beg = i;
+    for (; i != bases.size() && bases[i] >= 'a' && bases[i] <= 'z'; ++i)
+      bases[i] = (char) (bases[i] - 'a' + 'A');
+    put_varint(side, beg - last);    put_varint(side, i - beg);
+    last = i;    ++nRun;
+  }
+  put_varint(out, nRun);    out += side;
+
+  // Runs of other symbols: (gap, length, symbol)
+  side.clear();    nRun = 0;    last = 0;
+  string acgt;    acgt.reserve(bases.size());
+  for (u64 i = 0; i != bases.size();) {
+    const char c = bases[i];
+    if (c=='A' || c=='C' || c=='G' || c=='T') { acgt += c;    ++i;    continue; }
+    const u64 beg = i;
+    for (; i != bases.size() && bases[i] == c; ++i);
+    put_varint(side, beg - last);    put_varint(side, i - beg);    side += c;
+    last = i;    ++nRun;
+  }
+  put_varint(out, nRun);    out += side;
+
+  CMModel      model(acgt.size());
+  RangeEncoder rc(out);
+  u32 freq[4];
+  for (char c : acgt) {
+    const byte s = (byte) ((c=='A') ? 0 : (c=='C') ? 1 : (c=='G') ? 2 : 3);
+    model.predict(freq);
+    u32 cum = 0;
+    for (byte t = 0; t != s; ++t)    cum += freq[t];
+    rc.encode(cum, freq[s], freq[0] + freq[1] + freq[2] + freq[3]);
+    model.update(s);
+  }
+  rc.flush();
+}
+
+/**
+ * @brief Context mixing, for sequences
+ * @param[out] text  Lines of bases, each one ending with '\n'
+ * @param[in]  beg   Beginning of the encoded stream
+ * @param[in]  end   End of the encoded stream
+ */
+void cm_decode (string& text, citer_t beg, citer_t end) {
+  static const char base[4] = {'A', 'C', 'G', 'T'};
+  auto i = beg;
+  vector<u64> lens(2 * get_count(i, end));
+  u64 nBases = 0;
+  for (auto l = lens.begin(); l != lens.end(); l += 2) {
+    *l = get_varint(i, end);    *(l+1) = get_varint(i, end);
+    assert(*l && *(l+1) > (~0ull - nBases) / *l, WRONG_KEY);
+    nBases += *l * *(l+1);
+  }
+
+  // The runs, each one after the previous, have to be in the bases
+  u64 pos = 0;
+  const auto run = [&i, end, nBases, &pos] (u64& gap, u64& len) {
+    gap = get_varint(i, end);    len = get_varint(i, end);
+    assert(gap > nBases - pos || len > nBases - pos - gap, WRONG_KEY);
+    pos += gap + len;
+  };
+  vector<u64> lower(2 * get_count(i, end));
+  for (auto l = lower.begin(); l != lower.end(); l += 2)    run(*l, *(l+1));
+  vector<u64> other(3 * get_count(i, end));
+  u64 nOther = 0;
+  pos = 0;
+  for (auto o = other.begin(); o != other.end(); o += 3) {
+    run(*o, *(o+1));
+    assert(i == end, WRONG_KEY);
+    *(o+2) = (byte) *i++;
+    nOther += *(o+1);
+  }
+
+  // Bases, with the other symbols in their places
+  string bases;    bases.reserve(nBases);
+  CMModel      model(nBases - nOther);
+  RangeDecoder rc(i, end);
+  u32 freq[4];
+  auto o = other.begin();
+  while (bases.size() != nBases) {
+    const u64 upTo = (o != other.end()) ? bases.size() + *o : nBases;
+    while (bases.size() != upTo) {
+      model.predict(freq);
+      const u32 total = freq[0] + freq[1] + freq[2] + freq[3];
+      const u32 f     = rc.get_freq(total);
+      byte s = 0;
+      u32  cum = 0;
+      for (; cum + freq[s] <= f; ++s)    cum += freq[s];
+      rc.decode(cum, freq[s]);
+      model.update(s);
+      bases += base[s];
+    }
+    if (o != other.end()) {
+      bases.append(*(o+1), (char) *(o+2));
+      o += 3;
+    }
+  }
+
+  // Lowercase
+  pos = 0;
+  for (auto l = lower.begin(); l != lower.end(); l += 2) {
+    pos += *l;
+    for (u64 e = pos + *(l+1); pos != e; ++pos)
+      bases[pos] = (char) (bases[pos] - 'A' + 'a');
+  }
+
+  // Lines
+  auto b = bases.begin();
+  for (auto l = lens.begin(); l != lens.end(); l += 2)
+    for (u64 n = *(l+1); n--; b += *l) {
+      text.append(b, b + *l);
+      text += '\n';
+    }
+}
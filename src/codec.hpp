@@ -0,0 +1,31 @@
+/**
+ * @file      codec.hpp
+ * @brief     Codecs of the streams of a chunk
+ * @author    Morteza Hosseini  (seyedmorteza@ua.pt)
+ * @author    Diogo Pratas      (pratas@ua.pt)
+ * @author    Armando J. Pinho  (ap@ua.pt)
+ * @copyright The GNU General Public License v3.0
+ */
+
+#ifndef CRYFA_CODEC_H
+#define CRYFA_CODEC_H
+
+#include "def.hpp"
+
+using citer_t = string::const_iterator;
+
+auto put_varint (string&, u64) -> void;
+auto get_varint (citer_t&, citer_t) -> u64;
+auto get_count (citer_t&, citer_t) -> u64;
+auto two_bit_encode (string&, const string&) -> bool;
+auto two_bit_decode (string&, citer_t, citer_t) -> void;
+auto rans_encode (string&, const string&) -> void;
+auto rans_decode (string&, citer_t, citer_t) -> void;
+auto deflate_encode (string&, const string&, byte) -> void;
+auto deflate_decode (string&, citer_t, citer_t) -> void;
+auto rle_encode (string&, const string&) -> bool;
+auto rle_decode (string&, citer_t, citer_t) -> void;
+auto cm_encode (string&, const string&) -> void;
+auto cm_decode (string&, citer_t, citer_t) -> void;
+
+#endif //CRYFA_CODEC_H
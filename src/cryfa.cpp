@@ -30,8 +30,12 @@
 #include "endecrypto.hpp"
 #include "fasta.hpp"
 #include "fastq.hpp"
+#include "vcf.hpp"
+#include "sam.hpp"
+#include "tsv.hpp"
 #include "fn.hpp"
 #include "parser.hpp"
+#include "statmutex.hpp"
 // #define __STDC_FORMAT_MACROS
 // #if defined(_MSC_VER)
 // #  include <io.h>
@@ -50,8 +54,30 @@ using std::make_shared;
 
 // Instantiation of static variables in Param structure
 bool   Param::verbose      = false;
+bool   Param::stats        = false;
+bool   Param::trace        = false;
 bool   Param::stop_shuffle = false;
 byte   Param::n_threads    = DEF_N_THR;
+u64    Param::max_memory   = 0;
+byte   Param::deflate_level = DEF_DEFL_LEVEL;
+bool   Param::level_max    = false;
+bool   Param::dedup        = false;
+bool   Param::seekable     = false;
+string Param::reorder      = "";
+string Param::reference    = "";
+string Param::qual_bin     = "";
+byte   Param::kmer_k       = 0;
+string Param::out_file     = "";
+bool   Param::stats_archive= false;
+bool   Param::cache_stats  = false;
+u64    Param::min_len      = 0;
+double Param::min_mean_qual= 0;
+double Param::max_n_frac   = 1;
+string Param::name_regex   = "";
+u64    Param::head         = 0;
+double Param::sample       = 0;
+string Param::profile_save = "";
+string Param::profile_load = "";
 string Param::in_file      = "";
 string Param::key_file     = "";
 char   Param::format       = 'n';
@@ -65,20 +91,32 @@ int main (int argc, char* argv[]) {
     auto  crypt = make_shared<EnDecrypto>();
     auto  fa    = make_shared<Fasta>();
     auto  fq    = make_shared<Fastq>();
+    auto  vcf   = make_shared<Vcf>();
+    auto  sam   = make_shared<Sam>();
+    auto  tsv   = make_shared<Tsv>();
 
     const char action = parse(par, argc, argv);
 
     // Decrypt and/or unshuffle + decompress
     if (action == 'd') {
-      crypt->decrypt();
+      if (par.head || par.sample > 0)    crypt->decrypt_part();
+      else                               crypt->decrypt();
       ifstream in(DEC_FNAME);
       switch (in.peek()) {
         case (char) 127:  cerr<<"Decompressing...\n";  fa->decompress();  break;
         case (char) 126:  cerr<<"Decompressing...\n";  fq->decompress();  break;
-        case (char) 125:  crypt->unshuffle_file();                        break;
+        case (char) 124:  cerr<<"Decompressing...\n";  vcf->decompress(); break;
+        case (char) 123:  cerr<<"Decompressing...\n";  sam->decompress(); break;
+        case (char) 122:  cerr<<"Decompressing...\n";  tsv->decompress(); break;
+        case (char) 125:
+          if (par.stats_archive)
+            throw runtime_error("Error: statistics are only for FASTA and "
+                                "FASTQ.\n");
+          crypt->unshuffle_file();                                        break;
         default:          throw runtime_error("Error: corrupted file.");
       }
       in.close();
+      if (par.verbose || par.stats)    StatMutex::print_all();
       return 0;
     }
     // Compress and/or shuffle + encrypt
@@ -86,13 +124,29 @@ int main (int argc, char* argv[]) {
       switch (par.format) {
         case 'A':    cerr<<"Compacting...\n";    fa->compress();          break;
         case 'Q':    cerr<<"Compacting...\n";    fq->compress();          break;
+        case 'V':    cerr<<"Compacting...\n";    vcf->compress();         break;
+        case 'M':    cerr<<"Compacting...\n";    sam->compress();         break;
+        case 'T':    cerr<<"Compacting...\n";    tsv->compress();         break;
         case 'n':    crypt->shuffle_file();                               break;
         default :    throw runtime_error("Error: \"" +par.in_file+ "\" is not"
-                                         " a valid FASTA or FASTQ file.\n");
+                                         " a valid FASTA, FASTQ, VCF, SAM,"
+                                         " BED, GFF or GTF file.\n");
+      }
+      if (par.verbose || par.stats)    StatMutex::print_all();
+    }
+    // Analyze, to predict category, size and time
+    else if (action == 'a') {
+      switch (par.format) {
+        case 'A':    fa->analyze();                                       break;
+        case 'Q':    fq->analyze();                                       break;
+        case 'V':    vcf->analyze();                                      break;
+        case 'M':    sam->analyze();                                      break;
+        case 'T':    tsv->analyze();                                      break;
+        default :    crypt->analyze_file();                               break;
       }
     }
   }
-  catch (std::exception& e) { cerr << e.what(); }
+  catch (std::exception& e) { cerr << e.what();    return EXIT_FAILURE; }
   catch (...) { return EXIT_FAILURE; }
 
   return 0;
@@ -70,8 +70,14 @@ static const string SH_FNAME   = "CRYFA_SH";  /**< @brief Shuffed file name */
 static const string DEC_FNAME  = "CRYFA_DEC"; /**< @brief Decrypted file name */
 static const string UPK_FNAME  = "CRYFA_UPK"; /**< @brief Unpacked file name */
 static const string USH_FNAME  = "CRYFA_USH"; /**< @brief Unshuffled file name*/
+static const string RO_FNAME   = "CRYFA_RO";  /**< @brief Reordered file name */
+static const string WRONG_KEY  = "Error: wrong key, or corrupted file.\n";
+                                   /**< @brief Of decrypting with no tag */
 constexpr byte DEF_N_THR       = 8;   /**< @brief Default number of threads */
 constexpr u64  BLOCK_SIZE      = 8 * 1024; /**< @brief To read from input file*/
+constexpr u64  CM_BLOCK_SIZE   = 4 * 1024 * 1024; /**< @brief Block, level max */
+constexpr u64  SMPL_N_BLOCK    = 64;  /**< @brief Blocks sampled, analysis */
+constexpr u64  SMPL_BLOCK_SIZE = 64 * 1024; /**< @brief Size of sampled block*/
 constexpr byte C1              = 2;   /**< @brief       Cat 1  =  2 */
 constexpr byte C2              = 3;   /**< @brief       Cat 2  =  3 */
 constexpr byte MIN_C3          = 4;   /**< @brief  4 <= Cat 3 <=  6 */
@@ -87,12 +93,99 @@ constexpr byte KEYLEN_C3       = 3;   /**< @brief 3 to 1 byte */
 constexpr byte KEYLEN_C4       = 2;   /**< @brief 2 to 1 byte */
 constexpr byte KEYLEN_C5       = 3;   /**< @brief 3 to 2 byte */
 constexpr int  TAG_SIZE        = 12;  /**< @brief GCC mode auth enc */
+constexpr u64  PK_MEM          = 4;   /**< @brief Mem per byte of chunk, pack */
+constexpr u64  UPK_MEM         = 6;   /**< @brief Mem per byte, unshuffle */
+constexpr byte HOLD_HIST_BIN   = 9;   /**< @brief Bins of lock hold times */
+constexpr u64  CODEC_SMPL      = 2 * 1024; /**< @brief Sample to pick codec */
+constexpr u64  CODEC_MIN       = 16;  /**< @brief Smaller streams: raw */
+constexpr u64  CODEC_REUSE     = 16;  /**< @brief Chunks a codec is reused */
+constexpr u64  CODEC_SLACK     = 8;   /**< @brief New trial, if 1/8 larger */
+constexpr byte CDC_RAW         = 0;   /**< @brief Codec: as it is */
+constexpr byte CDC_PACK        = 1;   /**< @brief Codec: pack by category */
+constexpr byte CDC_2BIT        = 2;   /**< @brief Codec: 4 bases in 1 byte */
+constexpr byte CDC_RANS        = 3;   /**< @brief Codec: rANS, order-0 */
+constexpr byte CDC_DEFLATE     = 4;   /**< @brief Codec: deflate */
+constexpr byte CDC_PACK_DEFL   = 5;   /**< @brief Codec: pack, then deflate */
+constexpr byte CDC_CM          = 6;   /**< @brief Codec: context mixing */
+constexpr byte CDC_REF         = 7;   /**< @brief Codec: map on reference */
+constexpr byte CDC_RLE         = 8;   /**< @brief Codec: run lengths */
+constexpr byte CDC_PACK_LEN    = 9;   /**< @brief Codec: pack, lengths first*/
+constexpr byte CDC_PACK_FIX    = 10;  /**< @brief Codec: pack, fixed rate */
+constexpr byte N_CODEC         = 11;  /**< @brief Number of codecs */
+constexpr u64  RLE_MIN_RUN     = 3;   /**< @brief Min mean run, for RLE */
+constexpr u64  PACK_PAD        = 8;   /**< @brief (char) 254s after packed */
+constexpr byte CDC_FIXED       = 0x80;/**< @brief With codec ID: fixed length*/
+constexpr byte CDC_DEDUP       = 0x40;/**< @brief With codec ID: duplicates */
+constexpr u64  DEDUP_WINDOW    = 1 << 16;  /**< @brief Max reads back, dedup */
+constexpr byte DEF_DEFL_LEVEL  = 0;   /**< @brief Default deflate level: off*/
+constexpr byte PERM_DEFL_LEVEL = 6;   /**< @brief Deflate level, read order */
+constexpr byte STRM_HDR        = 0;   /**< @brief Stream of headers */
+constexpr byte STRM_SEQ        = 1;   /**< @brief Stream of sequences */
+constexpr byte STRM_QS         = 2;   /**< @brief Stream of quality scores */
+constexpr byte STRM_LAYOUT     = 3;   /**< @brief Stream of line lengths */
+constexpr byte STRM_COL        = 4;   /**< @brief Stream of a column of text */
+constexpr byte N_STRM_KIND     = 5;   /**< @brief Kinds of streams */
+constexpr byte N_STRM          = 3;   /**< @brief Streams in a chunk */
+constexpr u32  RANS_SCALE_BITS = 12;  /**< @brief rANS frequencies: 12 bits */
+constexpr u32  RANS_TOTAL      = 1u << RANS_SCALE_BITS; /**< @brief Sum freq */
+constexpr u32  RANS_L          = 1u << 23;  /**< @brief rANS state low bound */
+constexpr byte CM_HASH_BITS    = 22;  /**< @brief Max log2 of a CM table */
+constexpr u32  RC_TOP          = 1u << 24;  /**< @brief Range coder: top */
+constexpr u32  RC_BOT          = 1u << 16;  /**< @brief Range coder: bottom */
+constexpr u64  REF_K           = 16;  /**< @brief k-mers of the reference */
+constexpr u64  REF_STEP        = 8;   /**< @brief Index a k-mer every ... */
+constexpr byte REF_CAND        = 8;   /**< @brief Max positions of a k-mer */
+constexpr u64  REF_TRY         = 64;  /**< @brief Max positions to verify */
+constexpr u64  REF_PIECE       = 512; /**< @brief Bases mapped together */
+constexpr char REF_MARK        = (char) 251; /**< @brief Reference, in header*/
+constexpr char QBIN_MARK       = (char) 250; /**< @brief Q bins, in header */
+constexpr byte PHRED_OFF       = 33;  /**< @brief Offset of Phred+33 */
+constexpr byte PHRED_MAX       = 93;  /**< @brief Max Phred+33 score */
+constexpr char PERM_MARK       = (char) 249; /**< @brief Order, in header */
+constexpr u64  RO_K            = 16;  /**< @brief k-mers of minimizers */
+constexpr u64  RO_BUCKET_SIZE  = 256 * 1024 * 1024; /**< @brief Bucket, sort */
+constexpr u64  RO_MAX_BUCKET   = 128; /**< @brief Max buckets, to sort */
+constexpr u64  RO_FD_SPARE     = 16;  /**< @brief Files kept open, not buckets*/
+constexpr u64  RO_MEM          = 2;   /**< @brief Memory/byte, sort a bucket */
+constexpr u64  RO_PAIR_SAMPLE  = 8;   /**< @brief Pairs to detect mates */
+constexpr byte KMER_PART_BITS  = 6;   /**< @brief Partitions of k-mers: 2^6 */
+constexpr char STAT_MARK       = (char) 248; /**< @brief Stats, in header */
+constexpr u64  STAT_LEN_BIN    = 32;  /**< @brief Bins of the length histogram*/
+constexpr char LINE_OPEN       = (char) 255; /**< @brief Line goes on, unpacked*/
+constexpr u64  COL_BLOCK_SIZE  = 1024 * 1024; /**< @brief Chunk, by columns */
+constexpr char CRLF_MARK       = (char) 247; /**< @brief CR LF, in header */
+constexpr char VER_MARK        = (char) 246; /**< @brief Version, in header */
+constexpr byte ARCHIVE_VER     = 2;   /**< @brief Version of the archives. 1:
+                                          no mark, no streams in a chunk */
+constexpr char NOEOL_MARK      = (char) 245; /**< @brief No LF at the end */
 
 /** @brief Command line input arguments */
 struct Param {
   static bool   verbose;          /**< @brief Verbose mode */
+  static bool   stats;            /**< @brief Print statistics at the end */
+  static bool   trace;            /**< @brief Print a trace line per chunk */
   static bool   stop_shuffle;     /**< @brief Disable shuffling */
   static byte   n_threads;        /**< @brief Number of threads */
+  static u64    max_memory;       /**< @brief Max memory (bytes). 0: no limit */
+  static byte   deflate_level;    /**< @brief Deflate level. 0: no deflate */
+  static bool   level_max;        /**< @brief Max ratio, by context mixing */
+  static bool   dedup;            /**< @brief Duplicate reads by reference */
+  static bool   seekable;         /**< @brief Sequences at a fixed rate */
+  static string reorder;          /**< @brief Reorder reads: keep/free order */
+  static string reference;        /**< @brief Reference file name */
+  static string qual_bin;         /**< @brief Binning of quality scores */
+  static byte   kmer_k;           /**< @brief k, to count k-mers. 0: off */
+  static string out_file;         /**< @brief Output file name, of k-mers */
+  static bool   stats_archive;    /**< @brief Print statistics of an archive*/
+  static bool   cache_stats;      /**< @brief Keep the statistics in header */
+  static u64    min_len;          /**< @brief Min length of a read. 0: off */
+  static double min_mean_qual;    /**< @brief Min mean Phred of a read */
+  static double max_n_frac;       /**< @brief Max fraction of N in a read */
+  static string name_regex;       /**< @brief Pattern of the names of reads */
+  static u64    head;             /**< @brief Records to unpack. 0: all */
+  static double sample;           /**< @brief Fraction of chunks. 0: all */
+  static string profile_save;     /**< @brief Profile file name, to save */
+  static string profile_load;     /**< @brief Profile file name, to load */
   static string in_file;          /**< @brief Input file name */
   static string key_file;         /**< @brief Password file name */
   static char   format;           /**< @brief Format of the input file */
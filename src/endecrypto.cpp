@@ -13,7 +13,13 @@
 #include <iomanip>      // setw, setprecision
 #include <functional>
 #include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <cmath>
+#include <limits>
 #include "endecrypto.hpp"
+#include "fn.hpp"
+#include "statmutex.hpp"
 #include "assert.hpp"
 using std::chrono::high_resolution_clock;
 using std::thread;
@@ -24,10 +30,43 @@ using std::ifstream;
 using std::ofstream;
 using std::getline;
 using std::to_string;
+using std::stoul;
 using std::stoull;
+using std::memset;
 using std::setprecision;
 
-std::mutex mutxEnDe;    /**< @brief Mutex */
+StatMutex mutxEnDe("mutxEnDe");    /**< @brief Mutex */
+StatMutex mutxErr("mutxErr");      /**< @brief Mutex of errors of threads */
+
+thread_local kstat_s EnDecrypto::chunkStat;
+thread_local string::iterator EnDecrypto::chunkEnd;
+thread_local vector<pick_s> EnDecrypto::codecPick;
+thread_local u64 EnDecrypto::strmNo = 0;
+Reference EnDecrypto::Ref;
+KmerCount EnDecrypto::Kmers;
+SeqStat   EnDecrypto::Stats;
+
+/**
+ * @brief Registry of codecs. A new codec is added at the end, so that the
+ *        IDs of the others, stored in the chunks, don't change
+ */
+const codec_s EnDecrypto::CODEC[N_CODEC] = {
+  {"raw",     &EnDecrypto::enc_raw,     &EnDecrypto::dec_raw,     false},
+  {"pack",    &EnDecrypto::enc_pack,    &EnDecrypto::dec_pack,    false},
+  {"2bit",    &EnDecrypto::enc_2bit,    &EnDecrypto::dec_2bit,    false},
+  {"rans",    &EnDecrypto::enc_rans,    &EnDecrypto::dec_rans,    false},
+  {"deflate", &EnDecrypto::enc_deflate, &EnDecrypto::dec_deflate, false},
+  {"pack+deflate",
+              &EnDecrypto::enc_pack_deflate,
+                                        &EnDecrypto::dec_pack_deflate, false},
+  {"cm",      &EnDecrypto::enc_cm,      &EnDecrypto::dec_cm,      true},
+  {"ref",     &EnDecrypto::enc_ref,     &EnDecrypto::dec_ref,     false},
+  {"rle",     &EnDecrypto::enc_rle,     &EnDecrypto::dec_rle,     true},
+  {"packlen", &EnDecrypto::enc_pack_len,
+                                        &EnDecrypto::dec_pack_len, false},
+  {"packfix", &EnDecrypto::enc_pack_fix,
+                                        &EnDecrypto::dec_pack_fix, false}
+};
 
 /**
  * @brief Build a hash table
@@ -182,6 +221,81 @@ void EnDecrypto::build_unpack_tbl (vector<string>& unpack, const string& strIn,
   }
 }
 
+/**
+ * @brief  Hash table and packing function, by the category of the chars of
+ *         a stream of headers or quality scores
+ * @param[in]  chars  Chars of the stream
+ * @param[out] cat    Chars packed. The last 39 ones, if # > 39
+ * @param[out] map    Hash table
+ * @param[in]  large  Packing function, if # > 39
+ * @return Packing function
+ */
+packFP_t EnDecrypto::cat_pack_fn (const string& chars, string& cat,
+                                  htbl_t& map, packFP_t large) {
+  const auto len = chars.length();
+  if (len > MAX_C5) {                  // If len > 39 filter the last 39 ones
+    cat = chars.substr(len - MAX_C5);
+    // ASCII char after the last char in cat -- Always <= (char) 127
+    string catX = cat;    catX += (char) (cat.back() + 1);
+    build_hash_tbl(map, catX, KEYLEN_C5);
+    return large;
+  }
+
+  cat = chars;
+  if (len > MAX_C4) {                                   // 16 <= cat 5 <= 39
+    build_hash_tbl(map, cat, KEYLEN_C5);
+    return &EnDecrypto::pack_3to2;
+  }
+  if (len > MAX_C3) {                                   // 7 <= cat 4 <= 15
+    build_hash_tbl(map, cat, KEYLEN_C4);
+    return &EnDecrypto::pack_2to1;
+  }
+  if (len == MAX_C3 || len == MID_C3 || len == MIN_C3) {// 4 <= cat 3 <= 6
+    build_hash_tbl(map, cat, KEYLEN_C3);
+    return &EnDecrypto::pack_3to1;
+  }
+  if (len == C2) {                                      // cat 2 = 3
+    build_hash_tbl(map, cat, KEYLEN_C2);
+    return &EnDecrypto::pack_5to1;
+  }
+  if (len == C1) {                                      // cat 1 = 2
+    build_hash_tbl(map, cat, KEYLEN_C1);
+    return &EnDecrypto::pack_7to1;
+  }
+  build_hash_tbl(map, cat, 1);                          // len = 1
+  return &EnDecrypto::pack_1to1;
+}
+
+/**
+ * @brief  Unpacking table and function, by the category of the chars of a
+ *         stream of headers or quality scores
+ * @param[in]  chars  Chars of the stream
+ * @param[out] tbl    Unpacking table
+ * @param[out] XChar  Extra char, if # > 39
+ * @return Unpacking function. nullptr, if # > 39
+ */
+unpackFP_t EnDecrypto::cat_unpack_fn (const string& chars,
+                                      vector<string>& tbl, char& XChar) {
+  const auto len = chars.length();
+  if (len > MAX_C5) {
+    const string cat = chars.substr(len - MAX_C5);
+    // ASCII char after the last char in cat
+    string catX = cat;    catX += (XChar = (char) (cat.back() + 1));
+    build_unpack_tbl(tbl, catX, KEYLEN_C5);
+    return nullptr;
+  }
+
+  u16 keyLen;
+  if (len > MAX_C4)                                       keyLen = KEYLEN_C5;
+  else if (len > MAX_C3)                                  keyLen = KEYLEN_C4;
+  else if (len==MAX_C3 || len==MID_C3 || len==MIN_C3)     keyLen = KEYLEN_C3;
+  else if (len == C2)                                     keyLen = KEYLEN_C2;
+  else if (len == C1)                                     keyLen = KEYLEN_C1;
+  else                                                    keyLen = 1;
+  build_unpack_tbl(tbl, chars, keyLen);
+  return (len > MAX_C4) ? &EnDecrypto::unpack_2B : &EnDecrypto::unpack_1B;
+}
+
 /**
  * @brief  Index of each DNA bases pack
  * @param  key  Key
@@ -216,6 +330,7 @@ u16 EnDecrypto::large_pack_idx (const string& key, const htbl_t& map) {
  */
 void EnDecrypto::pack_seq (string& packedSeq, const string& seq) {
   auto i = seq.begin();
+  u64  nEsc = 0;    // Number of 'X' escapes
   
   for (auto iEnd=seq.end()-2; i < iEnd; i += 3) {
     char s0 = *i,    s1 = *(i+1),    s2 = *(i+2);
@@ -233,10 +348,12 @@ void EnDecrypto::pack_seq (string& packedSeq, const string& seq) {
        ? 'X' : s2;
     
     packedSeq += dna_pack_idx(tuple);
-    if (firstNotIn)  packedSeq += s0;
-    if (secondNotIn) packedSeq += s1;
-    if (thirdNotIn)  packedSeq += s2;
+    if (firstNotIn)  { packedSeq += s0;    ++nEsc; }
+    if (secondNotIn) { packedSeq += s1;    ++nEsc; }
+    if (thirdNotIn)  { packedSeq += s2;    ++nEsc; }
   }
+  chunkStat.escSeq  += nEsc;
+  chunkStat.penalty += seq.length() % 3;
   
   // If seq len isn't multiple of 3, add (char) 255 before each sym
   switch (seq.length() % 3) {
@@ -290,6 +407,7 @@ inline void EnDecrypto::pack_large (string& packed, const string& strIn,
   // ASCII char after the last char in QUALITY_SCORES string
   const auto XChar = (char) (hdrQs.back() + 1);
   auto i = strIn.begin();
+  u64  nEsc = 0;    // Number of XChar escapes
   
   for (auto iEnd = strIn.end()-2; i < iEnd; i += 3) {
     char s0 = *i,    s1 = *(i+1),  s2 = *(i+2);
@@ -304,10 +422,12 @@ inline void EnDecrypto::pack_large (string& packed, const string& strIn,
     packed += (unsigned char) (shortTuple >> 8);      // Left byte
     packed += (unsigned char) (shortTuple & 0xFF);    // Right byte
     
-    if (firstNotIn)   packed += s0;
-    if (secondNotIn)  packed += s1;
-    if (thirdNotIn)   packed += s2;
+    if (firstNotIn)   { packed += s0;    ++nEsc; }
+    if (secondNotIn)  { packed += s1;    ++nEsc; }
+    if (thirdNotIn)   { packed += s2;    ++nEsc; }
   }
+  chunkStat.escLarge += nEsc;
+  chunkStat.penalty  += strIn.length() % 3;
   
   // If len isn't multiple of 3, add (char) 255 before each sym
   switch (strIn.length() % 3) {
@@ -341,6 +461,7 @@ void EnDecrypto::pack_3to2 (string& packed, const string& strIn,
     packed += (byte) (shortTuple >> 8);      // Left byte
     packed += (byte) (shortTuple & 0xFF);    // Right byte
   }
+  chunkStat.penalty += strIn.length() % 3;
   
   // If len isn't multiple of 3, add (char) 255 before each sym
   switch (strIn.length() % 3) {
@@ -374,7 +495,10 @@ void EnDecrypto::pack_2to1 (string& packed, const string& strIn,
   }
   
   // If len isn't multiple of 2 (it's odd), add (char) 255 before each sym
-  if (strIn.length() & 1) { packed+=(char) 255;    packed+=*i; }
+  if (strIn.length() & 1) {
+    packed+=(char) 255;    packed+=*i;
+    ++chunkStat.penalty;
+  }
 }
 
 /**
@@ -392,6 +516,7 @@ void EnDecrypto::pack_3to1 (string& packed, const string& strIn,
     tuple=*i;    tuple+=*(i+1);    tuple+=*(i+2);
     packed += (char) map.find(tuple)->second;
   }
+  chunkStat.penalty += strIn.length() % 3;
 
   // If len isn't multiple of 3, add (char) 255 before each sym
   switch (strIn.length() % 3) {
@@ -424,6 +549,7 @@ void EnDecrypto::pack_5to1 (string& packed, const string& strIn,
     tuple+=*(i+3);    tuple+=*(i+4);
     packed += (char) map.find(tuple)->second;
   }
+  chunkStat.penalty += strIn.length() % 5;
   
   // If len isn't multiple of 5, add (char) 255 before each sym
   switch (strIn.length() % 5) {
@@ -469,6 +595,7 @@ void EnDecrypto::pack_7to1 (string& packed, const string& strIn,
     tuple+=*(i+3);    tuple+=*(i+4);    tuple+=*(i+5);    tuple+=*(i+6);
     packed += (char) map.find(tuple)->second;
   }
+  chunkStat.penalty += strIn.length() % 7;
 
   // If len isn't multiple of 7, add (char) 255 before each sym
   switch (strIn.length() % 7) {
@@ -556,18 +683,25 @@ void EnDecrypto::unpack_large (string& out, string::iterator& i,
 
   while (*i != (char) 254) {
     // Hdr len not multiple of keyLen
-    if (*i == (char) 255) { out += penalty_sym(*(i+1));    i+=2; }
+    if (*i == (char) 255) {
+      out += penalty_sym(*(i+1));    i+=2;
+      ++chunkStat.penalty;
+    }
     else {
       const auto leftB   = (byte) *i;
       const auto rightB  = (byte) *(i+1);
       const u16  doubleB = leftB<<8 | rightB;    // Join two bytes
+      assert(doubleB >= unpack.size(), WRONG_KEY);
   
       const string tpl = unpack[doubleB];
       
-      if (tpl[0]!=XChar && tpl[1]!=XChar && tpl[2]!=XChar)                // ...
-      { out+=tpl;                                                        i+=2; }
+      if (tpl[0]!=XChar && tpl[1]!=XChar && tpl[2]!=XChar) {              // ...
+        out+=tpl;    i+=2;
+        continue;
+      }
+      chunkStat.escLarge += (tpl[0]==XChar) + (tpl[1]==XChar) + (tpl[2]==XChar);
       
-      else if (tpl[0]==XChar && tpl[1]!=XChar && tpl[2]!=XChar)           // X..
+      if (tpl[0]==XChar && tpl[1]!=XChar && tpl[2]!=XChar)                // X..
       { out+= penalty_sym(*(i+2));    out+=tpl[1];    out+=tpl[2];       i+=3; }
       
       else if (tpl[0]!=XChar && tpl[1]==XChar && tpl[2]!=XChar)           // .X.
@@ -606,12 +740,15 @@ void EnDecrypto::unpack_2B (string& out, string::iterator& i,
   
   for (; *i != (char) 254; i += 2) {
     // Hdr len not multiple of keyLen
-    if (*i == (char) 255)
+    if (*i == (char) 255) {
       out += penalty_sym(*(i+1));
+      ++chunkStat.penalty;
+    }
     else {
       const auto leftB   = (byte) *i;
       const auto rightB  = (byte) *(i + 1);
       const u16  doubleB = leftB << 8 | rightB;    // Join two bytes
+      assert(doubleB >= unpack.size(), WRONG_KEY);
   
       out += unpack[doubleB];
     }
@@ -630,8 +767,11 @@ void EnDecrypto::unpack_1B (string& out, string::iterator& i,
 
   for (; *i != (char) 254; ++i) {
     // Hdr len not multiple of keyLen
-    if (*i == (char) 255)    out += penalty_sym(*(++i));
-    else                     out += unpack[(byte) *i];
+    if (*i == (char) 255) { out += penalty_sym(*(++i));    ++chunkStat.penalty; }
+    else {
+      assert((byte) *i >= unpack.size(), WRONG_KEY);
+      out += unpack[(byte) *i];
+    }
   }
 }
 
@@ -644,15 +784,22 @@ void EnDecrypto::unpack_seq (string& out, string::iterator& i) {
   out.clear();
   
   for (; *i != (char) 254; ++i) {
-    if (*i == (char) 255)                       // Seq len not multiple of 3
-        out += penalty_sym(*(++i));
+    if (*i == (char) 255) {                     // Seq len not multiple of 3
+      out += penalty_sym(*(++i));
+      ++chunkStat.penalty;
+    }
     else {
+      assert((byte) *i >= DNA_UNPACK.size(), WRONG_KEY);
       const string tpl = DNA_UNPACK[(byte) *i];
       
-      if (tpl[0]!='X' && tpl[1]!='X' && tpl[2]!='X')                // ...
-      { out+=tpl;                                                        }
+      if (tpl[0]!='X' && tpl[1]!='X' && tpl[2]!='X') {              // ...
+        out+=tpl;
+        continue;
+      }
           // Using just one 'out' makes trouble
-      else if (tpl[0]=='X' && tpl[1]!='X' && tpl[2]!='X')           // X..
+      chunkStat.escSeq += (tpl[0]=='X') + (tpl[1]=='X') + (tpl[2]=='X');
+      
+      if (tpl[0]=='X' && tpl[1]!='X' && tpl[2]!='X')                // X..
       { out+= penalty_sym(*(++i));    out+=tpl[1];    out+=tpl[2];         }
       
       else if (tpl[0]!='X' && tpl[1]=='X' && tpl[2]!='X')           // .X.
@@ -677,10 +824,1093 @@ void EnDecrypto::unpack_seq (string& out, string::iterator& i) {
 }
 
 /**
- * @brief Shuffle a file (not FASTA/FASTQ)
+ * @brief  Codec: as it is
+ * @param  out   Encoded stream
+ * @param  text  Stream
+ * @param  strm  Stream properties
+ * @return true
+ */
+bool EnDecrypto::enc_raw (string& out, const string& text,
+                          const stream_s&) {
+  out += text;
+  return true;
+}
+
+/**
+ * @brief Codec: as it is
+ * @param[out] text  Stream
+ * @param[in]  beg   Beginning of the encoded stream
+ * @param[in]  end   End of the encoded stream
+ * @param[in]  strm  Stream properties
+ */
+void EnDecrypto::dec_raw (string& text, string::iterator beg,
+                          string::iterator end, const stream_s&) {
+  text.append(beg, end);
+}
+
+/**
+ * @brief  Codec: pack each field by the category of the alphabet, or 3 DNA
+ *         bases in 1 byte. Each field ends with (char) 254
+ * @param  out   Encoded stream
+ * @param  text  Stream
+ * @param  strm  Stream properties
+ * @return false, for the line lengths and the columns, and for a stream
+ *         with no packing function, e.g., with a symbol out of the profile
+ */
+bool EnDecrypto::enc_pack (string& out, const string& text,
+                           const stream_s& strm) {
+  if (strm.kind == STRM_LAYOUT || strm.kind == STRM_COL ||
+      (strm.kind != STRM_SEQ && !strm.packFP))    return false;
+
+  string field;
+  for (auto i = text.begin(); i != text.end(); ++i) {
+    const auto lf = std::find(i, text.end(), '\n');
+    field.assign(i, lf);
+    if (strm.kind == STRM_SEQ)    pack_seq(out, field);
+    else                          (this->*strm.packFP) (out, field, *strm.map);
+    out += (char) 254;
+    i = lf;
+  }
+  return true;
+}
+
+/**
+ * @brief Codec: unpack each field, by the category of the alphabet
+ * @param[out] text  Stream
+ * @param[in]  beg   Beginning of the encoded stream
+ * @param[in]  end   End of the encoded stream
+ * @param[in]  strm  Stream properties
+ */
+void EnDecrypto::dec_pack (string& text, string::iterator beg,
+                           string::iterator end, const stream_s& strm) {
+  // A field is read up to its (char) 254, and an escape takes the bytes
+  // after it. With (char) 254s after the stream, a corrupted one stops there
+  string packed(beg, end);
+  packed.append(PACK_PAD, (char) 254);
+  const auto packedEnd = packed.end() - (i64) PACK_PAD;
+
+  string field;
+  auto   i = packed.begin();
+  for (; i < packedEnd; ++i) {                    // i: (char) 254 at the end
+    unpack_field(field, i, strm);
+    text += field;
+    text += '\n';
+  }
+  assert(i != packedEnd, WRONG_KEY);
+}
+
+/**
+ * @brief Unpack a field, packed by the category of the stream
+ * @param[out]    field  Field
+ * @param[in,out] i      Packed field iterator. It goes to (char) 254 at the
+ *                       end
+ * @param[in]     strm   Stream properties
+ */
+void EnDecrypto::unpack_field (string& field, string::iterator& i,
+                               const stream_s& strm) {
+  if (strm.kind == STRM_SEQ)    unpack_seq(field, i);
+  else if (strm.unpackFP)       (this->*strm.unpackFP) (field, i, *strm.unpack);
+  else                          unpack_large(field, i, strm.XChar,
+                                             *strm.unpack);
+}
+
+/**
+ * @brief  Length of the tuples packed in a byte, or in 2 bytes, for a stream
+ * @param  strm  Stream properties
+ * @return Length of the tuples
+ */
+u64 EnDecrypto::key_len (const stream_s& strm) const {
+  if (strm.kind == STRM_SEQ)    return 3;
+  return strm.map ? strm.map->begin()->first.size()
+                  : strm.unpack->front().size();
+}
+
+/**
+ * @brief  Codec: pack, with the length of each field first, instead of
+ *         (char) 254 at the end. The last symbols of a field, which don't
+ *         make a tuple, are stored as they are, with no (char) 255.
+ *         Output: number of fields, their lengths, packed fields
+ * @param  out   Encoded stream
+ * @param  text  Stream
+ * @param  strm  Stream properties
+ * @return false, for the line lengths and the columns, and for a stream
+ *         with no packing function
+ */
+bool EnDecrypto::enc_pack_len (string& out, const string& text,
+                               const stream_s& strm) {
+  if (strm.kind == STRM_LAYOUT || strm.kind == STRM_COL ||
+      (strm.kind != STRM_SEQ && !strm.packFP))    return false;
+
+  const u64 keyLen = key_len(strm);
+  string lens, packed;
+  u64    nField = 0;
+  packed.reserve(text.size());
+  for (auto i = text.begin(); i != text.end(); ++i) {
+    const auto lf = std::find(i, text.end(), '\n');
+    const string field(i, lf);
+    if (strm.kind == STRM_SEQ)  pack_seq(packed, field);
+    else                      (this->*strm.packFP) (packed, field, *strm.map);
+
+    // Drop the (char) 255 before each of the last symbols
+    const u64 tail = field.size() % keyLen;
+    packed.resize(packed.size() - 2*tail);
+    packed.append(lf - (i64) tail, lf);
+    chunkStat.penalty -= tail;
+
+    put_varint(lens, field.size());
+    ++nField;
+    i = lf;
+  }
+  put_varint(out, nField);
+  out += lens;
+  out += packed;
+  return true;
+}
+
+/**
+ * @brief Codec: unpack the fields with known lengths. The output is sized
+ *        once, then each field is a loop over its number of tuples
+ * @param[out] text  Stream
+ * @param[in]  beg   Beginning of the encoded stream
+ * @param[in]  end   End of the encoded stream
+ * @param[in]  strm  Stream properties
+ */
+void EnDecrypto::dec_pack_len (string& text, string::iterator beg,
+                               string::iterator end, const stream_s& strm) {
+  // Tables: DNA bases with 'X' escapes, or of the category
+  const bool  isSeq  = (strm.kind == STRM_SEQ);
+  const auto& unpack = isSeq ? DNA_UNPACK : *strm.unpack;
+  const char  esc    = isSeq ? 'X' : (strm.unpackFP ? (char) 0 : strm.XChar);
+  const byte  nByte  = (!isSeq && strm.unpackFP != &EnDecrypto::unpack_1B)
+                       ? 2 : 1;
+  const u64   keyLen = key_len(strm);
+
+  // A byte gives keyLen symbols at most
+  citer_t i = beg;
+  const u64 nField = get_count(i, end);
+  const u64 maxLen = keyLen * (u64) (end - beg);
+  vector<u64> lens(nField);
+  u64 size = 0;
+  for (auto& l : lens) {
+    l = get_varint(i, end);
+    assert(l > maxLen - size, WRONG_KEY);
+    size += l;
+  }
+  size += nField;                                     // '\n's
+
+  const auto oldSize = text.size();
+  text.resize(oldSize + size);
+  char* o = &text[oldSize];
+  for (const u64 l : lens) {
+    unpack_field(o, i, end, l / keyLen, unpack, nByte, esc);
+    const u64 tail = l % keyLen;
+    assert(tail > (u64) (end - i), WRONG_KEY);
+    o = std::copy(i, i + (i64) tail, o);
+    i += (i64) tail;
+    *o++ = '\n';
+  }
+  assert(i != citer_t(end), "Error: corrupted packed stream.\n");
+}
+
+/**
+ * @brief Unpack a number of tuples of a field
+ * @param[in,out] o       Output. It goes after the tuples
+ * @param[in,out] i       Packed field iterator. It goes after the tuples
+ * @param[in]     end     End of the packed stream
+ * @param[in]     nTuple  Number of tuples
+ * @param[in]     unpack  Table for unpacking
+ * @param[in]     nByte   Bytes of a tuple index, 1 or 2
+ * @param[in]     esc     Escape char, followed by the symbol. 0: none
+ */
+void EnDecrypto::unpack_field (char*& o, citer_t& i, citer_t end,
+                               u64 nTuple, const vector<string>& unpack,
+                               byte nByte, char esc) {
+  if (!esc) {                       // No escapes: a fixed stride of nByte
+    assert(nTuple > (u64) (end - i) / nByte, WRONG_KEY);
+    if (nByte == 1)
+      for (; nTuple--; ++i) {
+        assert((byte) *i >= unpack.size(), WRONG_KEY);
+        const string& tpl = unpack[(byte) *i];
+        o = std::copy(tpl.begin(), tpl.end(), o);
+      }
+    else
+      for (; nTuple--; i += 2) {
+        const u16 idx = (u16) ((byte) *i << 8 | (byte) *(i+1));
+        assert(idx >= unpack.size(), WRONG_KEY);
+        const string& tpl = unpack[idx];
+        o = std::copy(tpl.begin(), tpl.end(), o);
+      }
+    return;
+  }
+
+  u64& nEsc = (esc == 'X') ? chunkStat.escSeq : chunkStat.escLarge;
+  while (nTuple--) {
+    assert(end - i < nByte, WRONG_KEY);
+    const u16 idx = (nByte == 1) ? (byte) *i
+                                 : (u16) ((byte) *i << 8 | (byte) *(i+1));
+    assert(idx >= unpack.size(), WRONG_KEY);
+    i += nByte;
+    for (const char c : unpack[idx]) {
+      if (c != esc)    *o++ = c;
+      else { assert(i == end, WRONG_KEY);    *o++ = *i++;    ++nEsc; }
+    }
+  }
+}
+
+/**
+ * @brief  Codec: 3 DNA bases in 1 byte, at a fixed rate. A base which is not
+ *         A, C, G, T, N is packed as 'X', and is stored in a side stream of
+ *         escapes, as (position, base). The last bases of a field are padded
+ *         to 3, so base j of a field is in byte j/3 of its packed field.
+ *         Output: number of fields, their lengths, escapes, packed fields
+ * @param  out   Encoded stream
+ * @param  text  Stream
+ * @param  strm  Stream properties
+ * @return false, if not a sequence stream
+ */
+bool EnDecrypto::enc_pack_fix (string& out, const string& text,
+                               const stream_s& strm) {
+  if (strm.kind != STRM_SEQ)    return false;
+
+  // Index of a base in DNA_UNPACK: A C G T N, then X for the others
+  byte digit[256];
+  memset(digit, 5, sizeof(digit));
+  digit['A']=0;    digit['C']=1;    digit['G']=2;    digit['T']=3;
+  digit['N']=4;
+
+  string lens, esc, packed;
+  u64    nField=0, nEsc=0, lastEsc=0;
+  packed.reserve(text.size() / 3 + 1);
+  for (auto i = text.begin(); i != text.end(); ++i) {
+    const auto lf = std::find(i, text.end(), '\n');
+    put_varint(lens, (u64) (lf - i));
+    ++nField;
+
+    for (; i != lf; ) {
+      byte idx = 0;
+      for (byte k = 0; k != 3; ++k) {
+        if (i == lf) { idx = (byte) (idx*6);    continue; }      // Pad: A
+        const byte d = digit[(byte) *i];
+        idx = (byte) (idx*6 + d);
+        if (d == 5) {
+          const auto pos = (u64) (i - text.begin());
+          put_varint(esc, pos - lastEsc);
+          esc += *i;
+          lastEsc = pos;
+          ++nEsc;
+        }
+        ++i;
+      }
+      packed += (char) idx;
+    }
+  }
+  chunkStat.escSeq += nEsc;
+
+  put_varint(out, nField);
+  out += lens;
+  put_varint(out, nEsc);
+  out += esc;
+  out += packed;
+  return true;
+}
+
+/**
+ * @brief Codec: unpack 3 DNA bases from each byte, then put the escapes in
+ *        their positions
+ * @param[out] text  Stream
+ * @param[in]  beg   Beginning of the encoded stream
+ * @param[in]  end   End of the encoded stream
+ * @param[in]  strm  Stream properties
+ */
+void EnDecrypto::dec_pack_fix (string& text, string::iterator beg,
+                               string::iterator end, const stream_s&) {
+  // A byte gives 3 bases
+  citer_t i = beg;
+  const u64 nField = get_count(i, end);
+  const u64 maxLen = 3 * (u64) (end - beg);
+  vector<u64> lens(nField);
+  u64 size=0, nByte=0;
+  for (auto& l : lens) {
+    l = get_varint(i, end);
+    assert(l > maxLen - size, WRONG_KEY);
+    size  += l;
+    nByte += (l + 2) / 3;
+  }
+  size += nField;                                     // '\n's
+  const u64 nEsc = get_count(i, end);
+  citer_t   esc  = i;
+  for (u64 e = nEsc; e--; ++i) {
+    get_varint(i, end);
+    assert(i == citer_t(end), WRONG_KEY);
+  }
+  assert((u64) (end - i) != nByte, "Error: corrupted packed stream.\n");
+
+  const auto oldSize = text.size();
+  text.resize(oldSize + size);
+  char* o = &text[oldSize];
+  for (const u64 l : lens) {
+    for (u64 n = (l + 2) / 3, left = l; n--; ++i, left -= 3) {
+      assert((byte) *i >= DNA_UNPACK.size(), WRONG_KEY);
+      const string& tpl = DNA_UNPACK[(byte) *i];
+      o = std::copy(tpl.begin(), tpl.begin() + (i64) std::min(left, 3ull),
+                    o);
+    }
+    *o++ = '\n';
+  }
+
+  // Escapes, in the places of 'X'
+  for (u64 n = nEsc, pos = oldSize; n--; ++esc) {
+    pos += get_varint(esc, end);
+    assert(pos >= text.size() || text[pos] != 'X', WRONG_KEY);
+    text[pos] = *esc;
+  }
+  chunkStat.escSeq += nEsc;
+}
+
+/**
+ * @brief  Codec: 4 DNA bases in 1 byte
+ * @param  out   Encoded stream
+ * @param  text  Stream
+ * @param  strm  Stream properties
+ * @return false, if it is not a stream of A, C, G, T
+ */
+bool EnDecrypto::enc_2bit (string& out, const string& text,
+                           const stream_s& strm) {
+  return strm.kind == STRM_SEQ && two_bit_encode(out, text);
+}
+
+/**
+ * @brief Codec: 4 DNA bases in 1 byte
+ * @param[out] text  Stream
+ * @param[in]  beg   Beginning of the encoded stream
+ * @param[in]  end   End of the encoded stream
+ * @param[in]  strm  Stream properties
+ */
+void EnDecrypto::dec_2bit (string& text, string::iterator beg,
+                           string::iterator end, const stream_s&) {
+  two_bit_decode(text, beg, end);
+}
+
+/**
+ * @brief  Codec: rANS, order-0
+ * @param  out   Encoded stream
+ * @param  text  Stream
+ * @param  strm  Stream properties
+ * @return true
+ */
+bool EnDecrypto::enc_rans (string& out, const string& text,
+                           const stream_s&) {
+  rans_encode(out, text);
+  return true;
+}
+
+/**
+ * @brief Codec: rANS, order-0
+ * @param[out] text  Stream
+ * @param[in]  beg   Beginning of the encoded stream
+ * @param[in]  end   End of the encoded stream
+ * @param[in]  strm  Stream properties
+ */
+void EnDecrypto::dec_rans (string& text, string::iterator beg,
+                           string::iterator end, const stream_s&) {
+  rans_decode(text, beg, end);
+}
+
+/**
+ * @brief  Codec: deflate
+ * @param  out   Encoded stream
+ * @param  text  Stream
+ * @param  strm  Stream properties
+ * @return false, if deflate is off
+ */
+bool EnDecrypto::enc_deflate (string& out, const string& text,
+                              const stream_s&) {
+  if (deflate_level == 0)    return false;
+  deflate_encode(out, text, deflate_level);
+  return true;
+}
+
+/**
+ * @brief Codec: deflate
+ * @param[out] text  Stream
+ * @param[in]  beg   Beginning of the encoded stream
+ * @param[in]  end   End of the encoded stream
+ * @param[in]  strm  Stream properties
+ */
+void EnDecrypto::dec_deflate (string& text, string::iterator beg,
+                              string::iterator end, const stream_s&) {
+  deflate_decode(text, beg, end);
+}
+
+/**
+ * @brief  Codec: pack, then deflate the packed stream. Packing leaves the
+ *         repeats of headers and quality scores, e.g., the same instrument
+ *         and run ID in every header, which LZ77 finds
+ * @param  out   Encoded stream
+ * @param  text  Stream
+ * @param  strm  Stream properties
+ * @return false, if the stream can't be packed or deflate is off
+ */
+bool EnDecrypto::enc_pack_deflate (string& out, const string& text,
+                                   const stream_s& strm) {
+  string packed;
+  if (deflate_level == 0 || !enc_pack(packed, text, strm))    return false;
+  deflate_encode(out, packed, deflate_level);
+  return true;
+}
+
+/**
+ * @brief Codec: inflate, then unpack
+ * @param[out] text  Stream
+ * @param[in]  beg   Beginning of the encoded stream
+ * @param[in]  end   End of the encoded stream
+ * @param[in]  strm  Stream properties
+ */
+void EnDecrypto::dec_pack_deflate (string& text, string::iterator beg,
+                                   string::iterator end,
+                                   const stream_s& strm) {
+  string packed;
+  deflate_decode(packed, beg, end);
+  dec_pack(text, packed.begin(), packed.end(), strm);
+}
+
+/**
+ * @brief  Codec: context mixing of order-k models, for sequences
+ * @param  out   Encoded stream
+ * @param  text  Stream
+ * @param  strm  Stream properties
+ * @return false, if not a sequence stream or not "--level max"
+ */
+bool EnDecrypto::enc_cm (string& out, const string& text,
+                         const stream_s& strm) {
+  if (!level_max || strm.kind != STRM_SEQ)    return false;
+  cm_encode(out, text);
+  return true;
+}
+
+/**
+ * @brief Codec: context mixing of order-k models, for sequences
+ * @param[out] text  Stream
+ * @param[in]  beg   Beginning of the encoded stream
+ * @param[in]  end   End of the encoded stream
+ * @param[in]  strm  Stream properties
+ */
+void EnDecrypto::dec_cm (string& text, string::iterator beg,
+                         string::iterator end, const stream_s&) {
+  cm_decode(text, beg, end);
+}
+
+/**
+ * @brief  Codec: run lengths, e.g., for quality scores of PacBio HiFi or
+ *         binned ones
+ * @param  out   Encoded stream
+ * @param  text  Stream
+ * @param  strm  Stream properties
+ * @return false, if the runs are short
+ */
+bool EnDecrypto::enc_rle (string& out, const string& text,
+                          const stream_s&) {
+  return rle_encode(out, text);
+}
+
+/**
+ * @brief Codec: run lengths
+ * @param[out] text  Stream
+ * @param[in]  beg   Beginning of the encoded stream
+ * @param[in]  end   End of the encoded stream
+ * @param[in]  strm  Stream properties
+ */
+void EnDecrypto::dec_rle (string& text, string::iterator beg,
+                          string::iterator end, const stream_s&) {
+  rle_decode(text, beg, end);
+}
+
+/**
+ * @brief  Codec: map on the reference, for sequences. Each field is cut in
+ *         pieces of REF_PIECE bases. A piece is either mapped, as position,
+ *         strand and mismatches, or packed with the others which are not.
+ *         Output: size of the map, map, packed pieces
+ * @param  out   Encoded stream
+ * @param  text  Stream
+ * @param  strm  Stream properties
+ * @return false, if not a sequence stream or no reference
+ */
+bool EnDecrypto::enc_ref (string& out, const string& text,
+                          const stream_s& strm) {
+  if (!Ref.loaded() || strm.kind != STRM_SEQ)    return false;
+
+  string map, literal, seg;
+  u64    expect = 0;    // Position expected, after the previous piece
+  for (auto i = text.begin(); i != text.end(); ++i) {
+    const auto lf = std::find(i, text.end(), '\n');
+    put_varint(map, (u64) (lf - i));
+    for (; i != lf; i += (i64) std::min(REF_PIECE, (u64) (lf - i))) {
+      const string piece(i, i + (i64) std::min(REF_PIECE, (u64) (lf - i)));
+      // Mapped, if smaller than packed: 3 bases in 1 byte, 2 bytes an edit
+      const i64 maxEdit = ((i64) piece.size()/3 - 8) / 2;
+      u64  pos;
+      bool rc;
+      ++chunkStat.refPiece;
+      if (maxEdit < 0 || !Ref.find(piece, (u64) maxEdit, pos, rc)) {
+        map += (char) 0;
+        literal += piece;    literal += '\n';
+        continue;
+      }
+      ++chunkStat.refMapped;
+      map += (char) (rc ? 2 : 1);
+      const i64 delta = (i64) (pos - expect);
+      put_varint(map, (u64) (delta << 1 ^ delta >> 63));        // Zigzag
+      expect = rc ? pos : pos + piece.size();
+
+      seg.clear();
+      Ref.copy(seg, pos, piece.size(), rc);
+      string edit;
+      u64 nEdit = 0,  at = 0;
+      for (u64 e = 0; e != piece.size(); ++e)
+        if (piece[e] != seg[e]) {
+          put_varint(edit, e - at);    edit += piece[e];
+          at = e + 1;    ++nEdit;
+        }
+      put_varint(map, nEdit);    map += edit;
+    }
+  }
+
+  put_varint(out, map.size());
+  out += map;
+  return enc_pack(out, literal, strm);
+}
+
+/**
+ * @brief Codec: map on the reference, for sequences
+ * @param[out] text  Stream
+ * @param[in]  beg   Beginning of the encoded stream
+ * @param[in]  end   End of the encoded stream
+ * @param[in]  strm  Stream properties
+ */
+void EnDecrypto::dec_ref (string& text, string::iterator beg,
+                          string::iterator end, const stream_s& strm) {
+  assert(!Ref.loaded(), "Error: the reference is needed, to decompress.\n");
+  citer_t m = beg;
+  const u64 mapSize = get_varint(m, end);
+  assert(mapSize > (u64) (end - m), WRONG_KEY);
+  const citer_t mapEnd = m + (i64) mapSize;
+
+  string literal;
+  dec_pack(literal, beg + (mapEnd - citer_t(beg)), end, strm);
+  auto l = literal.cbegin();
+  u64  expect = 0;
+  while (m != mapEnd) {
+    const u64 len = get_varint(m, mapEnd);
+    for (u64 done = 0; done != len;) {
+      const u64  size = std::min(REF_PIECE, len - done);
+      assert(m == mapEnd, WRONG_KEY);
+      const byte tag  = (byte) *m++;
+      done += size;
+      if (tag == 0) {                                   // A piece and '\n'
+        assert(size >= (u64) (literal.cend() - l), WRONG_KEY);
+        text.append(l, l + (i64) size);
+        l += (i64) size + 1;
+        continue;
+      }
+      assert(tag > 2, WRONG_KEY);
+      const u64 zz  = get_varint(m, mapEnd);
+      const u64 pos = expect + (u64) ((i64) (zz >> 1) ^ -(i64) (zz & 1));
+      assert(pos > Ref.size() || size > Ref.size() - pos, WRONG_KEY);
+      expect = (tag == 2) ? pos : pos + size;
+
+      const auto segBeg = text.size();
+      Ref.copy(text, pos, size, tag == 2);
+      u64 at = 0;
+      for (u64 n = get_varint(m, mapEnd); n--; ++at) {
+        const u64 skip = get_varint(m, mapEnd);
+        assert(skip >= size - at || m == mapEnd, WRONG_KEY);
+        at += skip;
+        text[segBeg + at] = *m++;
+      }
+    }
+    text += '\n';
+  }
+}
+
+/**
+ * @brief  Length of the fields of a stream, if they are all the same, e.g.,
+ *         sequences of Illumina reads
+ * @param  text  Stream
+ * @return Length. 0, if they are not the same, or are empty
+ */
+u64 EnDecrypto::fixed_len (const string& text) const {
+  const auto len = text.find('\n');
+  if (len == 0 || len == string::npos || text.size() % (len+1))    return 0;
+  for (auto lf = len; lf < text.size(); lf += len+1)
+    if (text[lf] != '\n')    return 0;
+  return len;
+}
+
+/**
+ * @brief  Find the sequences which are duplicates of earlier ones, in a
+ *         window of DEDUP_WINDOW sequences. Map: number of duplicates, then
+ *         for each one, the sequences since the previous duplicate and how
+ *         far back the earlier one is
+ * @param  map   Map of duplicates
+ * @param  uniq  Sequences which are not duplicates
+ * @param  text  Stream of sequences
+ * @return true, if the duplicates are larger than the map
+ */
+bool EnDecrypto::dedup_fields (string& map, string& uniq, const string& text) {
+  std::unordered_map<u64, u64> last;    // Hash of a sequence -> its number
+  vector<std::pair<u64, u64>>  field;   // Beginning and length, of each
+  string dups;
+  u64    nDup=0, nextUniq=0, dupBytes=0;
+  uniq.reserve(text.size());
+
+  for (auto i = text.begin(); i != text.end(); ++i) {
+    const auto lf  = std::find(i, text.end(), '\n');
+    const auto beg = (u64) (i - text.begin()),  len = (u64) (lf - i);
+    const u64  n   = field.size();
+    const u64  h   = std::hash<string>()(string(i, lf));
+    field.emplace_back(beg, len);
+
+    const auto found = last.find(h);
+    if (len && found != last.end() && n - found->second <= DEDUP_WINDOW &&
+        field[found->second].second == len &&
+        text.compare(field[found->second].first, len, text, beg, len) == 0) {
+      put_varint(dups, n - nextUniq);
+      put_varint(dups, n - found->second);
+      nextUniq = n + 1;
+      ++nDup;
+      dupBytes += len;
+    }
+    else {
+      uniq.append(i, lf);
+      uniq += '\n';
+    }
+    last[h] = n;
+    i = lf;
+  }
+
+  if (!nDup || dupBytes <= dups.size())    return false;
+  put_varint(map, nDup);
+  map += dups;
+
+  chunkStat.seqField += field.size();
+  chunkStat.dupField += nDup;
+  return true;
+}
+
+/**
+ * @brief Put the duplicate sequences back, by copying the earlier ones
+ * @param[out]    text  Stream of sequences
+ * @param[in,out] m     Map of duplicates iterator. It goes after the map
+ * @param[in]     end   End of the stream
+ * @param[in]     uniq  Sequences which are not duplicates
+ */
+void EnDecrypto::redup_fields (string& text, citer_t& m, citer_t end,
+                               const string& uniq) {
+  vector<std::pair<u64, u64>> field;    // Beginning and length, of each
+  u64 nDup = get_varint(m, end);
+  u64 next = nDup ? get_varint(m, end) : 0;   // Sequences to the next dup
+  chunkStat.dupField += nDup;
+
+  text.reserve(text.size() + uniq.size());
+  for (auto i = uniq.begin(); ; ) {
+    for (; nDup && next == 0; next = --nDup ? get_varint(m, end) : 0) {
+      const u64 back = get_varint(m, end);
+      assert(back == 0 || back > field.size(), WRONG_KEY);
+      const auto f = field[field.size() - back];
+      field.emplace_back(text.size(), f.second);
+      text.append(text, f.first, f.second);
+      text += '\n';
+    }
+    if (i == uniq.end())    break;
+
+    const auto lf = std::find(i, uniq.end(), '\n');
+    field.emplace_back(text.size(), (u64) (lf - i));
+    text.append(i, lf);
+    text += '\n';
+    i = lf + 1;
+    --next;
+  }
+  chunkStat.seqField += field.size();
+}
+
+/**
+ * @brief Encode a stream. The codecs are tried on a sample of the stream, and
+ *        the one with the smallest output is used, or the next one, if it
+ *        fails on the whole stream. Raw, if the others don't make the stream
+ *        smaller, or the stream is tiny. Output: codec ID, size, (char) 254, stream.
+ *        If the fields have a fixed length, they are encoded as one field,
+ *        the length comes first and CDC_FIXED is set in the codec ID. With
+ *        dedup, the map of duplicate sequences comes first and CDC_DEDUP is
+ *        set. The codec picked is taken by the same stream of the next
+ *        CODEC_REUSE chunks of the thread, with no trials. With seekable,
+ *        the sequences take packfix, with no trials
+ * @param[out] out    Encoded stream
+ * @param[in]  field  Stream
+ * @param[in]  strm   Stream properties
+ */
+void EnDecrypto::encode_stream (string& out, const string& field,
+                                const stream_s& strm) {
+  // Duplicates of earlier sequences, by reference to them
+  string dupMap, uniq;
+  const bool dup = dedup && strm.kind == STRM_SEQ &&
+                   dedup_fields(dupMap, uniq, field);
+  const string& src = dup ? uniq : field;
+
+  // Fixed length, of reads. Not on a reference, where a piece would span
+  // reads
+  const u64 len = ((strm.kind == STRM_SEQ && !Ref.loaded()) ||
+                   strm.kind == STRM_QS) ? fixed_len(src) : 0;
+  string joint;
+  if (len) {
+    joint.reserve(src.size() / (len+1) * len + 1);
+    for (auto f = src.begin(); f != src.end(); f += (i64) len+1)
+      joint.append(f, f + (i64) len);
+    joint += '\n';
+  }
+  const string& text = len ? joint : src;
+  const kstat_s stat = chunkStat;
+
+  // Seekable: the sequences at a fixed rate, out of the ranking
+  if (seekable && strm.kind == STRM_SEQ) {
+    string enc;
+    enc_pack_fix(enc, text, strm);
+    put_stream(out, enc, CDC_PACK_FIX, dupMap, len, dup, strm);
+    return;
+  }
+
+  // The codec picked for this stream in an earlier chunk, if it still fits
+  // and is not larger by 1/CODEC_SLACK than it was. Else, a new trial
+  if (codecPick.size() <= strmNo)    codecPick.resize(strmNo + 1);
+  pick_s& pick = codecPick[strmNo++];
+  string  enc;
+  byte    best = CDC_RAW;
+  if (pick.left && text.size() >= CODEC_MIN) {
+    --pick.left;
+    if (pick.codec == CDC_RAW)    enc = text;
+    if (pick.codec == CDC_RAW ||
+        ((this->*CODEC[pick.codec].encode) (enc, text, strm) &&
+         enc.size() < text.size() &&
+         enc.size() * pick.txtSize * CODEC_SLACK <=
+           pick.encSize * text.size() * (CODEC_SLACK + 1))) {
+      put_stream(out, enc, pick.codec, dupMap, len, dup, strm);
+      return;
+    }
+    enc.clear();
+    chunkStat = stat;
+  }
+
+  // Sample: the first CODEC_SMPL bytes. A field cut there is ended
+  string smpl = text.substr(0, CODEC_SMPL);
+  if (smpl.size() < text.size() && smpl.back() != '\n')    smpl += '\n';
+  const bool smplAll = (smpl.size() == text.size());
+
+  // Try the codecs and rank them. Keep the telemetry of the chosen one only.
+  // No trial for a tiny stream, which is kept raw. The trial of pack+deflate
+  // deflates the one of pack, instead of packing again
+  vector<std::pair<u64, byte>> rank;
+  string  trial[N_CODEC];
+  kstat_s trialStat[N_CODEC];
+  if (text.size() >= CODEC_MIN)
+    for (byte c = CDC_RAW + 1; c != N_CODEC; ++c) {
+      bool ok;
+      if (c == CDC_PACK_FIX)    continue;             // Only with --seekable
+      if (c == CDC_PACK_DEFL && !trial[CDC_PACK].empty()) {
+        ok = deflate_level != 0;
+        if (ok)    deflate_encode(trial[c], trial[CDC_PACK], deflate_level);
+        chunkStat = trialStat[CDC_PACK];
+      }
+      else {
+        ok = (this->*CODEC[c].encode) (trial[c], smpl, strm);
+      }
+      if (ok && trial[c].size() < smpl.size())
+        rank.emplace_back(trial[c].size(), c);
+      trialStat[c] = chunkStat;
+      chunkStat    = stat;
+    }
+  std::stable_sort(rank.begin(), rank.end());
+
+  // The best on the sample might not fit the whole stream, e.g., a symbol
+  // out of 2bit after the sample. Go down the ranking, then. If the sample
+  // is the whole stream, its trial is the output
+  for (const auto& r : rank) {
+    const byte c = r.second;
+    if (smplAll) {
+      best = c;
+      enc.swap(trial[c]);
+      chunkStat = trialStat[c];
+      break;
+    }
+    enc.clear();
+    if ((this->*CODEC[c].encode) (enc, text, strm) &&
+        enc.size() < text.size()) {              // Never more than raw
+      best = c;
+      break;
+    }
+    chunkStat = stat;
+  }
+  if (best == CDC_RAW) { enc = text;    chunkStat = stat; }
+
+  // A sample hides the gain of some codecs, e.g., the models of context
+  // mixing learn along the stream, and the tables of rANS in run lengths
+  // pay off on long streams. Try them on the whole stream, too
+  for (byte c = CDC_RAW + 1; c != N_CODEC && !smplAll; ++c) {
+    string whole;
+    if (CODEC[c].whole && c != best &&
+        (this->*CODEC[c].encode) (whole, text, strm) &&
+        whole.size() < enc.size()) {
+      best = c;
+      enc.swap(whole);
+      chunkStat = stat;
+    }
+  }
+  if (text.size() >= CODEC_MIN) {
+    pick.codec   = best;
+    pick.txtSize = text.size();
+    pick.encSize = enc.size();
+    pick.left    = CODEC_REUSE;
+  }
+  put_stream(out, enc, best, dupMap, len, dup, strm);
+}
+
+/**
+ * @brief Append an encoded stream: codec ID, size, (char) 254, map of
+ *        duplicates, fixed length and the stream
+ * @param[out] out     Encoded streams
+ * @param[in]  enc     Stream, encoded
+ * @param[in]  codec   Codec ID
+ * @param[in]  dupMap  Map of duplicates. Empty: none
+ * @param[in]  len     Fixed length of the fields. 0: none
+ * @param[in]  dup     With duplicates
+ * @param[in]  strm    Stream properties
+ */
+void EnDecrypto::put_stream (string& out, const string& enc, byte codec,
+                             const string& dupMap, u64 len, bool dup,
+                             const stream_s& strm) {
+  ++chunkStat.codec[strm.kind][codec];
+  string lenStr;
+  if (len)    put_varint(lenStr, len);
+  out += (char) (codec | (len ? CDC_FIXED : 0) | (dup ? CDC_DEDUP : 0));
+  out += to_string(dupMap.size() + lenStr.size() + enc.size());
+  out += (char) 254;
+  out += dupMap;
+  out += lenStr;
+  out += enc;
+}
+
+/**
+ * @brief Decode a stream
+ * @param[out]    text  Stream
+ * @param[in,out] i     Encoded stream iterator. It goes to the next stream
+ * @param[in]     strm  Stream properties
+ */
+void EnDecrypto::decode_stream (string& text, string::iterator& i,
+                                const stream_s& strm) {
+  assert(i == chunkEnd, "Error: corrupted file.\n");
+  const bool fixed = (*i & CDC_FIXED) != 0;
+  const bool dup   = (*i & CDC_DEDUP) != 0;
+  const auto id    = (byte) (*i++ & ~(CDC_FIXED | CDC_DEDUP));
+  assert(id >= N_CODEC, "Error: unknown codec " + to_string(id) + ".\n");
+  const auto end = stream_end(i);
+  ++chunkStat.codec[strm.kind][id];
+
+  // Map of duplicate sequences. The others are decoded, then it is applied
+  const citer_t dupMap = i;
+  if (dup) {
+    citer_t m = dupMap;
+    for (u64 n = 2 * get_count(m, end); n--; )    get_varint(m, end);
+    i += m - dupMap;
+  }
+  string uniq;
+  string& dst = dup ? uniq : text;
+
+  if (!fixed)
+    (this->*CODEC[id].decode) (dst, i, end, strm);
+  else {
+    // One field, then cut with a fixed stride
+    citer_t l = i;
+    const auto len = (i64) get_varint(l, end);
+    assert(len <= 0, WRONG_KEY);
+    string joint;
+    (this->*CODEC[id].decode) (joint, i + (l - citer_t(i)), end, strm);
+    assert(joint.empty() || (joint.size() - 1) % (u64) len, WRONG_KEY);
+    const auto jointEnd = joint.end() - 1;                      // '\n'
+    dst.reserve(dst.size() + (jointEnd - joint.begin()) / len * (len+1));
+    for (auto f = joint.begin(); f != jointEnd; f += len) {
+      dst.append(f, f + len);
+      dst += '\n';
+    }
+  }
+  if (dup) {
+    citer_t m = dupMap;
+    redup_fields(text, m, end, uniq);
+  }
+  i = end;
+}
+
+/**
+ * @brief Skip a stream, by its size
+ * @param i  Encoded stream iterator. It goes to the next stream
+ */
+void EnDecrypto::skip_stream (string::iterator& i) const {
+  i = stream_end(++i);
+}
+
+/**
+ * @brief  End of a stream, by its size, checked against the end of the chunk
+ * @param  i  Size of the stream. It goes to the beginning of the stream
+ * @return End of the stream
+ */
+string::iterator EnDecrypto::stream_end (string::iterator& i) const {
+  u64 size = 0;
+  auto d = i;
+  for (; d != chunkEnd && isdigit(*d) && d - i < 19; ++d)
+    size = size*10 + (u64) (*d - '0');
+  assert(d == i || d == chunkEnd || *d != (char) 254 ||
+         size > (u64) (chunkEnd - d - 1), "Error: corrupted file.\n");
+  i = d + 1;
+  return i + (i64) size;
+}
+
+/**
+ * @brief Encode the streams of a chunk
+ * @param[out] context  Encoded chunk
+ * @param[in]  text     Streams
+ * @param[in]  strm     Properties of the streams
+ */
+void EnDecrypto::encode_chunk (string& context, const strms_t& text,
+                               const stream_s* strm) {
+  for (byte s = 0; s != N_STRM; ++s)
+    encode_stream(context, text[s], strm[s]);
+}
+
+/**
+ * @brief Decode the streams of a chunk
+ * @param[out]    text  Streams
+ * @param[in,out] i     Encoded chunk iterator
+ * @param[in]     strm  Properties of the streams
+ */
+void EnDecrypto::decode_chunk (strms_t& text, string::iterator& i,
+                               const stream_s* strm) {
+  for (byte s = 0; s != N_STRM; ++s)
+    decode_stream(text[s], i, strm[s]);
+}
+
+/**
+ * @brief Count the k-mers of the sequences of a chunk. The other streams
+ *        are skipped, by their sizes. The 2bit and packfix codecs are
+ *        counted from the encoded bytes, the others are decoded to bases
+ * @param[in,out] i         Encoded chunk iterator. It goes to the end
+ * @param[in]     strm      Properties of the streams
+ * @param[in]     threadID  Thread ID
+ * @param[in]     chunkNo   Chunk number
+ */
+void EnDecrypto::count_chunk (string::iterator& i, const stream_s* strm,
+                              byte threadID, u64 chunkNo) {
+  for (byte s = 0; s != N_STRM; ++s) {
+    const bool fixed = (*i & CDC_FIXED) != 0;
+    const bool dup   = (*i & CDC_DEDUP) != 0;
+    const auto id    = (byte) (*i & ~(CDC_FIXED | CDC_DEDUP));
+    if (strm[s].kind == STRM_SEQ &&
+        (dup || (id != CDC_2BIT && id != CDC_PACK_FIX))) {
+      string seq;
+      decode_stream(seq, i, strm[s]);
+      Kmers.add_bases(threadID, chunkNo, seq.begin(), seq.end(), 0);
+      continue;
+    }
+
+    const auto end = stream_end(++i);
+    if (strm[s].kind == STRM_SEQ) {
+      ++chunkStat.codec[STRM_SEQ][id];
+      citer_t   b   = i;
+      const u64 len = fixed ? get_varint(b, end) : 0;
+      if (id == CDC_2BIT)    Kmers.add_2bit(threadID, chunkNo, b, end, len);
+      else               Kmers.add_pack_fix(threadID, chunkNo, b, end, len);
+    }
+    i = end;
+  }
+}
+
+/**
+ * @brief Add the sequences and the quality scores of a chunk to the
+ *        statistics. The other streams are skipped, by their sizes. The
+ *        2bit, packfix and pack codecs are counted from the encoded bytes,
+ *        the others are decoded
+ * @param[in,out] i         Encoded chunk iterator. It goes to the end
+ * @param[in]     strm      Properties of the streams
+ * @param[in]     threadID  Thread ID
+ * @param[in]     chunkNo   Chunk number
+ */
+void EnDecrypto::stat_chunk (string::iterator& i, const stream_s* strm,
+                             byte threadID, u64 chunkNo) {
+  for (byte s = 0; s != N_STRM; ++s) {
+    const bool fixed = (*i & CDC_FIXED) != 0;
+    const bool dup   = (*i & CDC_DEDUP) != 0;
+    const auto id    = (byte) (*i & ~(CDC_FIXED | CDC_DEDUP));
+    const auto kind  = strm[s].kind;
+    const bool seqPk = (kind == STRM_SEQ && (id == CDC_2BIT ||
+                        id == CDC_PACK_FIX || id == CDC_PACK));
+    const bool qsPk  = (kind == STRM_QS && id == CDC_PACK &&
+                        (strm[s].unpackFP == &EnDecrypto::unpack_1B ||
+                         strm[s].unpackFP == &EnDecrypto::unpack_2B));
+    if ((kind == STRM_SEQ || kind == STRM_QS) && (dup || (!seqPk && !qsPk))) {
+      string text;
+      decode_stream(text, i, strm[s]);
+      if (kind == STRM_SEQ)
+        Stats.add_bases(threadID, chunkNo, text.begin(), text.end());
+      else
+        Stats.add_qs(threadID, text.begin(), text.end());
+      continue;
+    }
+
+    const auto end = stream_end(++i);
+    if (seqPk || qsPk) {
+      ++chunkStat.codec[kind][id];
+      citer_t   b   = i;
+      const u64 len = fixed ? get_varint(b, end) : 0;
+      if      (qsPk)
+        Stats.add_qs_pack(threadID, b, end, *strm[s].unpack,
+                          strm[s].unpackFP == &EnDecrypto::unpack_2B);
+      else if (id == CDC_2BIT)
+        Stats.add_2bit(threadID, chunkNo, b, end, len);
+      else if (id == CDC_PACK_FIX)
+        Stats.add_pack_fix(threadID, chunkNo, b, end, len);
+      else
+        Stats.add_pack(threadID, chunkNo, b, end, len, DNA_UNPACK);
+    }
+    i = end;
+  }
+}
+
+/**
+ * @brief Print the statistics of the sequences, after the threads are done
+ * @param fastq  Print the quality scores, too
+ */
+void EnDecrypto::print_seq_stat (bool fastq) const {
+  cout << "Statistics of \"" << in_file << "\" ("
+       << (fastq ? "FASTQ" : "FASTA") << "):\n";
+  Stats.print(cout, fastq);
+  for (byte t = n_threads; t--;)
+    std::remove((UPK_FNAME + to_string(t)).c_str());
+}
+
+/**
+ * @brief Write the counts of k-mers, after the threads are done
+ */
+void EnDecrypto::write_kmers () const {
+  if (verbose)    cerr << "Writing the counts of " << (int) kmer_k
+                       << "-mers to \"" << out_file << "\"...\n";
+  Kmers.write(out_file);
+  for (byte t = n_threads; t--;)
+    std::remove((UPK_FNAME + to_string(t)).c_str());
+}
+
+/**
+ * @brief Shuffle a file (not FASTA, FASTQ, VCF, SAM, BED, GFF or GTF)
  */
 void EnDecrypto::shuffle_file () {
-  cerr << "This is not a FASTA/FASTQ file and we just encrypt it.\n";
+  cerr << "This is not a FASTA, FASTQ, VCF, SAM, BED, GFF or GTF file, so "
+          "it is only encrypted.\n";
+  budget.set_cap(max_memory);
   
   if (!stop_shuffle) {
     const auto start = high_resolution_clock::now();            // Start timer
@@ -688,9 +1918,11 @@ void EnDecrypto::shuffle_file () {
 
     // Distribute file among threads, for shuffling
     for (byte t=0; t != n_threads; ++t)
-      arrThread[t] = thread(&EnDecrypto::shuffle_block, this, t);
+      arrThread[t] = thread(&EnDecrypto::guard, this,
+                            [this, t] { shuffle_block(t); });
     for (auto& thr : arrThread)
       if (thr.joinable())  thr.join();
+    rethrow();
 
     // Join partially shuffled files
     join_shuffled_files();
@@ -727,10 +1959,11 @@ void EnDecrypto::shuffle_block (byte threadID) {
   // Characters ignored at the beginning
   in.ignore((std::streamsize) (threadID * BLOCK_SIZE));
 
-  for (char c; in.peek() != EOF;) {
-    string context;
-    for (u64 bs=BLOCK_SIZE; bs--;)
-      if (in.get(c))    context += c;
+  for (; in.peek() != EOF;) {
+    budget.acquire(BLOCK_SIZE);
+    string context(BLOCK_SIZE, '\0');
+    in.read(&context[0], BLOCK_SIZE);
+    context.resize((u64) in.gcount());
     
     // Shuffle
     if (!stop_shuffle) {
@@ -745,6 +1978,7 @@ void EnDecrypto::shuffle_block (byte threadID) {
     // Write header containing threadID for each partially shuffled file
     shfile << THR_ID_HDR << to_string(threadID) << '\n';
     shfile << context << '\n';
+    budget.release(BLOCK_SIZE);
 
     // Ignore to go to the next related chunk
     in.ignore((std::streamsize) ((n_threads-1) * BLOCK_SIZE));
@@ -760,15 +1994,18 @@ void EnDecrypto::unshuffle_file () {
   in.ignore(1);    char c;  in.get(c);
   if (c == (char) 128) {
     in.close();
+    budget.set_cap(max_memory);
 
     const auto start = high_resolution_clock::now();         // Start timer
     thread arrThread[n_threads];
 
     // Distribute file among threads, for unshuffling
     for (byte t=0; t != n_threads; ++t)
-      arrThread[t] = thread(&EnDecrypto::unshuffle_block, this, t);
+      arrThread[t] = thread(&EnDecrypto::guard, this,
+                            [this, t] { unshuffle_block(t); });
     for (auto& thr : arrThread)
       if (thr.joinable())  thr.join();
+    rethrow();
 
     // Delete decrypted file
     std::remove(DEC_FNAME.c_str());
@@ -806,10 +2043,11 @@ void EnDecrypto::unshuffle_block (byte threadID) {
   // filetype char (125) + shuffed (128) + characters ignored at the beginning
   in.ignore((std::streamsize) (2 + threadID*BLOCK_SIZE));
 
-  for (char c; in.peek() != EOF;) {
-    string unshText;
-    for (u64 bs = BLOCK_SIZE; bs--;)
-      if (in.get(c))    unshText += c;
+  for (; in.peek() != EOF;) {
+    budget.acquire(BLOCK_SIZE * UPK_MEM);
+    string unshText(BLOCK_SIZE, '\0');
+    in.read(&unshText[0], BLOCK_SIZE);
+    unshText.resize((u64) in.gcount());
 
     auto i = unshText.begin();
 
@@ -827,6 +2065,7 @@ void EnDecrypto::unshuffle_block (byte threadID) {
     ushfile << THR_ID_HDR + to_string(threadID) << '\n';
 
     ushfile << unshText << '\n';
+    budget.release(BLOCK_SIZE * UPK_MEM);
 
     // Ignore to go to the next related chunk
     in.ignore((std::streamsize) ((n_threads-1)*BLOCK_SIZE));
@@ -836,6 +2075,49 @@ void EnDecrypto::unshuffle_block (byte threadID) {
   in.close();
 }
 
+/**
+ * @brief Analyze a file which is not compacted, but shuffled. Predict the
+ *        output size and time by shuffling blocks sampled across the file
+ */
+void EnDecrypto::analyze_file () {
+  stats = true;             // The estimates are made from the telemetry
+  ifstream in(in_file);
+  in.seekg(0, std::ios::end);
+  const auto fileSize = (u64) in.tellg();
+  const u64  nBlock   = std::min(SMPL_N_BLOCK * SMPL_BLOCK_SIZE / BLOCK_SIZE,
+                                 fileSize / BLOCK_SIZE + 1);
+  const u64  step     = std::max(fileSize / nBlock, BLOCK_SIZE);
+  vector<string> smpl;
+  u64 smplBytes = 0;
+
+  // Read the sampled blocks
+  auto start = high_resolution_clock::now();
+  for (u64 b = 0; b != nBlock; ++b) {
+    in.clear();
+    in.seekg((std::streamoff) (b * step));
+    string context(BLOCK_SIZE, '\0');
+    in.read(&context[0], (std::streamsize) BLOCK_SIZE);
+    context.resize((u64) in.gcount());
+    smplBytes += context.size();
+    smpl.push_back(std::move(context));
+  }
+  in.close();
+  std::chrono::duration<double> scanSec = high_resolution_clock::now() - start;
+
+  // Shuffle the sampled blocks
+  start = high_resolution_clock::now();
+  u64 chunkNo = 0;
+  for (auto& context : smpl) {
+    if (!stop_shuffle)    shuffle(context);
+    end_chunk_stat(0, chunkNo++, context.size(), context.size());
+  }
+  std::chrono::duration<double> packSec = high_resolution_clock::now() - start;
+
+  cerr << "Analysis of \"" << in_file << "\" (not compacted):\n";
+  print_estimate(fileSize, smplBytes, 2, scanSec.count(), packSec.count(),
+                 false);
+}
+
 /**
  * @brief Join partially packed files
  * @param headers   Headers
@@ -852,12 +2134,28 @@ void EnDecrypto::join_packed_files (const string& headers,
   switch (fT) {
       case 'A':   pckdFile << (char) 127;         break;    // Fasta
       case 'Q':   pckdFile << (char) 126;         break;    // Fastq
+      case 'V':   pckdFile << (char) 124;         break;    // VCF
+      case 'M':   pckdFile << (char) 123;         break;    // SAM
+      case 'T':   pckdFile << (char) 122;         break;    // BED/GFF/GTF
       default :                                   break;
   }
   pckdFile << (!stop_shuffle ? (char) 128 : (char) 129);
+  pckdFile << VER_MARK << (char) ARCHIVE_VER;
+  if (Ref.loaded())    pckdFile << REF_MARK << Ref.digest();
+  if (!qual_bin.empty() && fT == 'Q')              // Bins of Phred 0..93
+    pckdFile << QBIN_MARK << string(QsBin+PHRED_OFF, PHRED_MAX+1);
+  if (!Perm.empty())                               // Order of the reads
+    pckdFile << PERM_MARK << to_string(Perm.size()) << (char) 254 << Perm;
+  if (cache_stats && (fT == 'A' || fT == 'Q')) {  // Stats of the sequences
+    string stat;
+    Stats.save(stat);
+    pckdFile << STAT_MARK << to_string(stat.size()) << (char) 254 << stat;
+  }
+  if (Crlf)    pckdFile << CRLF_MARK;             // Lines end with CR LF
+  if (NoEol)   pckdFile << NOEOL_MARK;            // No LF at the end
   pckdFile << headers;
   pckdFile << (char) 254;                // To detect headers in decryptor
-  if (fT == 'Q') {
+  if (fT == 'Q' || fT == 'M') {
       pckdFile << qscores;
       pckdFile << (justPlus ? (char) 253 : '\n');
   }
@@ -892,14 +2190,17 @@ void EnDecrypto::join_packed_files (const string& headers,
 }
 
 /**
- * @brief Join partially unpacked files
+ * @brief Join partially unpacked files. A chunk whose last line goes on in
+ *        the next chunk ends with LINE_OPEN
+ * @param out  Output, e.g., cout
  */
-void EnDecrypto::join_unpacked_files () const {
+void EnDecrypto::join_unpacked_files (std::ostream& out) const {
   byte     t;                           // For threads
   ifstream upkdFile[n_threads];
   for (t = n_threads; t--;)    upkdFile[t].open(UPK_FNAME+to_string(t));
 
   bool prevLineNotThrID;                // If previous line was "THRD=" or not
+  bool open = false;                    // If the last line goes on
   while (!upkdFile[0].eof()) {
     for (t = 0; t != n_threads; ++t) {
       prevLineNotThrID = false;
@@ -907,13 +2208,14 @@ void EnDecrypto::join_unpacked_files () const {
       for (string line; getline(upkdFile[t], line).good() &&
                         line != THR_ID_HDR+to_string(t);) {
         if (prevLineNotThrID)
-          cout << '\n';
-        cout << line;
+          out << '\n';
+        open = (!line.empty() && line.back() == LINE_OPEN);
+        out.write(line.data(), (std::streamsize) (line.size() - open));
 
         prevLineNotThrID = true;
       }
 
-      if (prevLineNotThrID)    cout << '\n';
+      if (prevLineNotThrID && !open)    out << '\n';
     }
   }
 
@@ -991,4 +2293,703 @@ void EnDecrypto::join_unshuffled_files () const {
     string ushdFileName=USH_FNAME;    ushdFileName+=to_string(t);
     std::remove(ushdFileName.c_str());
   }
-}
\ No newline at end of file
+}
+
+/**
+ * @brief  Bytes of a block to read from the input file. Larger with level
+ *         max, for the models of context mixing to learn, and with dedup,
+ *         for more duplicates in a chunk
+ * @return Block size
+ */
+u64 EnDecrypto::block_size () const {
+  return (level_max || dedup) ? CM_BLOCK_SIZE : BLOCK_SIZE;
+}
+
+/**
+ * @brief Skip a chunk read by columns: lines up to COL_BLOCK_SIZE bytes
+ * @param in  Input file
+ */
+void EnDecrypto::skip_block (std::ifstream& in) const {
+  for (u64 bytes = 0; bytes < COL_BLOCK_SIZE && in.peek() != EOF;
+       bytes += (u64) in.gcount())
+    in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+}
+
+/**
+ * @brief Fit the number of threads and the lines in each chunk to the budget
+ *        of memory. Fewer lines first, down to the minimum, then fewer threads
+ * @param lineBytes  Max bytes of a line
+ * @param minLines   Min lines in a chunk. Lines are multiple of it
+ */
+void EnDecrypto::fit_budget (u64 lineBytes, u32 minLines) {
+  Prof.blockLine = BlockLine;
+  Prof.lineBytes = lineBytes;
+  budget.set_cap(max_memory);
+  ChunkBytes = BlockLine * lineBytes;
+  if (!max_memory)    return;
+  
+  // Fewer lines in each chunk
+  const u64 thrBytes = max_memory / n_threads;
+  if (ChunkBytes * PK_MEM > thrBytes) {
+    auto lines = (u32) (thrBytes / (lineBytes * PK_MEM));
+    lines -= lines % minLines;
+    BlockLine  = std::max(lines, minLines);
+    ChunkBytes = BlockLine * lineBytes;
+  }
+
+  // Fewer threads
+  if (ChunkBytes * PK_MEM * n_threads > max_memory)
+    n_threads = (byte) std::max(max_memory / (ChunkBytes * PK_MEM), 1ull);
+
+  if (verbose)
+    cerr << "Memory budget of " << max_memory << " bytes: "
+         << (int) n_threads << " threads, " << BlockLine
+         << " lines in each chunk.\n";
+}
+
+/**
+ * @brief Load the alphabets and the chunk size from a profile, instead of
+ *        scanning the input file
+ * @param[in]  format   'A': FASTA, 'Q': FASTQ
+ * @param[out] headers  Chars of all headers
+ * @param[out] qscores  Chars of all quality scores
+ */
+void EnDecrypto::load_profile (char format, string& headers, string& qscores) {
+  ifstream in(profile_load);
+  string   line;
+  char     profFormat = 0;
+  const string corrupt = "Error: the profile \"" + profile_load +
+                         "\" is corrupted.\n";
+  
+  getline(in, line);
+  assert(line != "# cryfa profile",
+         "Error: \"" + profile_load + "\" is not a profile.\n");
+  while (getline(in, line).good()) {
+    const auto   sp    = line.find(' ');
+    const string key   = line.substr(0, sp);
+    const string value = (sp == string::npos) ? "" : line.substr(sp+1);
+    
+    if      (key == "format")        profFormat = value.empty() ? 0 : value[0];
+    else if (key == "headers")       Prof.headers   = value;
+    else if (key == "qscores")       Prof.qscores   = value;
+    else if (key == "block_line")
+      Prof.blockLine = (u32) to_number(value, 1, ~0u, corrupt);
+    else if (key == "line_bytes")
+      Prof.lineBytes = to_number(value, 1, ~0ull, corrupt);
+  }
+  in.close();
+  assert(profFormat != format, "Error: the profile \"" + profile_load +
+         "\" belongs to a different format.\n");
+  assert(!Prof.blockLine || !Prof.lineBytes,
+         "Error: the profile \"" + profile_load + "\" is incomplete.\n");
+  
+  headers = Prof.headers;
+  qscores = Prof.qscores;
+  BlockLine = Prof.blockLine;
+  fit_budget(Prof.lineBytes, (u32) (format=='Q' ? 4 : 2));
+
+  // Symbols accepted while packing. '@' and '>' are not packed in headers
+  memset(HdrSym, false, sizeof(HdrSym));
+  memset(QsSym,  false, sizeof(QsSym));
+  for (char c : headers)    HdrSym[(byte) c] = true;
+  for (char c : qscores)    QsSym[(byte) c]  = true;
+  HdrSym[(byte) (format=='Q' ? '@' : '>')] = true;
+  Profiled    = true;
+  
+  if (verbose)    cerr << "Profile \"" << profile_load << "\" loaded.\n";
+}
+
+/**
+ * @brief Save the alphabets and the chunk size to a profile
+ * @param format   'A': FASTA, 'Q': FASTQ
+ * @param headers  Chars of all headers
+ * @param qscores  Chars of all quality scores
+ */
+void EnDecrypto::save_profile (char format, const string& headers,
+                               const string& qscores) const {
+  ofstream out(profile_save);
+  assert(!out.good(), "Error: failed writing the profile \"" +
+                      profile_save + "\".\n");
+  out << "# cryfa profile\n"
+      << "format "     << format         << '\n'
+      << "headers "    << headers        << '\n'
+      << "qscores "    << qscores        << '\n'
+      << "block_line " << Prof.blockLine << '\n'
+      << "line_bytes " << Prof.lineBytes << '\n'
+      // Categories follow from the alphabets. Just for information
+      << "hdr_cat "    << category(headers.length()) << '\n';
+  if (format == 'Q')
+    out << "qs_cat "   << category(qscores.length()) << '\n';
+  out.close();
+  
+  if (verbose)    cerr << "Profile \"" << profile_save << "\" saved.\n";
+}
+
+/**
+ * @brief  Check if all symbols of a line are in the profile
+ * @param  line  Line
+ * @param  sym   Symbols in the profile
+ * @return true, if all are in the profile
+ */
+bool EnDecrypto::in_profile (const string& line, const bool* sym) const {
+  for (char c : line)
+    if ((byte) c > 127 || !sym[(byte) c])    return false;
+  return true;
+}
+
+/**
+ * @brief Set the bin of each quality score, by "--qual-bin": "illumina8", or
+ *        "custom:" and ranges of Phred scores with their bins, e.g.,
+ *        "custom:0-9=6,10-29=20,30-93=37". Other scores stay as they are
+ */
+void EnDecrypto::set_qual_bin () {
+  for (byte c = 0; c != 128; ++c)    QsBin[c] = (char) c;
+  if (qual_bin.empty())    return;
+
+  // Illumina, 8 levels
+  string map = "0-2=2,3-9=6,10-19=15,20-24=22,25-29=27,30-34=33,35-39=37,"
+               "40-93=40";
+  if (qual_bin.compare(0, 7, "custom:") == 0)    map = qual_bin.substr(7);
+
+  const vector<byte> bin = qual_bins(map);
+  for (byte q = 0; q <= PHRED_MAX; ++q)
+    QsBin[q + PHRED_OFF] = (char) (bin[q] + PHRED_OFF);
+}
+
+/**
+ * @brief Put quality scores in their bins, if "--qual-bin". A score out of
+ *        Phred+33 is an error
+ * @param qs  Quality scores
+ */
+void EnDecrypto::bin_qs (string& qs) const {
+  if (qual_bin.empty())    return;
+  for (char& c : qs) {
+    if ((byte) c < PHRED_OFF || (byte) c > PHRED_OFF + PHRED_MAX)
+      throw std::runtime_error("Error: the quality scores to bin must be "
+                               "Phred+33, 0 to 93.\n");
+    c = QsBin[(byte) c];
+  }
+}
+
+/**
+ * @brief Read the bins of quality scores from the header of a packed file,
+ *        if there are. Unpacking doesn't need them
+ * @param in  Packed file
+ */
+void EnDecrypto::read_qual_bin (std::ifstream& in) const {
+  if (in.peek() != (byte) QBIN_MARK)    return;
+  in.ignore(1 + PHRED_MAX + 1);
+  if (verbose)    cerr << "Quality scores had been binned.\n";
+}
+
+/**
+ * @brief Read the order of the reads from the header of a packed file, if
+ *        they had been reordered keeping it
+ * @param in  Packed file, after the bins of quality scores
+ */
+void EnDecrypto::read_perm (std::ifstream& in) {
+  if (in.peek() != (byte) PERM_MARK)    return;
+  in.ignore(1);
+  string sizeStr;
+  for (char c; in.get(c) && c != (char) 254;)    sizeStr += c;
+  Perm.resize(stoull(sizeStr));
+  in.read(&Perm[0], (std::streamsize) Perm.size());
+  if (verbose)    cerr << "Reads had been reordered.\n";
+}
+
+/**
+ * @brief  Read the statistics of the sequences from the header of a packed
+ *         file, if they had been kept. They are loaded only if they are
+ *         asked for
+ * @param  in  Packed file, after the order of the reads
+ * @return true, if they are loaded
+ */
+bool EnDecrypto::read_stats (std::ifstream& in) const {
+  if (in.peek() != (byte) STAT_MARK)    return false;
+  in.ignore(1);
+  string sizeStr;
+  for (char c; in.get(c) && c != (char) 254;)    sizeStr += c;
+  string stat(stoull(sizeStr), '\0');
+  in.read(&stat[0], (std::streamsize) stat.size());
+  if (!stats_archive)    return false;
+  Stats.load(stat.begin(), stat.end());
+  if (verbose)    cerr << "Statistics had been kept.\n";
+  return true;
+}
+
+/**
+ * @brief Read the version of a packed file, from its header. An archive of
+ *        version 1 has no mark: its chunks have the fields of the records
+ *        one after the other, with no streams
+ * @param in  Packed file, after the shuffle flag
+ */
+void EnDecrypto::read_version (std::ifstream& in) {
+  Legacy = (in.peek() != (byte) VER_MARK);
+  if (Legacy) {
+    if (verbose)    cerr << "Archive of version 1.\n";
+    return;
+  }
+  in.ignore(1);
+  const auto ver = (byte) in.get();
+  assert(ver > ARCHIVE_VER, "Error: the archive is of version " +
+         to_string(ver) + ", newer than this program.\n");
+}
+
+/**
+ * @brief Do the work of a thread. An error is kept, to be thrown by the main
+ *        thread, after the threads are joined
+ * @param work  Work
+ */
+void EnDecrypto::guard (const std::function<void()>& work) {
+  try { work(); }
+  catch (...) {
+    mutxErr.lock();//-------------------------------------------------------
+    if (!ThreadErr)    ThreadErr = std::current_exception();
+    mutxErr.unlock();//-----------------------------------------------------
+  }
+}
+
+/**
+ * @brief Throw the error of a thread, if there is, once they are joined
+ */
+void EnDecrypto::rethrow () const {
+  if (ThreadErr)    std::rethrow_exception(ThreadErr);
+}
+
+/**
+ * @brief Find if lines end with CR LF, as made on Windows, anywhere in the
+ *        input file, so that a file which is mixed is found, whatever its
+ *        first line. If so, '\r' is stripped from the ends of the lines
+ *        while packing, and the lines with LF only are kept, to be given
+ *        back exactly
+ */
+void EnDecrypto::detect_crlf () {
+  ifstream in(in_file, std::ios::binary);
+  vector<char> buf(COL_BLOCK_SIZE);
+  char prev = '\0';              // Last char of the block before
+  Crlf = false;
+  while (!Crlf && in.read(buf.data(), (std::streamsize) buf.size()).gcount()) {
+    const auto end = buf.begin() + in.gcount();
+    Crlf = (prev == '\r' && buf[0] == '\n');
+    for (auto c = std::find(buf.begin(), end, '\r'); !Crlf && c != end;
+         c = std::find(c + 1, end, '\r'))
+      Crlf = (c + 1 != end && c[1] == '\n');
+    prev = *(end - 1);
+  }
+  in.close();
+  if (verbose && Crlf)    cerr << "Lines end with CR LF.\n";
+}
+
+/**
+ * @brief Read if the lines had ended with CR LF, from the header of a packed
+ *        file
+ * @param in  Packed file, after the statistics
+ */
+void EnDecrypto::read_crlf (std::ifstream& in) {
+  Crlf = (in.peek() == (byte) CRLF_MARK);
+  if (Crlf)    in.ignore(1);
+}
+
+/**
+ * @brief Find if the input file doesn't end with LF, so that its last line is
+ *        given back with no LF, too
+ */
+void EnDecrypto::detect_no_eol () {
+  ifstream in(in_file, std::ios::binary | std::ios::ate);
+  NoEol = in.tellg() > 0 && in.seekg(-1, std::ios::end) && in.get() != '\n';
+  in.close();
+}
+
+/**
+ * @brief Read if the file had ended with no LF, from the header of a packed
+ *        file
+ * @param in  Packed file, after the version
+ */
+void EnDecrypto::read_no_eol (std::ifstream& in) {
+  NoEol = (in.peek() == (byte) NOEOL_MARK);
+  if (NoEol)    in.ignore(1);
+}
+
+/**
+ * @brief Strip '\r' from the end of a line of a chunk, if the lines end
+ *        with CR LF. Else, the line is kept as one with LF only
+ * @param[in,out] line  Line, with no '\n'
+ * @param[in,out] eol   Ends of the lines of the chunk
+ */
+void EnDecrypto::strip_cr (string& line, eol_s& eol) const {
+  if (!Crlf)    return;
+  if (!line.empty() && line.back() == '\r')    line.pop_back();
+  else {
+    put_varint(eol.lf, eol.line - eol.next);
+    eol.next = eol.line + 1;
+  }
+  ++eol.line;
+}
+
+/**
+ * @brief Encode the lines with LF only of a chunk, after its streams, if the
+ *        lines end with CR LF
+ * @param[out] out  Encoded chunk
+ * @param[in]  eol  Ends of the lines of the chunk
+ */
+void EnDecrypto::encode_eol (string& out, const eol_s& eol) {
+  stream_s strm;
+  strm.kind = STRM_COL;
+  if (Crlf)    encode_stream(out, eol.lf, strm);
+}
+
+/**
+ * @brief Decode the lines with LF only of a chunk, after its streams, if the
+ *        lines end with CR LF
+ * @param[out]    eol  Ends of the lines of the chunk
+ * @param[in,out] i    Encoded chunk iterator
+ */
+void EnDecrypto::decode_eol (eol_s& eol, string::iterator& i) {
+  eol.next = ~0ull;
+  if (!Crlf)    return;
+  stream_s strm;
+  strm.kind = STRM_COL;
+  decode_stream(eol.lf, i, strm);
+  eol.i = eol.lf.cbegin();
+  if (eol.i != eol.lf.cend())    eol.next = get_varint(eol.i, eol.lf.cend());
+}
+
+/**
+ * @brief End a line of a chunk: CR LF, if the file has, or LF
+ * @param[in,out] out  Lines
+ * @param[in,out] eol  Ends of the lines of the chunk
+ */
+void EnDecrypto::put_eol (string& out, eol_s& eol) const {
+  if (Crlf && next_crlf(eol))    out += '\r';
+  out += '\n';
+}
+
+/**
+ * @brief  Go to the next line of a chunk
+ * @param  eol  Ends of the lines of the chunk
+ * @return true, if the line ends with CR LF, as the file, not with LF only
+ */
+bool EnDecrypto::next_crlf (eol_s& eol) const {
+  if (eol.line++ != eol.next)    return true;
+  const auto end = eol.lf.cend();
+  eol.next = (eol.i != end) ? eol.next + 1 + get_varint(eol.i, end) : ~0ull;
+  return false;
+}
+
+/**
+ * @brief  If a string is all decimal digits, as a size
+ * @param  s  String
+ * @return true, if so
+ */
+inline bool digits (const string& s) {
+  return std::all_of(s.begin(), s.end(), [] (char c) { return isdigit(c); });
+}
+
+/**
+ * @brief   Decrypt the header of a packed file, then, for --sample, the
+ *          chunks sampled, into the decrypted file. The rest is neither
+ *          decrypted nor unpacked. For --head, the chunks are decrypted
+ *          by the decompressor, one by one, until the records are written
+ * @details The tag of GCM is on the whole file, so the data decrypted is
+ *          not authenticated, and a warning is printed. A wrong key is
+ *          found by the type and the shuffle flag, out of range
+ */
+void EnDecrypto::decrypt_part () {
+  cerr << "Decrypting...\n";
+  const auto start = high_resolution_clock::now();// Start timer
+  open_cipher();
+
+  // Header, extended while it is parsed
+  string hdr;
+  const auto at = [&] (u64 p) -> char {
+    while (p >= hdr.size()) {
+      string more;
+      decrypt_range(hdr.size(), BLOCK_SIZE, more);
+      assert(more.empty(), "Error: corrupted file.\n");
+      hdr += more;
+    }
+    return hdr[p];
+  };
+  // A type and a shuffle flag out of range: a wrong key, with no doubt
+  const char type = at(0);
+  assert(((byte) type < 122 || (byte) type > 127) ||
+         (at(1) != (char) 128 && at(1) != (char) 129), WRONG_KEY);
+  assert(type != (char) 127 && type != (char) 126, "Error: --head and "
+         "--sample are only for FASTA and FASTQ.\n");
+  assert(sample > 0 && type == (char) 127,
+         "Error: --sample is only for FASTQ.\n");
+  u64 p = 2;                                     // After the shuffle flag
+  if (at(p) == VER_MARK)     p += 2;
+  if (at(p) == REF_MARK)     p += 1 + 32;
+  if (at(p) == QBIN_MARK)    p += 1 + PHRED_MAX + 1;
+  for (const char mark : {PERM_MARK, STAT_MARK})
+    if (at(p) == mark) {
+      string sizeStr;
+      for (++p; at(p) != (char) 254; ++p)    sizeStr += at(p);
+      assert(sizeStr.empty() || sizeStr.size() > 19 || !digits(sizeStr),
+             WRONG_KEY);
+      p += 1 + stoull(sizeStr);
+    }
+  if (at(p) == CRLF_MARK)    ++p;
+  while (at(p++) != (char) 254) {}               // Headers
+  if (type == (char) 126)                        // Quality scores
+    for (char c = at(p++); c != '\n' && c != (char) 253; c = at(p++)) {}
+
+  ofstream out(DEC_FNAME, std::ios::binary);
+  out.write(hdr.data(), (std::streamsize) p);
+
+  // Chunks, evenly spread. At least one
+  if (sample > 0) {
+    u64 nChunk = 0,  nTake = 0;
+    string chunk;
+    const auto write_chunk = [&] (u64 beg, u64 size) {
+      decrypt_range(beg, size, chunk);
+      out << (char) 253 << size << (char) 254;
+      out.write(chunk.data(), (std::streamsize) chunk.size());
+      ++nTake;
+    };
+    for (u64 pos = p, beg, size; next_chunk(pos, beg, size); ++nChunk)
+      if (sampled(nChunk))    write_chunk(beg, size);
+    u64 beg, size;
+    if (!nTake && next_chunk(p, beg, size))    write_chunk(beg, size);
+    if (verbose)
+      cerr << nTake << " of " << nChunk << " chunks have been sampled.\n";
+  }
+  out << (char) 252;
+  out.close();
+
+  const auto finish = high_resolution_clock::now();        // Stop timer
+  std::chrono::duration<double> elapsed = finish - start;  // Dur. (sec)
+  cerr << (verbose ? "Decryption done," : "Done,") << " in "
+       << std::fixed << setprecision(4) << elapsed.count() << " seconds.\n";
+  cerr << "Warning: unauthenticated partial output. To authenticate it, "
+          "decrypt\nthe whole file, with no --head or --sample.\n";
+}
+
+/**
+ * @brief  Find a chunk of a packed file, by decrypting its size only
+ * @param  pos   Position of the chunk, in the decrypted file. Goes to the
+ *               next chunk
+ * @param  beg   Beginning of the chunk, after its size
+ * @param  size  Size of the chunk
+ * @return false, at the end of the file
+ */
+bool EnDecrypto::next_chunk (u64& pos, u64& beg, u64& size) const {
+  string pre;                         // (char) 253, size, (char) 254
+  decrypt_range(pos, 2 + std::numeric_limits<u64>::digits10 + 1, pre);
+  if (pre.empty() || pre[0] != (char) 253)    return false;
+  const auto sizeEnd = pre.find((char) 254);
+  assert(sizeEnd == string::npos || sizeEnd == 1 ||
+         !digits(pre.substr(1, sizeEnd - 1)), WRONG_KEY);
+  size = stoull(pre.substr(1, sizeEnd - 1));
+  beg  = pos + sizeEnd + 1;
+  pos  = beg + size;
+  return true;
+}
+
+/**
+ * @brief  If a chunk is in the sample. The chunks sampled are evenly
+ *         spread: the fraction of the first c chunks sampled is about f
+ * @param  c  Chunk number
+ * @return true, if so
+ */
+bool EnDecrypto::sampled (u64 c) const {
+  return std::floor((c + 1) * sample + 0.5) != std::floor(c * sample + 0.5);
+}
+
+/**
+ * @brief  If a filter on the reads has been set, for decompression
+ * @return true, if so
+ */
+bool EnDecrypto::filtered () const {
+  return min_len || min_mean_qual > 0 || max_n_frac < 1 ||
+         !name_regex.empty();
+}
+
+/**
+ * @brief Load the reference, if one has been set, to map the sequences on
+ */
+void EnDecrypto::load_reference () {
+  if (reference.empty() || Ref.loaded())    return;
+  if (verbose)    cerr << "Indexing the reference \"" << reference << "\"...\n";
+  Ref.load(reference);
+  if (verbose)    cerr << Ref.size() << " bases in the reference.\n";
+}
+
+/**
+ * @brief Read the hash of the reference from the header of a packed file,
+ *        if there is, and load the reference. It must be the same file
+ * @param in  Packed file, after the shuffle flag
+ */
+void EnDecrypto::read_reference (std::ifstream& in) {
+  if (in.peek() != (byte) REF_MARK)    return;
+  in.ignore(1);
+  string hash(Ref.digest().size() ? Ref.digest().size() : 32, '\0');
+  in.read(&hash[0], (std::streamsize) hash.size());
+
+  assert(reference.empty(), "Error: the file has been packed with a "
+                            "reference. Set it by \"--reference\".\n");
+  load_reference();
+  assert(hash != Ref.digest(), "Error: the reference \"" + reference +
+                               "\" is not the one used for packing.\n");
+}
+
+/**
+ * @brief  Name of the category that packs an alphabet
+ * @param  len  Number of different symbols
+ * @return Name of the category
+ */
+string EnDecrypto::category (u64 len) const {
+  if      (len > MAX_C5)     return "3to2+X";       // # > 39
+  else if (len > MAX_C4)     return "3to2";         // Cat 5
+  else if (len > MAX_C3)     return "2to1";         // Cat 4
+  else if (len >= MIN_C3)    return "3to1";         // Cat 3
+  else if (len == C2)        return "5to1";         // Cat 2
+  else if (len == C1)        return "7to1";         // Cat 1
+  else                       return "1to1";
+}
+
+/**
+ * @brief End the telemetry of a chunk. Add it to the total and trace it
+ * @param threadID  Thread ID
+ * @param chunkNo   Chunk number in the file
+ * @param txtBytes  Bytes of text
+ * @param pkdBytes  Bytes of packed text
+ */
+void EnDecrypto::end_chunk_stat (byte threadID, u64 chunkNo, u64 txtBytes,
+                                 u64 pkdBytes) {
+  if (verbose || stats || trace) {
+    mutxEnDe.lock();//--------------------------------------------------------
+    ++KStat.nChunk;
+    KStat.txtBytes += txtBytes;
+    KStat.pkdBytes += pkdBytes;
+    KStat.escSeq   += chunkStat.escSeq;
+    KStat.escLarge += chunkStat.escLarge;
+    KStat.penalty  += chunkStat.penalty;
+    for (byte k = 0; k != N_STRM_KIND; ++k)
+      for (byte c = 0; c != N_CODEC; ++c)
+        KStat.codec[k][c] += chunkStat.codec[k][c];
+    KStat.refPiece  += chunkStat.refPiece;
+    KStat.refMapped += chunkStat.refMapped;
+    KStat.seqField  += chunkStat.seqField;
+    KStat.dupField  += chunkStat.dupField;
+    
+    if (trace)
+      cerr << "[trace] chunk="  << chunkNo  << " thread="  << (int) threadID
+           << " text="          << txtBytes << " packed="  << pkdBytes
+           << " esc_seq="       << chunkStat.escSeq
+           << " esc_large="     << chunkStat.escLarge
+           << " penalty="       << chunkStat.penalty
+           << " hdr="           << HdrCat
+           << (QsCat.empty() ? "" : " qs=" + QsCat)
+           << " codecs=" << codec_names(chunkStat) << '\n';
+    mutxEnDe.unlock();//------------------------------------------------------
+  }
+  
+  chunkStat = kstat_s();
+  strmNo    = 0;
+}
+
+/**
+ * @brief Print the telemetry of all chunks
+ * @param title  Title of the report
+ */
+void EnDecrypto::print_stat (const string& title) const {
+  if (!verbose && !stats)    return;
+  
+  // Per mille of the text bytes
+  const auto rate = [this] (u64 n) -> double {
+    return KStat.txtBytes ? 1000.0 * n / KStat.txtBytes : 0.0;
+  };
+  
+  cerr << title << " statistics:\n"
+       << "  Chunks                 " << KStat.nChunk   << '\n'
+       << "  Text bytes             " << KStat.txtBytes << '\n'
+       << "  Packed bytes           " << KStat.pkdBytes << '\n'
+       << std::fixed << setprecision(3)
+       << "  'X' escapes (DNA)      " << KStat.escSeq
+       << "  (" << rate(KStat.escSeq)   << " per mille)\n"
+       << "  XChar escapes (# > 39) " << KStat.escLarge
+       << "  (" << rate(KStat.escLarge) << " per mille)\n"
+       << "  Tail penalties         " << KStat.penalty
+       << "  (" << rate(KStat.penalty)  << " per mille)\n";
+  if (!HdrCat.empty())
+    cerr << "  Header category        " << HdrCat << '\n';
+  if (!QsCat.empty())
+    cerr << "  Quality score category " << QsCat  << '\n';
+  cerr << "  Streams by codec       " << codec_names(KStat) << '\n';
+  if (KStat.refPiece)
+    cerr << "  Mapped on reference    " << KStat.refMapped << " of "
+         << KStat.refPiece << " pieces  ("
+         << 100.0 * KStat.refMapped / KStat.refPiece << "%)\n";
+  if (KStat.dupField)
+    cerr << "  Duplicate sequences    " << KStat.dupField << " of "
+         << KStat.seqField << "  ("
+         << 100.0 * KStat.dupField / KStat.seqField << "%)\n";
+}
+
+/**
+ * @brief  Number of streams of each kind, by codec, e.g., "seq:2bit*3"
+ * @param  st  Telemetry
+ * @return Streams by codec
+ */
+string EnDecrypto::codec_names (const kstat_s& st) const {
+  static const char* kindName[N_STRM_KIND] = {"hdr", "seq", "qs", "layout",
+                                              "col"};
+  string names;
+  for (byte k = 0; k != N_STRM_KIND; ++k)
+    for (byte c = 0; c != N_CODEC; ++c)
+      if (st.codec[k][c]) {
+        if (!names.empty())    names += ',';
+        names += string(kindName[k]) + ':' + CODEC[c].name + '*' +
+                 to_string(st.codec[k][c]);
+      }
+  return names;
+}
+
+/**
+ * @brief Print the estimates made by analyzing a sample of the file
+ * @param fileSize   Size of the file
+ * @param smplBytes  Bytes of the file sampled
+ * @param hdrBytes   Bytes of the header of the packed file
+ * @param scanSec    Seconds spent to read the sample
+ * @param packSec    Seconds spent to pack and shuffle the sample
+ * @param compact    If FASTA/FASTQ is compacted. Then, the chars are gathered
+ *                   in a pass over the file and the chunks carry their size
+ */
+void EnDecrypto::print_estimate (u64 fileSize, u64 smplBytes, u64 hdrBytes,
+                                 double scanSec, double packSec,
+                                 bool compact) const {
+  if (!smplBytes || !KStat.nChunk)
+    throw runtime_error("Error: nothing to analyze in \"" + in_file + "\".\n");
+
+  const double scale    = (double) fileSize / smplBytes;
+  const double nChunk   = KStat.nChunk * scale;
+  const auto   chunkLen = to_string(KStat.pkdBytes / KStat.nChunk).size();
+  // Header, packed chunks, each with (char) 253 + size + (char) 254, the end
+  // of file and the tag of GCM
+  const double outSize  = hdrBytes + KStat.pkdBytes*scale +
+                          (compact ? nChunk*(chunkLen+2) + 1 : 0) + TAG_SIZE;
+  const u32    nCores   = std::thread::hardware_concurrency();
+  const u32    nThr     = (nCores && nCores < n_threads) ? nCores : n_threads;
+  const double ioSpeed  = scanSec > 0 ? smplBytes / scanSec : 1e12;
+  const double tScan    = compact ? fileSize / ioSpeed : 0;
+  const double tPack    = packSec * scale / nThr;
+  const double tJoin    = outSize / ioSpeed;
+  const double tEnc     = outSize / gcm_speed();
+  string timeLabel = "Time (" + to_string(nThr) + " threads)";
+  timeLabel.resize(23, ' ');
+
+  cerr << std::fixed << setprecision(4)
+       << "Estimates, from " << smplBytes << " of " << fileSize
+       << " bytes sampled:\n"
+       << "  Compaction ratio       " << fileSize / outSize << '\n'
+       << "  Output size            " << (u64) outSize << " bytes\n"
+       << "  Scratch space          " << (u64) (2*outSize) << " bytes\n"
+       << "  " << timeLabel << tScan + tPack + tJoin + tEnc << " seconds\n";
+  if (verbose)
+    cerr << "    Gathering chars    " << tScan << '\n'
+         << "    Packing, shuffling " << tPack << '\n'
+         << "    Joining            " << tJoin << '\n'
+         << "    Encrypting         " << tEnc  << '\n';
+}
@@ -10,7 +10,16 @@
 #ifndef CRYFA_ENDECRYPTO_H
 #define CRYFA_ENDECRYPTO_H
 
+#include <atomic>
+#include <array>
+#include <functional>
+#include <exception>
 #include "security.hpp"
+#include "membudget.hpp"
+#include "reference.hpp"
+#include "codec.hpp"
+#include "kmer.hpp"
+#include "seqstat.hpp"
 using std::string;
 using std::vector;
 
@@ -20,6 +29,77 @@ class EnDecrypto;
 typedef void (EnDecrypto::*packFP_t) (string&, const string&, const htbl_t&);
 typedef void (EnDecrypto::*unpackFP_t)
              (string&, string::iterator&, const vector<string>&);
+typedef std::array<string, N_STRM> strms_t;   /**< @brief Streams of a chunk*/
+
+/** @brief A stream of a chunk, e.g., headers. Each field ends with '\n' */
+struct stream_s {
+  byte       kind;              /**< @brief STRM_HDR, STRM_SEQ, ... */
+  packFP_t   packFP   = nullptr;/**< @brief Packing function, hdr/qs */
+  const htbl_t* map   = nullptr;/**< @brief Hash table for packing */
+  unpackFP_t unpackFP = nullptr;/**< @brief Unpacking fn. nullptr: # > 39 */
+  const vector<string>* unpack = nullptr;  /**< @brief Table for unpacking */
+  char       XChar    = 0;      /**< @brief Extra char, when # > 39 */
+};
+
+/**
+ * @brief Ends of the lines of a chunk, when the file has CR LF. The lines
+ *        with LF only are kept, as deltas
+ */
+struct eol_s {
+  string  lf;          /**< @brief Lines with LF only, varints */
+  u64     line = 0;    /**< @brief Lines so far @hideinitializer */
+  u64     next = 0;    /**< @brief Next line with LF only. Packing: after
+                                   the last one @hideinitializer */
+  citer_t i;           /**< @brief Position in lf, unpacking */
+};
+
+typedef bool (EnDecrypto::*encodeFP_t) (string&, const string&,
+                                        const stream_s&);
+typedef void (EnDecrypto::*decodeFP_t) (string&, string::iterator,
+                                        string::iterator, const stream_s&);
+
+/** @brief Codec of streams. The index in the registry is its ID */
+struct codec_s {
+  const char* name;     /**< @brief Name */
+  encodeFP_t  encode;   /**< @brief Encoder. false, if it doesn't apply */
+  decodeFP_t  decode;   /**< @brief Decoder */
+  bool        whole;    /**< @brief Also tried on the whole stream */
+};
+
+/** @brief Telemetry of the packing/unpacking kernels */
+struct kstat_s {
+  u64 nChunk   = 0;  /**< @brief Number of chunks @hideinitializer */
+  u64 txtBytes = 0;  /**< @brief Bytes of text @hideinitializer */
+  u64 pkdBytes = 0;  /**< @brief Bytes of packed text @hideinitializer */
+  u64 escSeq   = 0;  /**< @brief 'X' escapes in DNA bases @hideinitializer */
+  u64 escLarge = 0;  /**< @brief XChar escapes, when # > 39 @hideinitializer */
+  u64 penalty  = 0;  /**< @brief (char) 255 tail penalties @hideinitializer */
+  u64 codec[N_STRM_KIND][N_CODEC] = {};  /**< @brief Streams by codec */
+  u64 refPiece  = 0;  /**< @brief Pieces tried on reference @hideinitializer */
+  u64 refMapped = 0;  /**< @brief Pieces mapped on reference @hideinitializer*/
+  u64 seqField  = 0;  /**< @brief Sequences, on dedup @hideinitializer */
+  u64 dupField  = 0;  /**< @brief Duplicate sequences @hideinitializer */
+};
+
+/**
+ * @brief Codec picked for a stream of a chunk, by the trials. The same
+ *        stream of the next chunks of the thread takes it with no trials
+ */
+struct pick_s {
+  byte codec   = CDC_RAW; /**< @brief Codec ID @hideinitializer */
+  u64  txtSize = 0;       /**< @brief Size of the stream @hideinitializer */
+  u64  encSize = 0;       /**< @brief Size, encoded @hideinitializer */
+  u64  left    = 0;       /**< @brief Chunks left, to take it @hideinitializer*/
+};
+
+/** @brief Profile of a dataset family, to skip scanning the input file */
+struct profile_s {
+  string headers;        /**< @brief Chars of all headers */
+  string qscores;        /**< @brief Chars of all quality scores */
+  u32    blockLine = 0;  /**< @brief Lines in a chunk, before fitting to the
+                                     memory budget @hideinitializer */
+  u64    lineBytes = 0;  /**< @brief Max bytes of a line @hideinitializer */
+};
 
 /**
  * @brief Encryption/Decryption
@@ -39,36 +119,152 @@ class EnDecrypto : public Security
   auto pack_1to1 (string&, const string&, const htbl_t&) -> void;
   auto unpack_2B (string&, string::iterator&, const vector<string>&) -> void;
   auto unpack_1B (string&, string::iterator&, const vector<string>&) -> void;
+  auto enc_raw (string&, const string&, const stream_s&) -> bool;
+  auto dec_raw (string&, string::iterator, string::iterator,
+                const stream_s&) -> void;
+  auto enc_pack (string&, const string&, const stream_s&) -> bool;
+  auto dec_pack (string&, string::iterator, string::iterator,
+                 const stream_s&) -> void;
+  auto enc_pack_len (string&, const string&, const stream_s&) -> bool;
+  auto dec_pack_len (string&, string::iterator, string::iterator,
+                     const stream_s&) -> void;
+  auto enc_pack_fix (string&, const string&, const stream_s&) -> bool;
+  auto dec_pack_fix (string&, string::iterator, string::iterator,
+                     const stream_s&) -> void;
+  auto enc_2bit (string&, const string&, const stream_s&) -> bool;
+  auto dec_2bit (string&, string::iterator, string::iterator,
+                 const stream_s&) -> void;
+  auto enc_rans (string&, const string&, const stream_s&) -> bool;
+  auto dec_rans (string&, string::iterator, string::iterator,
+                 const stream_s&) -> void;
+  auto enc_deflate (string&, const string&, const stream_s&) -> bool;
+  auto dec_deflate (string&, string::iterator, string::iterator,
+                    const stream_s&) -> void;
+  auto enc_pack_deflate (string&, const string&, const stream_s&) -> bool;
+  auto dec_pack_deflate (string&, string::iterator, string::iterator,
+                         const stream_s&) -> void;
+  auto enc_cm (string&, const string&, const stream_s&) -> bool;
+  auto dec_cm (string&, string::iterator, string::iterator,
+               const stream_s&) -> void;
+  auto enc_rle (string&, const string&, const stream_s&) -> bool;
+  auto dec_rle (string&, string::iterator, string::iterator,
+                const stream_s&) -> void;
+  auto enc_ref (string&, const string&, const stream_s&) -> bool;
+  auto dec_ref (string&, string::iterator, string::iterator,
+                const stream_s&) -> void;
   auto shuffle_file () -> void;
   auto unshuffle_file () -> void;
+  auto analyze_file () -> void;
+  auto decrypt_part () -> void;
     
  protected:
-  string Hdrs;        /**< @brief Max: 39 values */
-  string QSs;         /**< @brief Max: 39 values */
-  string HdrsX;       /**< @brief Extended Hdrs */
-  string QSsX;        /**< @brief Extended QSs */
-  htbl_t HdrMap;      /**< @brief Hdrs hash table */
-  htbl_t QsMap;       /**< @brief QSs hash table */
-  u32    BlockLine;   /**< @brief Max block lines */
+  string  Hdrs;       /**< @brief Max: 39 values */
+  string  QSs;        /**< @brief Max: 39 values */
+  string  HdrsX;      /**< @brief Extended Hdrs */
+  string  QSsX;       /**< @brief Extended QSs */
+  htbl_t  HdrMap;     /**< @brief Hdrs hash table */
+  htbl_t  QsMap;      /**< @brief QSs hash table */
+  u32     BlockLine;  /**< @brief Max block lines */
+  u64     ChunkBytes; /**< @brief Max bytes of text in a chunk */
+  MemBudget budget;   /**< @brief Budget of memory, shared by threads */
+  string  HdrCat;     /**< @brief Category chosen for headers */
+  string  QsCat;      /**< @brief Category chosen for quality scores */
+  kstat_s KStat;      /**< @brief Telemetry of all chunks */
+  profile_s Prof;     /**< @brief Profile, saved or loaded */
+  bool    Profiled = false;  /**< @brief Alphabets loaded from a profile */
+  std::atomic<bool> ProfileMiss{false};  /**< @brief A symbol out of profile,
+                                              in a stream not packed */
+  bool    HdrSym[128];       /**< @brief Symbols of headers in the profile */
+  bool    QsSym[128];        /**< @brief Symbols of q scores in the profile */
+  char    QsBin[128];        /**< @brief Bin of each quality score */
+  string  Perm;              /**< @brief Order of reordered reads, encoded */
+  bool    Crlf = false;      /**< @brief Lines end with CR LF, in the file */
+  bool    NoEol = false;     /**< @brief The file doesn't end with LF */
+  bool    Legacy = false;    /**< @brief Archive of version 1, no streams */
+  std::exception_ptr ThreadErr;  /**< @brief Error of a thread, for main */
+  static thread_local kstat_s chunkStat;  /**< @brief Telemetry of a chunk */
+  static thread_local string::iterator chunkEnd; /**< @brief End of a chunk,
+                                                    while it is decoded */
+  static thread_local vector<pick_s> codecPick;  /**< @brief Codecs picked,
+                                                    by stream of a chunk */
+  static thread_local u64 strmNo;        /**< @brief Stream of the chunk */
+  static const codec_s CODEC[N_CODEC];    /**< @brief Registry of codecs */
+  static Reference Ref;                   /**< @brief Reference sequence */
+  static KmerCount Kmers;                 /**< @brief Counts of k-mers */
+  static SeqStat   Stats;                 /**< @brief Statistics of seqs */
   
   auto build_hash_tbl (htbl_t&, const string&, short) -> void;
   auto build_unpack_tbl (vector<string>&, const string&, u16) -> void;
+  auto cat_pack_fn (const string&, string&, htbl_t&, packFP_t) -> packFP_t;
+  auto cat_unpack_fn (const string&, vector<string>&, char&) -> unpackFP_t;
   auto dna_pack_idx (const string&) -> byte;
   auto large_pack_idx (const string&, const htbl_t&) -> u16;
   auto pack_seq (string&, const string&) -> void;
   auto unpack_seq (string&, string::iterator&) -> void;
   auto unpack_large (string&, string::iterator&, char,
                      const vector<string>&) -> void;
+  auto fixed_len (const string&) const -> u64;
+  auto dedup_fields (string&, string&, const string&) -> bool;
+  auto redup_fields (string&, citer_t&, citer_t, const string&) -> void;
+  auto encode_stream (string&, const string&, const stream_s&) -> void;
+  auto put_stream (string&, const string&, byte, const string&, u64, bool,
+                   const stream_s&) -> void;
+  auto decode_stream (string&, string::iterator&, const stream_s&) -> void;
+  auto skip_stream (string::iterator&) const -> void;
+  auto stream_end (string::iterator&) const -> string::iterator;
+  auto unpack_field (string&, string::iterator&, const stream_s&) -> void;
+  auto encode_chunk (string&, const strms_t&, const stream_s*) -> void;
+  auto decode_chunk (strms_t&, string::iterator&, const stream_s*) -> void;
+  auto count_chunk (string::iterator&, const stream_s*, byte, u64) -> void;
+  auto write_kmers () const -> void;
+  auto stat_chunk (string::iterator&, const stream_s*, byte, u64) -> void;
+  auto print_seq_stat (bool) const -> void;
   auto join_packed_files (const string&, const string&, char,
                           bool) const -> void;
-  auto join_unpacked_files () const -> void;
+  auto join_unpacked_files (std::ostream&) const -> void;
   auto join_shuffled_files () const -> void;
   auto join_unshuffled_files () const -> void;
+  auto block_size () const -> u64;
+  auto skip_block (std::ifstream&) const -> void;
+  auto fit_budget (u64, u32) -> void;
+  auto load_profile (char, string&, string&) -> void;
+  auto save_profile (char, const string&, const string&) const -> void;
+  auto in_profile (const string&, const bool*) const -> bool;
+  auto load_reference () -> void;
+  auto read_reference (std::ifstream&) -> void;
+  auto set_qual_bin () -> void;
+  auto bin_qs (string&) const -> void;
+  auto read_qual_bin (std::ifstream&) const -> void;
+  auto read_perm (std::ifstream&) -> void;
+  auto read_stats (std::ifstream&) const -> bool;
+  auto read_version (std::ifstream&) -> void;
+  auto guard (const std::function<void()>&) -> void;
+  auto rethrow () const -> void;
+  auto detect_crlf () -> void;
+  auto read_crlf (std::ifstream&) -> void;
+  auto detect_no_eol () -> void;
+  auto read_no_eol (std::ifstream&) -> void;
+  auto strip_cr (string&, eol_s&) const -> void;
+  auto encode_eol (string&, const eol_s&) -> void;
+  auto decode_eol (eol_s&, string::iterator&) -> void;
+  auto put_eol (string&, eol_s&) const -> void;
+  auto next_crlf (eol_s&) const -> bool;
+  auto next_chunk (u64&, u64&, u64&) const -> bool;
+  auto sampled (u64) const -> bool;
+  auto filtered () const -> bool;
+  auto category (u64) const -> string;
+  auto end_chunk_stat (byte, u64, u64, u64) -> void;
+  auto print_stat (const string&) const -> void;
+  auto codec_names (const kstat_s&) const -> string;
+  auto print_estimate (u64, u64, u64, double, double, bool) const -> void;
 
  private:
   auto pack_large (string&, const string&, const string&,
                    const htbl_t&) -> void;
   auto penalty_sym (char) const -> char;
+  auto key_len (const stream_s&) const -> u64;
+  auto unpack_field (char*&, citer_t&, citer_t, u64, const vector<string>&,
+                     byte, char) -> void;
   auto shuffle_block (byte) -> void;
   auto unshuffle_block (byte) -> void;
 };
@@ -12,7 +12,10 @@
 #include <mutex>
 #include <iomanip>      // setw, setprecision
 #include <cstring>
+#include <algorithm>
 #include "fasta.hpp"
+#include "statmutex.hpp"
+#include "assert.hpp"
 using std::chrono::high_resolution_clock;
 using std::thread;
 using std::cout;
@@ -23,7 +26,8 @@ using std::to_string;
 using std::setprecision;
 using std::memset;
 
-std::mutex mutxFA;    /**< @brief Mutex */
+StatMutex mutxFA("mutxFA");    /**< @brief Mutex */
+thread_local vector<char> Fasta::pieceBuf;
 
 /**
  * @brief Compress
@@ -34,22 +38,40 @@ void Fasta::compress () {
   string   headers;
   packfa_s pkStruct;    // Collection of inputs to pass to pack...
 
-  if (verbose)   cerr << "Calculating number of different characters...\n";
-  // Gather different chars in all headers and max length in all bases
-  gather_h_bs(headers);
+  // Load different chars in all headers from a profile, or gather them and
+  // max length in all bases, scanning the file
+  load_reference();
+  string noQs;
+  if (!profile_load.empty())
+    load_profile('A', headers, noQs);
+  else {
+    if (verbose) cerr << "Calculating number of different characters...\n";
+    gather_h_bs(headers);
+  }
+  detect_crlf();
+  detect_no_eol();
   // Show number of different chars in headers -- ignore '>'=62
   if (verbose)   cerr << "In headers, they are " << headers.length() << ".\n";
   
   // Set Hash table and pack function
   set_hashTbl_packFn(pkStruct, headers);
+  HdrCat = category(headers.length());
+  if (cache_stats)    Stats.init(n_threads, true);
 
   // Distribute file among threads, for reading and packing
   for (byte t=0; t != n_threads; ++t)
-    arrThr[t] = thread(&Fasta::pack, this, pkStruct, t);
+    arrThr[t] = thread(&Fasta::guard, this,
+                       [this, pkStruct, t] { pack(pkStruct, t); });
   for (auto& thr : arrThr)
     if (thr.joinable())    thr.join();
+  rethrow();
+  if (ProfileMiss)
+    cerr << "A symbol is out of the profile \"" << profile_load
+         << "\". Its streams have not been packed.\n";
+  if (!profile_save.empty())    save_profile('A', headers, "");
 
   if (verbose)    cerr << "Shuffling done!\n";
+  if (cache_stats)    Stats.merge();
 
   // Join partially packed and/or shuffled files
   join_packed_files(headers, "", 'A', false);
@@ -59,6 +81,7 @@ void Fasta::compress () {
 
   cerr << (verbose ? "Compaction done" : "Done") << ", in "
        << std::fixed << setprecision(4) << elapsed.count() << " seconds.\n";
+  print_stat("Compaction");
 
   // Cout encrypted content
   encrypt();
@@ -109,6 +132,13 @@ void Fasta::set_hashTbl_packFn (packfa_s& pkStruct, const string& headers) {
       pkStruct.packHdrFP = &EnDecrypto::pack_1to1;
     }
   }
+  
+  // Streams: headers, sequences, line lengths
+  pkStruct.strm[0].kind   = STRM_HDR;
+  pkStruct.strm[0].packFP = pkStruct.packHdrFP;
+  pkStruct.strm[0].map    = &HdrMap;
+  pkStruct.strm[1].kind   = STRM_SEQ;
+  pkStruct.strm[2].kind   = STRM_LAYOUT;
 }
 
 /**
@@ -117,52 +147,44 @@ void Fasta::set_hashTbl_packFn (packfa_s& pkStruct, const string& headers) {
  * @param threadID  Thread ID
  */
 void Fasta::pack (const packfa_s& pkStruct, byte threadID) {
-  packFP_t packHdr = pkStruct.packHdrFP;    // Function pointer
   ifstream in(in_file);
-  string   line, context, seq;
+  string   line, context;
   ofstream pkfile(PK_FNAME+to_string(threadID), std::ios_base::app);
+  bool     open = false;     // The last piece read doesn't end its line
 
-  // Lines ignored at the beginning
-  for (u64 l = (u64) threadID*BlockLine; l--;)    IGNORE_THIS_LINE(in);
+  // Chunks ignored at the beginning
+  for (u64 c = threadID; c--;)    skip_chunk(in, open);
 
-  while (in.peek() != EOF) {
+  for (u64 chunkNo = threadID; in.peek() != EOF; chunkNo += n_threads) {
+    budget.acquire(ChunkBytes * PK_MEM);
     context.clear();
-    seq.clear();
-
-    for (u64 l = BlockLine; l-- && getline(in, line).good();) {
-      // Header
-      if (line.front() == '>') {
-        // Previous seq
-        if (!seq.empty()) {
-            seq.pop_back();                      // Remove the last '\n'
-          pack_seq(context, seq);
-            context += (char) 254;
-        }
-        seq.clear();
-
-        // Header line
-        context += (char) 253;
-        (this->*packHdr) (context, line.substr(1), HdrMap);
-        context += (char) 254;
+    strms_t     txt;       // Streams of headers, sequences and line lengths
+    vector<u64> lineLen;   // Line lengths of the current sequence
+    eol_s       eol;       // Ends of the lines
+    u64 inBytes = 0;
+    stream_s    strm[N_STRM];
+    std::copy(pkStruct.strm, pkStruct.strm + N_STRM, strm);
+
+    while (inBytes <= chunk_fill()) {
+      const bool cont = open;              // Continues the piece before
+      if (!get_piece(in, line, open))    break;
+      inBytes += line.size() + !open;
+      if (!open)    strip_cr(line, eol);
+      const bool hdr = !cont && line[0]=='>';
+      // Out of the profile: the headers of the chunk are not packed, but
+      // encoded by the other codecs
+      if (Profiled && hdr && !in_profile(line, HdrSym)) {
+        strm[0].packFP = nullptr;
+        ProfileMiss    = true;
       }
-
-      // Empty line. (char) 252 instead of line feed
-      else if (line.empty()) { seq += (char) 252; }
-
-      // Sequence
-      else {
-        // (char) 252 instead of '\n' at the end of each seq line
-        seq += line;
-        seq += (char) 252;
-      }
-    }
-    if (!seq.empty()) {
-      seq.pop_back();                              // Remove the last '\n'
-
-      // The last seq
-      pack_seq(context, seq);
-      context += (char) 254;
+      add_line(txt, lineLen, line, hdr, open);
     }
+    end_seq(txt, lineLen);
+    if (cache_stats)
+      Stats.add_bases(threadID, chunkNo, txt[1].begin(), txt[1].end());
+    encode_chunk(context, txt, strm);
+    encode_eol(context, eol);
+    end_chunk_stat(threadID, chunkNo, inBytes, context.size());
     
     // Shuffle
     if (!stop_shuffle) {
@@ -184,15 +206,241 @@ void Fasta::pack (const packfa_s& pkStruct, byte threadID) {
     // Write header containing threadID for each partially packed file
     pkfile << THR_ID_HDR << to_string(threadID) << '\n';
     pkfile << context << '\n';
+    budget.release(ChunkBytes * PK_MEM);
 
     // Ignore to go to the next related chunk
-    for (u64 l = (u64) (n_threads-1)*BlockLine; l--;)  IGNORE_THIS_LINE(in);
+    for (u64 c = n_threads-1u; c--;)    skip_chunk(in, open);
   }
 
   pkfile.close();
   in.close();
 }
 
+/**
+ * @brief  Read a line, or a piece of a sequence line longer than a piece,
+ *         so that a long record, e.g., a chromosome on one line, is split
+ *         among chunks, to be packed and unpacked in parallel
+ * @param  in    Input file
+ * @param  line  Line, or piece, with no '\n'
+ * @param  open  In: the piece before doesn't end its line. Out: this one
+ * @return false, at the end of the file. The last line may have no '\n'
+ */
+inline bool Fasta::get_piece (ifstream& in, string& line, bool& open) const {
+  if (!open && in.peek() == '>') {                      // Header, as a whole
+    open = false;
+    return !getline(in, line).fail();
+  }
+  line.assign(pieceBuf.data(), read_piece(in, open));
+  return !line.empty() || in.good();
+}
+
+/**
+ * @brief  Skip a line, or a piece, as get_piece() reads it, with no copy
+ * @param  in    Input file
+ * @param  open  In: the piece before doesn't end its line. Out: this one
+ * @return Bytes, counted as in pack()
+ */
+inline u64 Fasta::skip_piece (ifstream& in, bool& open) const {
+  if (!open && in.peek() == '>') {                      // Header, as a whole
+    open = false;
+    IGNORE_THIS_LINE(in);
+    return (u64) in.gcount() + in.eof();
+  }
+  const auto n = read_piece(in, open);
+  return n + !open;
+}
+
+/**
+ * @brief Skip a chunk, as pack() reads it: pieces up to chunk_fill() bytes
+ * @param in    Input file
+ * @param open  In: the piece before doesn't end its line. Out: the last one
+ */
+inline void Fasta::skip_chunk (ifstream& in, bool& open) const {
+  for (u64 bytes = 0; bytes <= chunk_fill() && in.peek() != EOF;)
+    bytes += skip_piece(in, open);
+}
+
+/**
+ * @brief  Bytes of a chunk, up to which pieces are added to it. Chunks are
+ *         of bytes, not of lines, so that a line as long as a piece doesn't
+ *         make the chunks of short lines small. One more line, or piece,
+ *         fits in ChunkBytes
+ * @return Bytes
+ */
+inline u64 Fasta::chunk_fill () const {
+  return ChunkBytes - Prof.lineBytes;
+}
+
+/**
+ * @brief Set the lines of a chunk, for it to have a block, and a line more
+ * @param lineBytes  Max bytes of a line, or a piece
+ */
+void Fasta::set_block_line (u64 lineBytes) {
+  BlockLine = (u32) (block_size() / lineBytes + 2);
+  fit_budget(lineBytes, 2);
+}
+
+/**
+ * @brief  Read a piece of a sequence line into pieceBuf, which is sized once
+ * @param  in    Input file
+ * @param  open  Out: the piece doesn't end its line
+ * @return Bases of the piece
+ */
+inline size_t Fasta::read_piece (ifstream& in, bool& open) const {
+  const u64 piece = piece_len();
+  if (pieceBuf.size() != piece + 1)    pieceBuf.resize(piece + 1);
+  in.get(pieceBuf.data(), (std::streamsize) piece + 1, '\n');
+  const auto n = (size_t) in.gcount();
+  if (in.fail() && !in.eof())    in.clear();           // Empty line
+  open = false;
+  if (in.peek() == '\n')    in.ignore(1);
+  else if (n == piece)     open = in.good();
+  return n;
+}
+
+/**
+ * @brief  Max bases of a piece of a sequence line: about a block, in whole
+ *         triplets and bytes of 2-bit, so that the pieces pack as the line
+ * @return Bases
+ */
+inline u64 Fasta::piece_len () const {
+  return block_size() - block_size() % 12;
+}
+
+/**
+ * @brief Add a line to the streams. A header goes to the headers, and the
+ *        bases of sequence lines are gathered, up to the next header
+ * @param[in,out] txt      Streams: headers, sequences, line lengths
+ * @param[in,out] lineLen  Line lengths of the current sequence, doubled,
+ *                         plus 1 for a piece which doesn't end its line
+ * @param[in]     line     Line, or piece of a line
+ * @param[in]     hdr      If it is a header
+ * @param[in]     open     If it is a piece which doesn't end its line
+ */
+inline void Fasta::add_line (strms_t& txt, vector<u64>& lineLen,
+                             const string& line, bool hdr, bool open) {
+  // Header -- Ignore '>'
+  if (hdr) {
+    end_seq(txt, lineLen);                    // Previous seq
+    txt[0].append(line, 1, string::npos);
+    txt[0] += '\n';
+  }
+  // Sequence, or empty line
+  else {
+    txt[1] += line;
+    lineLen.push_back(line.size() << 1 | open);
+  }
+}
+
+/**
+ * @brief End the sequence gathered. Its line lengths go to the layout as
+ *        runs, e.g., "60x12,37" for 12 lines of 60 bases and one of 37, or
+ *        "8184+x2" for 2 pieces of a line which goes on. A chunk has one
+ *        sequence more than headers, the first one continuing the previous
+ *        chunk. Each one might be empty
+ * @param[in,out] txt      Streams: headers, sequences, line lengths
+ * @param[in,out] lineLen  Line lengths of the sequence
+ */
+inline void Fasta::end_seq (strms_t& txt, vector<u64>& lineLen) {
+  txt[1] += '\n';
+  
+  for (auto l = lineLen.begin(); l != lineLen.end();) {
+    const auto run = std::find_if(l, lineLen.end(),
+                                  [l] (u64 len) { return len != *l; });
+    if (l != lineLen.begin())    txt[2] += ',';
+    txt[2] += to_string(*l >> 1);
+    if (*l & 1)    txt[2] += '+';
+    if (run - l > 1) { txt[2] += 'x';    txt[2] += to_string(run - l); }
+    l = run;
+  }
+  txt[2] += '\n';
+  lineLen.clear();
+}
+
+/**
+ * @brief Analyze. Predict the category, the compaction ratio and the time by
+ *        packing blocks sampled across the file
+ */
+void Fasta::analyze () {
+  stats = true;             // The estimates are made from the telemetry
+  load_reference();
+  ifstream in(in_file);
+  in.seekg(0, std::ios::end);
+  const auto fileSize = (u64) in.tellg();
+  const u64  nBlock   =
+    (fileSize > SMPL_N_BLOCK*SMPL_BLOCK_SIZE) ? SMPL_N_BLOCK : 1;
+  vector<vector<string>> smpl(nBlock);    // Lines of the sampled blocks
+  u64 smplBytes = 0;
+  
+  // Read the sampled blocks, each starting at the beginning of a line
+  auto start = high_resolution_clock::now();
+  for (u64 b = 0; b != nBlock; ++b) {
+    in.clear();
+    in.seekg((std::streamoff) (b * (fileSize / nBlock)));
+    if (b)    IGNORE_THIS_LINE(in);            // Partial line
+    
+    string line;
+    for (u64 bytes = 0; (nBlock == 1 || bytes < SMPL_BLOCK_SIZE) &&
+                        getline(in, line).good(); bytes += line.size()+1) {
+      smpl[b].push_back(line);
+      smplBytes += line.size() + 1;
+    }
+  }
+  in.close();
+  std::chrono::duration<double> scanSec = high_resolution_clock::now() - start;
+  
+  // Gather chars of the sampled headers & max length of lines
+  u32  maxBLen=0, maxHLen=0, nHdr=0;
+  bool hChars[256];
+  memset(hChars, false, 256);
+  for (const auto& block : smpl)
+    for (const auto& line : block) {
+      if (line[0] == '>') {
+        for (char c : line)    hChars[(byte) c] = true;
+        if (line.size() > maxHLen)    maxHLen = (u32) line.size();
+        ++nHdr;
+      }
+      else if (line.size() > maxBLen)    maxBLen = (u32) line.size();
+    }
+  set_block_line(std::max(maxBLen, maxHLen) + 1u);
+  
+  string headers;
+  for (byte i = 32; i != 62;  ++i)    if (*(hChars+i))  headers += i;
+  for (byte i = 63; i != 127; ++i)    if (*(hChars+i))  headers += i;
+  
+  packfa_s pkStruct;
+  set_hashTbl_packFn(pkStruct, headers);
+  HdrCat = category(headers.length());
+  
+  // Pack and shuffle the sample, chunk by chunk
+  start = high_resolution_clock::now();
+  for (const auto& block : smpl)
+    for (auto line = block.begin(); line != block.end();) {
+      strms_t     txt;
+      vector<u64> lineLen;
+      u64         txtBytes = 0;
+      for (; txtBytes <= chunk_fill() && line != block.end(); ++line) {
+        txtBytes += line->size() + 1;
+        add_line(txt, lineLen, *line, (*line)[0] == '>', false);
+      }
+      end_seq(txt, lineLen);
+      string context;
+      encode_chunk(context, txt, pkStruct.strm);
+      if (!stop_shuffle)    shuffle(context);
+      end_chunk_stat(0, KStat.nChunk, txtBytes, context.size());
+    }
+  std::chrono::duration<double> packSec = high_resolution_clock::now() - start;
+  
+  cerr << "Analysis of \"" << in_file << "\" (FASTA):\n"
+       << "  Header characters      " << headers.length() << '\n'
+       << "  Headers sampled        " << nHdr << '\n'
+       << "  Max line length        " << maxBLen << '\n';
+  print_stat("Sample");
+  // File type, shuffle flag, version, headers, (char) 254
+  print_estimate(fileSize, smplBytes, headers.size() + 5,
+                 scanSec.count(), packSec.count(), true);
+}
+
 /**
  * @brief Gather chars of all headers & max length of DNA bases lines,
  *        excluding '>'
@@ -200,22 +448,25 @@ void Fasta::pack (const packfa_s& pkStruct, byte threadID) {
  */
 void Fasta::gather_h_bs (string& headers) {
   u32  maxBLen=0;           // Max length of each line of bases
-  bool hChars[127];
-  memset(hChars+32, false, 95);
+  u32  maxHLen=0;           // Max length of headers
+  bool hChars[256];
+  memset(hChars, false, 256);
   
   ifstream in(in_file);
   string   line;
-  while (getline(in, line).good()) {
-    if (line[0] == '>')
-      for (char c : line)    hChars[c] = true;
+  while (!getline(in, line).fail()) {
+    if (line[0] == '>') {
+      for (char c : line)    hChars[(byte) c] = true;
+      if (line.size() > maxHLen)    maxHLen = (u32) line.size();
+    }
     else
       if (line.size() > maxBLen)    maxBLen = (u32) line.size();
   }
   in.close();
   
-  // Number of lines read from input file while compression
-  BlockLine = (u32) (BLOCK_SIZE / maxBLen);
-  if (!BlockLine)   BlockLine = 2;
+  // Bytes of a chunk. Longer lines are read in pieces
+  maxBLen = (u32) std::min((u64) maxBLen, piece_len());
+  set_block_line(std::max(maxBLen, maxHLen) + 1u);
 
   // Gather the characters -- Ignore '>'=62 for headers
   for (byte i = 32; i != 62;  ++i)    if (*(hChars+i))  headers += i;
@@ -227,6 +478,7 @@ void Fasta::gather_h_bs (string& headers) {
  */
 void Fasta::decompress () {
   const auto start = high_resolution_clock::now();          // Start timer
+  budget.set_cap(max_memory);
   char       c;                   // Chars in file
   string     headers;
   unpackfa_s upkStruct;           // Collection of inputs to pass to unpack...
@@ -235,6 +487,17 @@ void Fasta::decompress () {
   
   in.ignore(1);                   // Jump over decText[0]==(char) 127
   in.get(c);    shuffled = (c==(char) 128); // Check if file had been shuffled
+  read_version(in);
+  read_reference(in);
+  if (read_stats(in)) {                 // Kept when packed: no unpacking
+    in.close();
+    const string decFileName = DEC_FNAME;
+    std::remove(decFileName.c_str());
+    print_seq_stat(false);
+    return;
+  }
+  read_crlf(in);
+  read_no_eol(in);
   while (in.get(c) && c != (char) 254)    headers += c;
   
   if (verbose)   // Show number of different chars in headers -- Ignore '>'=62
@@ -243,13 +506,19 @@ void Fasta::decompress () {
   
   // Header -- Set unpack table and unpack function
   set_unpackTbl_unpackFn(upkStruct, headers);
+  HdrCat = category(headers.length());
   
-  // Distribute file among threads, for reading and unpacking
-  using unpackHFP   = void (Fasta::*) (const unpackfa_s&, byte);
-  unpackHFP unpackH =
-    (headers.length() <= MAX_C5) ? &Fasta::unpack_hS : &Fasta::unpack_hL;
-  
-  for (byte t=0; t != n_threads; ++t) {
+  assert(filtered() && !kmer_k && !stats_archive,
+         "Error: the filters on reads are only for FASTQ.\n");
+  assert(Legacy && (kmer_k || stats_archive), "Error: --kmer-count and "
+         "--stats-archive need an archive of version 2, at least.\n");
+  if (kmer_k)    Kmers.init(kmer_k, n_threads, true);
+  if (stats_archive)    Stats.init(n_threads, true);
+
+  // Distribute file among threads, for reading and unpacking. For --head,
+  // the chunks are decrypted and unpacked one by one, instead
+  const auto chunkPos = (u64) in.tellg();
+  for (byte t=0; t != n_threads && !head; ++t) {
     in.get(c);
     if (c == (char) 253) {
       string chunkSizeStr;             // Chunk size (string) -- For unshuffling
@@ -259,7 +528,8 @@ void Fasta::decompress () {
       upkStruct.begPos    = in.tellg();
       upkStruct.chunkSize = offset;
   
-      arrThread[t] = thread(unpackH, this, upkStruct, t);
+      arrThread[t] = thread(&Fasta::guard, this,
+                            [this, upkStruct, t] { unpack(upkStruct, t); });
       
       // Jump to the beginning of the next chunk
       in.seekg((std::streamoff) offset, std::ios_base::cur);
@@ -270,6 +540,7 @@ void Fasta::decompress () {
   // Join threads
   for (auto& thr : arrThread)
     if (thr.joinable())    thr.join();
+  rethrow();
   
   if (verbose)    cerr << "Unshuffling done!\n";
   
@@ -278,14 +549,25 @@ void Fasta::decompress () {
   const string decFileName = DEC_FNAME;
   std::remove(decFileName.c_str());
   
-  // Join partially unpacked files
-  join_unpacked_files();
+  // Join partially unpacked files, or write the counts of k-mers, or the
+  // statistics, or the first records
+  if (kmer_k)
+    write_kmers();
+  else if (stats_archive) {
+    Stats.merge();
+    print_seq_stat(false);
+  }
+  else if (head)
+    unpack_head(upkStruct, chunkPos);
+  else
+    join_unpacked_files(cout);
   
   const auto finish = high_resolution_clock::now();        // Stop timer
   std::chrono::duration<double> elapsed = finish - start;  // Dur. (sec)
 
   cerr << (verbose ? "Decompression done" : "Done") << ", in "
        << std::fixed << setprecision(4) << elapsed.count() << " seconds.\n";
+  print_stat("Decompression");
 }
 
 /**
@@ -297,6 +579,7 @@ void Fasta::set_unpackTbl_unpackFn (unpackfa_s& upkStruct,
                                     const string& headers) {
   const size_t headersLen = headers.length();
   u16 keyLen_hdr = 0;
+  upkStruct.unpackHdrFP = nullptr;      // Stays nullptr, if # > 39
   
   if (headersLen > MAX_C5)                keyLen_hdr = KEYLEN_C5;
   else if (headersLen > MAX_C4) {                                     // Cat 5
@@ -328,25 +611,29 @@ void Fasta::set_unpackTbl_unpackFn (unpackfa_s& upkStruct,
 }
 
 /**
- * @brief Unpack: small header
+ * @brief Unpack
  * @param upkStruct  Unpack structure
  * @param threadID   Thread ID
  */
-void Fasta::unpack_hS (const unpackfa_s& upkStruct, byte threadID) {
-  unpackFP_t unpackHdr = upkStruct.unpackHdrFP;    // Function pointer
+void Fasta::unpack (const unpackfa_s& upkStruct, byte threadID) {
   pos_t      begPos    = upkStruct.begPos;
   u64        chunkSize = upkStruct.chunkSize;
   ifstream   in(DEC_FNAME);
   ofstream   upkfile(UPK_FNAME+to_string(threadID), std::ios_base::app);
-  string     upkhdrOut, upkSeqOut;
   
-  while (in.peek() != EOF) {
+  stream_s strm[N_STRM];
+  set_streams(strm, upkStruct);
+  
+  for (u64 chunkNo = threadID; in.peek() != EOF; chunkNo += n_threads) {
     char c;
+    const u64 memBytes = chunkSize * (shuffled ? UPK_MEM : 1);
+    budget.acquire(memBytes);
     in.seekg(begPos);      // Read the file from this position
     // Take a chunk of decrypted file
-    string decText;
-    for (u64 u = chunkSize; u--;) { in.get(c);    decText += c; }
+    string decText(chunkSize, '\0');
+    in.read(&decText[0], (std::streamsize) chunkSize);
     auto i = decText.begin();
+    chunkEnd = decText.end();
     pos_t endPos = in.tellg();   // Set the end position
 
     // Unshuffle
@@ -359,17 +646,25 @@ void Fasta::unpack_hS (const unpackfa_s& upkStruct, byte threadID) {
       unshuffle(i, chunkSize);
     }
 
-    upkfile << THR_ID_HDR + to_string(threadID) << '\n';
-    do {
-      if (*i == (char) 253) {                                       // Hdr
-        (this->*unpackHdr) (upkhdrOut, ++i, upkStruct.hdrUnpack);
-        upkfile << '>' << upkhdrOut << '\n';
-      }
-      else {                                                        // Seq
-        unpack_seq(upkSeqOut, i);
-        upkfile << upkSeqOut << '\n';
+    if (kmer_k || stats_archive) {     // Count, with no text
+      if (kmer_k)    count_chunk(i, strm, threadID, chunkNo);
+      else           stat_chunk(i, strm, threadID, chunkNo);
+      end_chunk_stat(threadID, chunkNo, 0, chunkSize);
+    }
+    else {
+      string out;
+      unpack_chunk(out, i, strm);
+      end_chunk_stat(threadID, chunkNo, out.size(), chunkSize);
+      in.seekg(endPos);
+      if (NoEol && in.peek() == 252 && !out.empty())  // Last line, with no LF
+        out.pop_back();
+      if (!out.empty() && out.back() != '\n') {  // Line goes on, next chunk
+        out += LINE_OPEN;
+        out += '\n';
       }
-    } while (++i != decText.end());        // If trouble: change "!=" to "<"
+      upkfile << THR_ID_HDR + to_string(threadID) << '\n' << out;
+    }
+    budget.release(memBytes);
 
     // Update the chunk size and positions (beg & end)
     for (byte t = n_threads; t--;) {
@@ -391,64 +686,122 @@ void Fasta::unpack_hS (const unpackfa_s& upkStruct, byte threadID) {
 }
 
 /**
- * @brief Unpack: large header
- * @param upkStruct  Unpack structure
- * @param threadID   Thread ID
+ * @brief Streams of a chunk: headers, sequences, line lengths
+ * @param[out] strm       Streams
+ * @param[in]  upkStruct  Unpack structure
  */
-void Fasta::unpack_hL (const unpackfa_s& upkStruct, byte threadID) {
-  pos_t    begPos    = upkStruct.begPos;
-  u64      chunkSize = upkStruct.chunkSize;
-  ifstream in(DEC_FNAME);
-  ofstream upkfile(UPK_FNAME+to_string(threadID), std::ios_base::app);
-  string   upkHdrOut, upkSeqOut;
-
-  while (in.peek() != EOF) {
-    char c;
-    in.seekg(begPos);      // Read the file from this position
-    // Take a chunk of decrypted file
-    string decText;
-    for (u64 u = chunkSize; u--;) { in.get(c);    decText += c; }
-    auto i = decText.begin();
-    pos_t endPos = in.tellg();   // Set the end position
+void Fasta::set_streams (stream_s* strm, const unpackfa_s& upkStruct) const {
+  strm[0].kind     = STRM_HDR;
+  strm[0].unpackFP = upkStruct.unpackHdrFP;
+  strm[0].unpack   = &upkStruct.hdrUnpack;
+  strm[0].XChar    = upkStruct.XChar_hdr;
+  strm[1].kind     = STRM_SEQ;
+  strm[2].kind     = STRM_LAYOUT;
+}
 
-    // Unshuffle
-    if (shuffled) {
-      mutxFA.lock();//----------------------------------------------------
-      if (verbose && shuffInProg)    cerr << "Unshuffling...\n";
-      shuffInProg = false;
-      mutxFA.unlock();//--------------------------------------------------
-  
-      unshuffle(i, chunkSize);
-    }
+/**
+ * @brief Unpack a chunk into lines: a sequence, then a header and a
+ *        sequence, ... The lines end as they had in the file
+ * @param[out]    out   Lines
+ * @param[in,out] i     Unshuffled chunk iterator
+ * @param[in]     strm  Streams
+ */
+void Fasta::unpack_chunk (string& out, string::iterator& i,
+                          const stream_s* strm) {
+  if (Legacy) {
+    unpack_legacy(out, i, strm);
+    return;
+  }
 
-    upkfile << THR_ID_HDR + to_string(threadID) << '\n';
-    do {
-      if (*i == (char) 253) {                                       // Hdr
-        unpack_large(upkHdrOut, ++i,
-                     upkStruct.XChar_hdr, upkStruct.hdrUnpack);
-        upkfile << '>' << upkHdrOut << '\n';
-      }
-      else {                                                        // Seq
-        unpack_seq(upkSeqOut, i);
-        upkfile << upkSeqOut << '\n';
+  strms_t txt;
+  eol_s   eol;
+  decode_chunk(txt, i, strm);
+  decode_eol(eol, i);
+
+  // Each line of the layout, and each sequence, ends with '\n'
+  assert(!txt[2].empty() && txt[2].back() != '\n', WRONG_KEY);
+  out.clear();
+  auto h = txt[0].begin(),  s = txt[1].begin();
+  for (auto l = txt[2].begin(); l != txt[2].end(); ++l, ++s) {
+    if (s != txt[1].begin()) {                                        // Hdr
+      const auto hEnd = std::find(h, txt[0].end(), '\n');
+      assert(hEnd == txt[0].end(), WRONG_KEY);
+      out += '>';    out.append(h, hEnd);    put_eol(out, eol);
+      h = hEnd + 1;
+    }
+    for (; *l != '\n'; l += (*l == ',')) {                            // Seq
+      u64 len = 0,  n = 1;
+      for (; isdigit(*l); ++l)    len = len*10 + (*l - '0');
+      const bool open = (*l == '+');           // Line goes on
+      l += open;
+      if (*l == 'x')
+        for (n = 0, ++l; isdigit(*l); ++l)    n = n*10 + (*l - '0');
+      assert(*l != ',' && *l != '\n', WRONG_KEY);
+      for (; n--; s += len) {
+        assert(len > (u64) (txt[1].end() - s), WRONG_KEY);
+        out.append(s, s+len);
+        if (!open)    put_eol(out, eol);
       }
-    } while (++i != decText.end());        // If trouble: change "!=" to "<"
-
-    // Update the chunk size and positions (beg & end)
-    for (byte t = n_threads; t--;) {
-      in.seekg(endPos);
-      in.get(c);
-      if (c == (char) 253) {
-        string chunkSizeStr;
-        while (in.get(c) && c != (char) 254)    chunkSizeStr += c;
+    }
+    assert(s == txt[1].end(), WRONG_KEY);
+  }
+}
 
-        chunkSize = stoull(chunkSizeStr);
-        begPos    = in.tellg();
-        endPos    = begPos + (pos_t) chunkSize;
-      }
+/**
+ * @brief Unpack a chunk of an archive of version 1: a header, as (char) 253
+ *        and the header packed, or the lines of a sequence packed, with
+ *        (char) 252 for '\n'. Each one is ended by (char) 254
+ * @param[out]    out   Lines
+ * @param[in,out] i     Unshuffled chunk iterator. It goes to the end
+ * @param[in]     strm  Streams
+ */
+void Fasta::unpack_legacy (string& out, string::iterator& i,
+                           const stream_s* strm) {
+  out.clear();
+  string field;
+  for (; i != chunkEnd; ++i) {
+    if (*i != (char) 253)    unpack_field(field, i, strm[1]);         // Seq
+    else {                                                            // Hdr
+      unpack_field(field, ++i, strm[0]);
+      out += '>';
     }
+    out += field;
+    out += '\n';
   }
+}
 
-  upkfile.close();
-  in.close();
+/**
+ * @brief Unpack the first records, for --head. The chunks are decrypted
+ *        one by one, until the header of the record after them
+ * @param upkStruct  Unpack structure
+ * @param pos        Position of the first chunk, in the decrypted file
+ */
+void Fasta::unpack_head (const unpackfa_s& upkStruct, u64 pos) {
+  stream_s strm[N_STRM];
+  set_streams(strm, upkStruct);
+
+  u64    nRec = 0;                // Records begun
+  bool   open = false;            // The last line goes on in this chunk
+  string decText, out;
+  for (u64 chunkNo = 0, beg, size;
+       nRec <= head && next_chunk(pos, beg, size); ++chunkNo) {
+    decrypt_range(beg, size, decText);
+    auto i = decText.begin();
+    chunkEnd = decText.end();
+    if (shuffled)    unshuffle(i, size);
+    unpack_chunk(out, i, strm);
+
+    auto e = out.cbegin();        // End of the lines to write
+    for (; e != out.cend(); open = false) {
+      if (!open && *e == '>' && ++nRec > head)    break;
+      e = std::find(e, out.cend(), '\n');
+      if (e == out.cend()) { open = true;    break; }
+      ++e;
+    }
+    u64 next = pos, nextBeg, nextSize;
+    const bool noEol = NoEol && e == out.cend() && !out.empty() &&
+                       !next_chunk(next, nextBeg, nextSize);  // Last line
+    cout.write(out.data(), e - out.cbegin() - noEol);
+    end_chunk_stat(0, chunkNo, (u64) (e - out.cbegin()), size);
+  }
 }
\ No newline at end of file
@@ -16,6 +16,7 @@
 /** @brief Packing FASTA */
 struct packfa_s {
   packFP_t packHdrFP;          /**< @brief Points to a header packing function */
+  stream_s strm[N_STRM];       /**< @brief Streams: hdr, seq, layout */
 };
 
 /** @brief Unpakcing FASTA */
@@ -35,14 +36,29 @@ class Fasta : public EnDecrypto
  public:
   auto compress () -> void;
   auto decompress () -> void;
+  auto analyze () -> void;
 
  private:
+  static thread_local vector<char> pieceBuf;  /**< @brief Read a piece in */
+
   auto gather_h_bs (string&) -> void;
   auto set_hashTbl_packFn (packfa_s&, const string&) -> void;
   auto pack (const packfa_s&, byte) -> void;
+  auto get_piece (std::ifstream&, string&, bool&) const -> bool;
+  auto skip_piece (std::ifstream&, bool&) const -> u64;
+  auto skip_chunk (std::ifstream&, bool&) const -> void;
+  auto chunk_fill () const -> u64;
+  auto set_block_line (u64) -> void;
+  auto read_piece (std::ifstream&, bool&) const -> size_t;
+  auto piece_len () const -> u64;
+  auto add_line (strms_t&, vector<u64>&, const string&, bool, bool) -> void;
+  auto end_seq (strms_t&, vector<u64>&) -> void;
   auto set_unpackTbl_unpackFn (unpackfa_s&, const string&) -> void;
-  auto unpack_hS (const unpackfa_s&, byte) -> void;
-  auto unpack_hL (const unpackfa_s&, byte) -> void;
+  auto unpack (const unpackfa_s&, byte) -> void;
+  auto set_streams (stream_s*, const unpackfa_s&) const -> void;
+  auto unpack_chunk (string&, string::iterator&, const stream_s*) -> void;
+  auto unpack_legacy (string&, string::iterator&, const stream_s*) -> void;
+  auto unpack_head (const unpackfa_s&, u64) -> void;
 };
 
 #endif //CRYFA_FASTA_H
\ No newline at end of file
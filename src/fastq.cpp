@@ -12,7 +12,13 @@
 #include <mutex>
 #include <iomanip>      // setw, setprecision
 #include <cstring>
+#include <deque>
+#include <algorithm>
+#include <sstream>
+#include <sys/resource.h>    // getrlimit
 #include "fastq.hpp"
+#include "statmutex.hpp"
+#include "assert.hpp"
 using std::chrono::high_resolution_clock;
 using std::thread;
 using std::cout;
@@ -23,7 +29,151 @@ using std::to_string;
 using std::setprecision;
 using std::memset;
 
-std::mutex mutxFQ;    /**< @brief Mutex */
+StatMutex mutxFQ("mutxFQ");    /**< @brief Mutex */
+
+namespace {
+/** @brief Unit of reordering: a read, or two mates */
+struct unit_s {
+  u64    key;     /**< @brief Minimizer */
+  u64    orig;    /**< @brief Number of the unit in the input */
+  u64    nLine;   /**< @brief Number of lines */
+  string rec;     /**< @brief Lines */
+};
+
+/**
+ * @brief  Minimizer of a sequence: the smallest hash of its canonical
+ *         k-mers, so that a read and its reverse complement have the same.
+ *         k-mers with other than A, C, G, T are skipped
+ * @param  seq  Sequence
+ * @return Minimizer. Max, if there is no k-mer
+ */
+u64 minimizer (const string& seq) {
+  constexpr u64 mask = (1ull << 2*RO_K) - 1;
+  u64 fwd=0, rev=0, run=0, best=~0ull;
+  for (char c : seq) {
+    u64 b;
+    switch (c) {
+      case 'A':  b = 0;    break;
+      case 'C':  b = 1;    break;
+      case 'G':  b = 2;    break;
+      case 'T':  b = 3;    break;
+      default:   run = 0;  continue;
+    }
+    fwd = (fwd << 2 | b) & mask;
+    rev = rev >> 2 | (3-b) << 2*(RO_K-1);
+    if (++run >= RO_K)
+      best = std::min(best, std::min(fwd, rev) * 0x9E3779B97F4A7C15ull);
+  }
+  return best;
+}
+
+/**
+ * @brief Strip '\r' from the end of a line, if it has, as made on Windows
+ * @param line  Line, with no '\n'
+ */
+void chop_cr (string& line) {
+  if (!line.empty() && line.back() == '\r')    line.pop_back();
+}
+
+/**
+ * @brief  Name of a read: its header up to a space, without /1 or /2
+ * @param  hdr  Header
+ * @return Name
+ */
+string read_name (const string& hdr) {
+  string name = hdr.substr(0, hdr.find(' '));
+  if (name.size() > 2 && name[name.size()-2] == '/')
+    name.resize(name.size() - 2);
+  return name;
+}
+
+/**
+ * @brief  Files which can be open for the buckets: the limit of open files,
+ *         with RO_FD_SPARE kept for the other files
+ * @return Number of files
+ */
+u64 bucket_files () {
+  rlimit lim;
+  if (getrlimit(RLIMIT_NOFILE, &lim) != 0 || lim.rlim_cur == RLIM_INFINITY)
+    return ~0ull;
+  return (u64) lim.rlim_cur > RO_FD_SPARE ? lim.rlim_cur - RO_FD_SPARE : 0;
+}
+
+/**
+ * @brief  Number of buckets, to sort a file in memory bucket by bucket.
+ *         Buckets are of bucketSize, up to RO_MAX_BUCKET of them, and as
+ *         many as the open files allow. Beyond that, they are larger
+ * @param  file        File name
+ * @param  bucketSize  Bytes of a bucket
+ * @param  nOpen       Files read at the same time, each with its buckets
+ * @return Number of buckets
+ */
+u64 n_bucket (const string& file, u64 bucketSize, u64 nOpen) {
+  const u64 maxBucket = bucket_files() / nOpen;     // A bucket and the file
+  assert(maxBucket < 2,
+    "Error: too few files can be open to reorder the reads. Raise the limit "
+    "of open files, e.g., with \"ulimit -n\".\n");
+
+  ifstream in(file, std::ios::ate);
+  return std::min(std::min((u64) in.tellg() / bucketSize + 1, RO_MAX_BUCKET),
+                  maxBucket - 1);
+}
+
+/**
+ * @brief Open a file of a bucket, for writing
+ * @param bucket  Bucket
+ * @param name    File name
+ */
+void open_bucket (ofstream& bucket, const string& name) {
+  bucket.open(name);
+  assert(!bucket.is_open(), "Error: failed to create \"" + name + "\".\n");
+}
+
+/**
+ * @brief Check the writes to a file of a bucket, then close it
+ * @param bucket  Bucket
+ * @param name    File name
+ */
+void close_bucket (ofstream& bucket, const string& name) {
+  bucket.close();
+  assert(bucket.fail(), "Error: failed to write \"" + name + "\".\n");
+}
+
+/**
+ * @brief Check that the lines of a unit have been read back from a bucket
+ * @param part   File of a bucket
+ * @param nLine  Lines expected
+ * @param nRead  Lines read
+ * @param name   File name
+ */
+void check_unit (const ifstream& part, u64 nLine, u64 nRead,
+                 const string& name) {
+  assert(part.bad() || nRead != nLine,
+         "Error: failed to read \"" + name + "\".\n");
+}
+
+/**
+ * @brief  Bytes of a bucket: RO_BUCKET_SIZE, or less, so that the buckets
+ *         sorted at the same time fit in the budget of memory
+ * @param  nSort  Buckets sorted at the same time
+ * @return Bytes of a bucket
+ */
+u64 bucket_size (byte nSort) {
+  if (!Param::max_memory)    return RO_BUCKET_SIZE;
+  return std::max(std::min(Param::max_memory / (RO_MEM * nSort),
+                           RO_BUCKET_SIZE), (u64) 1);
+}
+
+/**
+ * @brief  Size of a file
+ * @param  file  File name
+ * @return Bytes. 0: no file
+ */
+u64 file_size (const string& file) {
+  ifstream in(file, std::ios::ate);
+  return in ? (u64) in.tellg() : 0;
+}
+}
 
 /**
  * @brief  Check if the third line contains only +
@@ -35,7 +185,9 @@ bool Fastq::has_just_plus ()  const {
   
   IGNORE_THIS_LINE(in);    // Ignore header
   IGNORE_THIS_LINE(in);    // Ignore seq
-  bool justPlus = !(getline(in, line).good() && line.length() > 1);
+  const bool good = getline(in, line).good();
+  if (!line.empty() && line.back() == '\r')    line.pop_back();   // CR LF
+  bool justPlus = !(good && line.length() > 1);
 
   in.close();
   return justPlus;
@@ -58,9 +210,21 @@ void Fastq::compress () {
   string     headers, qscores;
   packfq_s   pkStruct;            // Collection of inputs to pass to pack...
 
-  if (verbose)    cerr << "Calculating number of different characters...\n";
-  // Gather different chars and max length in all headers and quality scores
-  gather_h_q(headers, qscores);
+  // Load different chars in all headers and quality scores from a profile,
+  // or gather them and max length, scanning the file
+  load_reference();
+  set_qual_bin();
+  detect_crlf();
+  detect_no_eol();
+  if (!profile_load.empty())
+    load_profile('Q', headers, qscores);
+  else {
+    if (verbose)  cerr << "Calculating number of different characters...\n";
+    gather_h_q(headers, qscores);
+  }
+  const string inFile = in_file;
+  if (!reorder.empty())    reorder_reads();       // in_file: reordered file
+
   // Show number of different chars in headers and qs -- Ignore '@'=64 in hdr
   if (verbose)
     cerr << "In headers, they are " << headers.length() << ".\n"
@@ -68,23 +232,38 @@ void Fastq::compress () {
   
   // Set Hash table and pack function
   set_hashTbl_packFn(pkStruct, headers, qscores);
+  HdrCat = category(headers.length());
+  QsCat  = category(qscores.length());
+  if (cache_stats)    Stats.init(n_threads, false);
 
   // Distribute file among threads, for reading and packing
   for (byte t=0; t != n_threads; ++t)
-    arrThread[t] = thread(&Fastq::pack, this, pkStruct, t);
+    arrThread[t] = thread(&Fastq::guard, this,
+                          [this, pkStruct, t] { pack(pkStruct, t); });
   for (auto& thr : arrThread)
     if (thr.joinable())    thr.join();
+  rethrow();
+  if (ProfileMiss)
+    cerr << "A symbol is out of the profile \"" << profile_load
+         << "\". Its streams have not been packed.\n";
+  if (!profile_save.empty())    save_profile('Q', headers, qscores);
 
   if (verbose)    cerr << "Shuffling done!\n";
+  if (cache_stats)    Stats.merge();
   
   // Join partially packed and/or shuffled files
   join_packed_files(headers, qscores, 'Q', has_just_plus());
+  if (!reorder.empty()) {
+    std::remove(RO_FNAME.c_str());
+    in_file = inFile;
+  }
 
   const auto finish = high_resolution_clock::now();        // Stop timer
   std::chrono::duration<double> elapsed = finish - start;  // Dur. (sec)
 
   cerr << (verbose ? "Compaction done" : "Done") << ", in "
        << std::fixed << setprecision(4) << elapsed.count() << " seconds.\n";
+  print_stat("Compaction");
 
   // Cout encrypted content
   encrypt();
@@ -176,6 +355,15 @@ void Fastq::set_hashTbl_packFn (packfq_s& pkStruct, const string& headers,
       pkStruct.packQSFPtr = &EnDecrypto::pack_1to1;
     }
   }
+  
+  // Streams: headers, sequences, quality scores
+  pkStruct.strm[0].kind   = STRM_HDR;
+  pkStruct.strm[0].packFP = pkStruct.packHdrFPtr;
+  pkStruct.strm[0].map    = &HdrMap;
+  pkStruct.strm[1].kind   = STRM_SEQ;
+  pkStruct.strm[2].kind   = STRM_QS;
+  pkStruct.strm[2].packFP = pkStruct.packQSFPtr;
+  pkStruct.strm[2].map    = &QsMap;
 }
 
 /**
@@ -184,33 +372,67 @@ void Fastq::set_hashTbl_packFn (packfq_s& pkStruct, const string& headers,
  * @param threadID  Thread ID
  */
 void Fastq::pack (const packfq_s &pkStruct, byte threadID) {
-  packFP_t packHdr = pkStruct.packHdrFPtr;    // Function pointer
-  packFP_t packQS  = pkStruct.packQSFPtr;     // Function pointer
   ifstream in(in_file);
   ofstream pkfile(PK_FNAME+to_string(threadID), std::ios_base::app);
+  assert(!in.is_open() || !pkfile.is_open(),
+         "Error: too many open files. Raise the limit, or use fewer threads.\n");
   
   // Lines ignored at the beginning
   for (u64 l = (u64) threadID*BlockLine; l--;)    IGNORE_THIS_LINE(in);
 
-  while (in.peek() != EOF) {
-    string context;  // Output string
+  for (u64 chunkNo = threadID; in.peek() != EOF; chunkNo += n_threads) {
+    budget.acquire(ChunkBytes * PK_MEM);
+    strms_t  txt;     // Streams of headers, sequences and quality scores
+    eol_s    eol;     // Ends of the lines
+    u64      inBytes = 0;
+    stream_s strm[N_STRM];
+    std::copy(pkStruct.strm, pkStruct.strm + N_STRM, strm);
   
     string line;
     for (u64 l = 0; l != BlockLine; l += 4) {  // Process 4 lines by 4 lines
-      if (getline(in, line).good()) {        // Header -- Ignore '@'
-          (this->*packHdr) (context, line.substr(1), HdrMap);
-          context += (char) 254;
+      if (!getline(in, line).fail()) {       // Header -- Ignore '@'
+          strip_cr(line, eol);
+          if (Profiled && !in_profile(line, HdrSym)) {  // Out of the
+            strm[0].packFP = nullptr;                   // profile: not
+            ProfileMiss    = true;                      // packed
+          }
+          txt[0].append(line, 1, string::npos);
+          txt[0] += '\n';
+          inBytes += line.size() + 1;
       }
-      if (getline(in, line).good()) {        // Sequence
-        pack_seq(context, line);
-          context += (char) 254;
+      if (!getline(in, line).fail()) {       // Sequence
+          strip_cr(line, eol);
+          txt[1] += line;
+          txt[1] += '\n';
+          inBytes += line.size() + 1;
       }
-      IGNORE_THIS_LINE(in);                  // +. ignore
-      if (getline(in, line).good()) {        // Quality score
-          (this->*packQS) (context, line, QsMap);
-          context += (char) 254;
+      if (!Crlf) {                           // +. ignore
+        inBytes += (u64) IGNORE_THIS_LINE(in).gcount();
+      }
+      else if (!getline(in, line).fail()) {  // Its end
+        strip_cr(line, eol);
+        inBytes += line.size() + 1;
+      }
+      if (!getline(in, line).fail()) {       // Quality score
+          strip_cr(line, eol);
+          bin_qs(line);
+          if (Profiled && !in_profile(line, QsSym)) {
+            strm[2].packFP = nullptr;
+            ProfileMiss    = true;
+          }
+          txt[2] += line;
+          txt[2] += '\n';
+          inBytes += line.size() + 1;
       }
     }
+    if (cache_stats) {
+      Stats.add_bases(threadID, chunkNo, txt[1].begin(), txt[1].end());
+      Stats.add_qs(threadID, txt[2].begin(), txt[2].end());
+    }
+    string context;  // Output string
+    encode_chunk(context, txt, strm);
+    encode_eol(context, eol);
+    end_chunk_stat(threadID, chunkNo, inBytes, context.size());
 
     // shuffle
     if (!stop_shuffle) {
@@ -232,6 +454,7 @@ void Fastq::pack (const packfq_s &pkStruct, byte threadID) {
     // Write header containing threadID for each
     pkfile << THR_ID_HDR << to_string(threadID) << '\n';
     pkfile << context << '\n';
+    budget.release(ChunkBytes * PK_MEM);
 
     // Ignore to go to the next related chunk
     for (u64 l = (u64) (n_threads-1)*BlockLine; l--;)  IGNORE_THIS_LINE(in);
@@ -241,6 +464,276 @@ void Fastq::pack (const packfq_s &pkStruct, byte threadID) {
   in.close();
 }
 
+/**
+ * @brief Reorder the reads by minimizer, for similar reads to be packed in
+ *        the same chunks. The reads are put in buckets by minimizer, in
+ *        parallel, then the buckets are sorted in memory, in parallel, and
+ *        joined into a file, which is packed instead of the input. Mates of
+ *        an interleaved paired file are one unit. With "keep", the order is
+ *        stored in Perm: unit, number of units, then the number of each in
+ *        the input, as zigzag deltas, deflated
+ */
+void Fastq::reorder_reads () {
+  if (verbose)    cerr << "Reordering...\n";
+  thread arrThread[n_threads];
+
+  // Interleaved paired: the reads of each of the first pairs have the same
+  // name. One pair alone may match by chance, e.g., with no names
+  ifstream in(in_file);
+  string   hdr1, hdr2;
+  byte     unit = 1;
+  for (u64 p = 0; p != RO_PAIR_SAMPLE; ++p) {
+    if (!getline(in, hdr1))    break;
+    for (byte l = 3; l--;)    IGNORE_THIS_LINE(in);
+    if (!getline(in, hdr2) || hdr1.size() < 2 || hdr2.size() < 2 ||
+        read_name(hdr1.substr(1)) != read_name(hdr2.substr(1))) {
+      unit = 1;
+      break;
+    }
+    for (byte l = 3; l--;)    IGNORE_THIS_LINE(in);
+    unit = 2;
+  }
+  in.close();
+  // Threads of bucketing: fewer, if the open files are not enough for two
+  // buckets each
+  const auto nThr = (byte) std::max(std::min((u64) n_threads,
+                                             bucket_files() / 3), (u64) 1);
+  const u64 nBucket   = n_bucket(in_file, bucket_size(nThr), nThr);
+  const u64 chunkLine = std::max((u64) BlockLine / (4*unit), (u64) 1) * 4*unit;
+
+  for (byte t = 0; t != nThr; ++t)
+    arrThread[t] = thread(&Fastq::guard, this, [=] {
+                            bucket_reads(nBucket, unit, chunkLine, t, nThr); });
+  for (auto& thr : arrThread)    if (thr.joinable())    thr.join();
+  rethrow();
+  for (byte t = 0; t != nThr; ++t)
+    arrThread[t] = thread(&Fastq::guard, this,
+                          [=] { sort_buckets(nBucket, t, nThr); });
+  for (auto& thr : arrThread)    if (thr.joinable())    thr.join();
+  rethrow();
+
+  // Join the sorted buckets
+  ofstream roFile;
+  string   order, line;
+  u64      nUnit=0, prev=0;
+  open_bucket(roFile, RO_FNAME);
+  for (u64 b = 0; b != nBucket; ++b) {
+    const string bucketName = RO_FNAME + "S" + to_string(b);
+    ifstream bucket(bucketName);
+    assert(!bucket.is_open(),
+           "Error: failed to open \"" + bucketName + "\".\n");
+    while (getline(bucket, line)) {
+      std::istringstream iss(line);
+      u64 orig, nLine, nRead = 0;
+      iss >> orig >> nLine;
+      const i64 delta = (i64) (orig - prev);
+      put_varint(order, (u64) (delta << 1 ^ delta >> 63));      // Zigzag
+      prev = orig;
+      ++nUnit;
+      for (; nRead != nLine && getline(bucket, line); ++nRead)
+        roFile << line << '\n';
+      check_unit(bucket, nLine, nRead, bucketName);
+    }
+    check_unit(bucket, 0, 0, bucketName);
+    bucket.close();
+    std::remove(bucketName.c_str());
+  }
+  close_bucket(roFile, RO_FNAME);
+
+  if (reorder == "keep") {
+    string perm;
+    put_varint(perm, unit);
+    put_varint(perm, nUnit);
+    perm += order;
+    deflate_encode(Perm, perm, PERM_DEFL_LEVEL);
+  }
+  in_file = RO_FNAME;
+}
+
+/**
+ * @brief Put the reads in buckets by minimizer. Each thread reads chunks,
+ *        as in packing, and has its own files of buckets
+ * @param nBucket    Number of buckets
+ * @param unit       Reads in a unit: 2, for interleaved mates
+ * @param chunkLine  Lines of a chunk
+ * @param threadID   Thread ID
+ * @param nThr       Threads of bucketing
+ */
+void Fastq::bucket_reads (u64 nBucket, byte unit, u64 chunkLine,
+                          byte threadID, byte nThr) {
+  ifstream in(in_file);
+  assert(!in.is_open(), "Error: failed to open \"" + in_file + "\".\n");
+  vector<ofstream> bucket(nBucket);
+  const auto name = [threadID] (u64 b) -> string {
+    return RO_FNAME + to_string(threadID) + "_" + to_string(b);
+  };
+  for (u64 b = 0; b != nBucket; ++b)    open_bucket(bucket[b], name(b));
+
+  // Lines ignored at the beginning
+  for (u64 l = threadID*chunkLine; l--;)    IGNORE_THIS_LINE(in);
+
+  string line;
+  for (u64 chunkNo = threadID; in.peek() != EOF; chunkNo += nThr) {
+    for (u64 l = 0; l != chunkLine && in.peek() != EOF; l += 4*unit) {
+      string rec;
+      u64    key = ~0ull,  nLine = 0;
+      for (; nLine != 4u*unit && getline(in, line); ++nLine) {
+        if (nLine % 4 == 1)    key = std::min(key, minimizer(line));
+        rec += line;
+        rec += '\n';
+      }
+      const u64 orig = (chunkNo*chunkLine + l) / (4*unit);
+      bucket[std::min(key / (~0ull / nBucket), nBucket - 1)]
+        << key << ' ' << orig << ' ' << nLine << '\n' << rec;
+    }
+
+    // Ignore to go to the next related chunk
+    for (u64 l = (nThr-1)*chunkLine; l--;)    IGNORE_THIS_LINE(in);
+  }
+  in.close();
+  for (u64 b = 0; b != nBucket; ++b)    close_bucket(bucket[b], name(b));
+}
+
+/**
+ * @brief Sort the buckets by minimizer, then by the order in the input.
+ *        Thread t sorts buckets t, t+nThr, ... Each bucket is acquired
+ *        from the budget of memory before it is loaded
+ * @param nBucket   Number of buckets
+ * @param threadID  Thread ID
+ * @param nThr      Threads of bucketing
+ */
+void Fastq::sort_buckets (u64 nBucket, byte threadID, byte nThr) {
+  string line;
+  for (u64 b = threadID; b < nBucket; b += nThr) {
+    u64 memBytes = 0;
+    for (byte t = 0; t != nThr; ++t)
+      memBytes += file_size(RO_FNAME + to_string(t) + "_" + to_string(b));
+    memBytes *= RO_MEM;
+    budget.acquire(memBytes);
+
+    vector<unit_s> units;
+    for (byte t = 0; t != nThr; ++t) {
+      const string partName = RO_FNAME + to_string(t) + "_" + to_string(b);
+      ifstream part(partName);
+      assert(!part.is_open(), "Error: failed to open \"" + partName + "\".\n");
+      while (getline(part, line)) {
+        unit_s u;
+        u64    nRead = 0;
+        std::istringstream(line) >> u.key >> u.orig >> u.nLine;
+        for (; nRead != u.nLine && getline(part, line); ++nRead) {
+          u.rec += line;
+          u.rec += '\n';
+        }
+        check_unit(part, u.nLine, nRead, partName);
+        units.push_back(std::move(u));
+      }
+      check_unit(part, 0, 0, partName);
+      part.close();
+      std::remove(partName.c_str());
+    }
+
+    std::sort(units.begin(), units.end(),
+              [] (const unit_s& a, const unit_s& z) -> bool {
+                return a.key != z.key ? a.key < z.key : a.orig < z.orig;
+              });
+    const string sortedName = RO_FNAME + "S" + to_string(b);
+    ofstream     sorted;
+    open_bucket(sorted, sortedName);
+    for (const auto& u : units)
+      sorted << u.orig << ' ' << u.nLine << '\n' << u.rec;
+    close_bucket(sorted, sortedName);
+    budget.release(memBytes);
+  }
+}
+
+/**
+ * @brief Restore the order of the reads, which is in Perm. The unpacked
+ *        reads are put in buckets by their number in the input, then the
+ *        buckets are sorted in memory and written to the output
+ */
+void Fastq::restore_order () {
+  string perm;
+  deflate_decode(perm, Perm.begin(), Perm.end());
+  citer_t   p       = perm.begin();
+  const auto unit   = (byte) get_varint(p, perm.end());
+  const u64 nUnit   = get_varint(p, perm.end());
+  const u64 nBucket = n_bucket(RO_FNAME, bucket_size(1), 1);
+  if (verbose)    cerr << "Restoring the order of the reads...\n";
+
+  ifstream         in(RO_FNAME);
+  vector<ofstream> bucket(nBucket);
+  const auto name = [] (u64 b) -> string {
+    return RO_FNAME + "R" + to_string(b);
+  };
+  assert(!in.is_open(), "Error: failed to open \"" + RO_FNAME + "\".\n");
+  for (u64 b = 0; b != nBucket; ++b)    open_bucket(bucket[b], name(b));
+  string line;
+  u64    orig = 0;
+  for (u64 u = 0; u != nUnit; ++u) {
+    const auto z = get_varint(p, perm.end());
+    orig += (u64) ((i64) (z >> 1) ^ -(i64) (z & 1));          // Zigzag
+    assert(orig >= nUnit, "Error: corrupted order of the reads.\n");
+    string rec;
+    u64    nLine = 0;
+    for (; nLine != 4u*unit && getline(in, line); ++nLine) {
+      rec += line;
+      rec += '\n';
+    }
+    bucket[orig * nBucket / nUnit] << orig << ' ' << nLine << '\n' << rec;
+  }
+  in.close();
+  std::remove(RO_FNAME.c_str());
+  for (u64 b = 0; b != nBucket; ++b)    close_bucket(bucket[b], name(b));
+
+  for (u64 b = 0; b != nBucket; ++b) {
+    const string bucketName = RO_FNAME + "R" + to_string(b);
+    const u64    memBytes   = file_size(bucketName) * RO_MEM;
+    budget.acquire(memBytes);
+    ifstream bk(bucketName);
+    assert(!bk.is_open(), "Error: failed to open \"" + bucketName + "\".\n");
+    vector<std::pair<u64, string>> units;
+    while (getline(bk, line)) {
+      std::istringstream iss(line);
+      u64 o, nLine, nRead = 0;
+      iss >> o >> nLine;
+      string rec;
+      for (; nRead != nLine && getline(bk, line); ++nRead) {
+        rec += line;
+        rec += '\n';
+      }
+      check_unit(bk, nLine, nRead, bucketName);
+      units.emplace_back(o, std::move(rec));
+    }
+    check_unit(bk, 0, 0, bucketName);
+    bk.close();
+    std::remove(bucketName.c_str());
+
+    std::sort(units.begin(), units.end(),
+              [] (const std::pair<u64, string>& a,
+                  const std::pair<u64, string>& z) -> bool {
+                return a.first < z.first;
+              });
+    for (const auto& u : units) {
+      const bool noEol = NoEol && u.first == nUnit - 1;   // Last line
+      if (!filtered()) {
+        cout.write(u.second.data(),
+                   (std::streamsize) (u.second.size() - noEol));
+        continue;
+      }
+      // Reads which have not passed the filters are empty: left out
+      for (auto r = u.second.begin(); r != u.second.end();) {
+        auto rEnd = r;
+        for (byte l = 4; l-- && rEnd != u.second.end();)
+          rEnd = std::find(rEnd, u.second.end(), '\n') + 1;
+        if (*r != '\n')
+          cout.write(&*r, rEnd - r - (noEol && rEnd == u.second.end()));
+        r = rEnd;
+      }
+    }
+    budget.release(memBytes);
+  }
+}
+
 /**
  * @brief Gather chars of all headers & quality scores, excluding '@' in headers
  * @param[out] headers  Chars of all headers
@@ -248,30 +741,34 @@ void Fastq::pack (const packfq_s &pkStruct, byte threadID) {
  */
 void Fastq::gather_h_q (string& headers, string& qscores) {
   u32  maxHLen=0,   maxQLen=0;       // Max length of headers & quality scores
-  bool hChars[127], qChars[127];
-  memset(hChars+32, false, 95);
-  memset(qChars+32, false, 95);
+  bool hChars[256], qChars[256];
+  memset(hChars, false, 256);
+  memset(qChars, false, 256);
 
   ifstream in(in_file);
   for (string line; !in.eof();) {
-    if (getline(in, line).good()) {
-      for (char c : line)           hChars[c] = true;
+    if (!getline(in, line).fail()) {
+      for (char c : line)           hChars[(byte) c] = true;
       if (line.size() > maxHLen)    maxHLen = (u32) line.size();
     }
 
     IGNORE_THIS_LINE(in);    // Ignore sequence
     IGNORE_THIS_LINE(in);    // Ignore +
 
-    if (getline(in, line).good()) {
-      for (char c : line)           qChars[c] = true;
+    if (!getline(in, line).fail()) {
+      if (Crlf)    chop_cr(line);
+      bin_qs(line);
+      for (char c : line)           qChars[(byte) c] = true;
       if (line.size() > maxQLen)    maxQLen = (u32) line.size();
     }
   }
   in.close();
 
   // Number of lines read from input file while compression
-  BlockLine = (u32) (4 * (BLOCK_SIZE / (maxHLen + 2*maxQLen)));
+  BlockLine = (u32) (4 * (block_size() / (maxHLen + 2*maxQLen)));
   if (!BlockLine)   BlockLine = 4;
+  // Max bytes of a line: 4 lines are header, seq, '+' (+ header) and qs
+  fit_budget((2*maxHLen + 2*maxQLen + 4 + 3) / 4, 4);
 
   // Gather the characters -- ignore '@'=64 for headers
   for (byte i = 32; i != 64;  ++i)    if (*(hChars+i))  headers += i;
@@ -279,11 +776,119 @@ void Fastq::gather_h_q (string& headers, string& qscores) {
   for (byte i = 32; i != 127; ++i)    if (*(qChars+i))  qscores += i;
 }
 
+/**
+ * @brief Analyze. Predict the categories, the compaction ratio and the time
+ *        by packing blocks sampled across the file
+ */
+void Fastq::analyze () {
+  stats = true;             // The estimates are made from the telemetry
+  load_reference();
+  set_qual_bin();
+  detect_crlf();
+  ifstream in(in_file);
+  in.seekg(0, std::ios::end);
+  const auto fileSize = (u64) in.tellg();
+  const u64  nBlock   =
+    (fileSize > SMPL_N_BLOCK*SMPL_BLOCK_SIZE) ? SMPL_N_BLOCK : 1;
+  vector<string> smpl;      // Sampled records, 4 lines each
+  u64 smplBytes = 0;
+  
+  // A record starts with '@', has '+' at the beginning of the third line and
+  // has the same length of sequence and quality score
+  const auto is_record = [] (const std::deque<string>& rec) -> bool {
+    return rec.size()==4 && !rec[0].empty() && rec[0][0]=='@' &&
+           !rec[2].empty() && rec[2][0]=='+' && rec[1].size()==rec[3].size();
+  };
+
+  // Read the sampled blocks, each starting at the beginning of a record
+  auto start = high_resolution_clock::now();
+  for (u64 b = 0; b != nBlock; ++b) {
+    in.clear();
+    in.seekg((std::streamoff) (b * (fileSize / nBlock)));
+    if (b)    IGNORE_THIS_LINE(in);            // Partial line
+    
+    std::deque<string> rec;
+    string line;
+    while (rec.size() != 4 && getline(in, line))    rec.push_back(line);
+    for (byte shift = 4; shift-- && rec.size()==4 && !is_record(rec);) {
+      rec.pop_front();
+      if (getline(in, line))    rec.push_back(line);
+    }
+  
+    for (u64 bytes = 0; is_record(rec) &&
+                        (nBlock == 1 || bytes < SMPL_BLOCK_SIZE);) {
+      for (const auto& l : rec) { smpl.push_back(l);    bytes += l.size()+1; }
+      if (Crlf)
+        for (auto l = smpl.end() - 4; l != smpl.end(); ++l)    chop_cr(*l);
+      smplBytes += rec[0].size() + rec[1].size() + rec[2].size() +
+                   rec[3].size() + 4;
+      rec.clear();
+      while (rec.size() != 4 && getline(in, line))    rec.push_back(line);
+    }
+  }
+  in.close();
+  std::chrono::duration<double> scanSec = high_resolution_clock::now() - start;
+
+  // Gather chars of the sampled headers & quality scores, as gather_h_q
+  u32  maxHLen=0,   maxQLen=0;
+  bool hChars[256], qChars[256];
+  memset(hChars, false, 256);
+  memset(qChars, false, 256);
+  for (auto r = smpl.begin(); r != smpl.end(); r += 4) {
+    for (char c : *r)        hChars[(byte) c] = true;
+    bin_qs(*(r+3));
+    for (char c : *(r+3))    qChars[(byte) c] = true;
+    if (r->size() > maxHLen)        maxHLen = (u32) r->size();
+    if ((r+3)->size() > maxQLen)    maxQLen = (u32) (r+3)->size();
+  }
+  BlockLine = (u32) (4 * (block_size() / (maxHLen + 2*maxQLen)));
+  if (!BlockLine)   BlockLine = 4;
+  
+  string headers, qscores;
+  for (byte i = 32; i != 64;  ++i)    if (*(hChars+i))  headers += i;
+  for (byte i = 65; i != 127; ++i)    if (*(hChars+i))  headers += i;
+  for (byte i = 32; i != 127; ++i)    if (*(qChars+i))  qscores += i;
+
+  packfq_s pkStruct;
+  set_hashTbl_packFn(pkStruct, headers, qscores);
+  HdrCat = category(headers.length());
+  QsCat  = category(qscores.length());
+  
+  // Pack and shuffle the sample, chunk by chunk
+  start = high_resolution_clock::now();
+  for (auto r = smpl.begin(); r != smpl.end();) {
+    strms_t txt;
+    u64     txtBytes = 0;
+    for (u64 l = 0; l != BlockLine && r != smpl.end(); l += 4, r += 4) {
+      txt[0].append(*r, 1, string::npos);    txt[0] += '\n';
+      txt[1] += *(r+1);                      txt[1] += '\n';
+      txt[2] += *(r+3);                      txt[2] += '\n';
+      txtBytes += r->size() + (r+1)->size() + (r+3)->size() + 2;
+    }
+    string context;
+    encode_chunk(context, txt, pkStruct.strm);
+    if (!stop_shuffle)    shuffle(context);
+    end_chunk_stat(0, KStat.nChunk, txtBytes, context.size());
+  }
+  std::chrono::duration<double> packSec = high_resolution_clock::now() - start;
+
+  cerr << "Analysis of \"" << in_file << "\" (FASTQ):\n"
+       << "  Header characters      " << headers.length() << '\n'
+       << "  Quality score chars    " << qscores.length() << '\n'
+       << "  Records sampled        " << smpl.size() / 4  << '\n';
+  print_stat("Sample");
+  // File type, shuffle flag, version, headers, (char) 254, q scores,
+  // (char) 253/'\n'
+  print_estimate(fileSize, smplBytes, headers.size() + qscores.size() + 6,
+                 scanSec.count(), packSec.count(), true);
+}
+
 /**
  * @brief Decompress
  */
 void Fastq::decompress () {
   const auto start = high_resolution_clock::now();          // Start timer
+  budget.set_cap(max_memory);
   char       c;                   // Chars in file
   string     headers, qscores;
   unpackfq_s upkStruct;           // Collection of inputs to pass to unpack...
@@ -292,6 +897,24 @@ void Fastq::decompress () {
 
   in.ignore(1);                   // Jump over decText[0]==(char) 126
   in.get(c);    shuffled = (c==(char) 128); // Check if file had been shuffled
+  read_version(in);
+  read_reference(in);
+  read_qual_bin(in);
+  read_perm(in);
+  if ((head || sample > 0) && !Perm.empty()) {
+    Perm.clear();
+    cerr << "The reads had been reordered. They are written in the packed "
+            "order.\n";
+  }
+  if (read_stats(in)) {                 // Kept when packed: no unpacking
+    in.close();
+    const string decFileName = DEC_FNAME;
+    std::remove(decFileName.c_str());
+    print_seq_stat(true);
+    return;
+  }
+  read_crlf(in);
+  read_no_eol(in);
   while (in.get(c) && c != (char) 254)                 headers += c;
   while (in.get(c) && c != '\n' && c != (char) 253)    qscores += c;
   if (c == '\n')    justPlus = false;                 // If 3rd line is just +
@@ -305,14 +928,26 @@ void Fastq::decompress () {
   
   // Header -- Set unpack table and unpack function
   set_unpackTbl_unpackFn(upkStruct, headers, qscores);
+  HdrCat = category(headers.length());
+  QsCat  = category(qscores.length());
   
-  // Distribute file among threads, for reading and unpacking
-  using unpackHQFP = void (Fastq::*) (const unpackfq_s&, byte);
-  unpackHQFP unpackHQ = (headers.length() <= MAX_C5)
-    ?(qscores.length() <= MAX_C5 ? &Fastq::unpack_hS_qS : &Fastq::unpack_hS_qL)
-    :(qscores.length() >  MAX_C5 ? &Fastq::unpack_hL_qL : &Fastq::unpack_hL_qS);
-  
-  for (byte t=0; t != n_threads; ++t) {
+  assert(Legacy && (filtered() || kmer_k || stats_archive), "Error: the "
+         "filters on reads, --kmer-count and --stats-archive need an archive "
+         "of version 2, at least.\n");
+  if (kmer_k)    Kmers.init(kmer_k, n_threads, false);
+  if (stats_archive)    Stats.init(n_threads, false);
+  if (!name_regex.empty()) {
+    try { nameRe = std::regex(name_regex, std::regex::optimize); }
+    catch (const std::regex_error&) {
+      throw std::runtime_error("Error: bad pattern of names \"" + name_regex
+                               + "\".\n");
+    }
+  }
+
+  // Distribute file among threads, for reading and unpacking. For --head,
+  // the chunks are decrypted and unpacked one by one, instead
+  const auto chunkPos = (u64) in.tellg();
+  for (byte t=0; t != n_threads && !head; ++t) {
     in.get(c);
     if (c == (char) 253) {
       string chunkSizeStr;   // Chunk size (string) -- For unshuffling
@@ -322,7 +957,8 @@ void Fastq::decompress () {
       upkStruct.begPos    = in.tellg();
       upkStruct.chunkSize = offset;
 
-      arrThread[t] = thread(unpackHQ, this, upkStruct, t);
+      arrThread[t] = thread(&Fastq::guard, this,
+                            [this, upkStruct, t] { unpack(upkStruct, t); });
 
       // Jump to the beginning of the next chunk
       in.seekg((std::streamoff) offset, std::ios_base::cur);
@@ -333,6 +969,7 @@ void Fastq::decompress () {
   // Join threads
   for (auto& thr : arrThread)
     if (thr.joinable())    thr.join();
+  rethrow();
 
   if (verbose)    cerr << "Unshuffling done!\n";
 
@@ -341,14 +978,34 @@ void Fastq::decompress () {
   const string decFileName = DEC_FNAME;
   std::remove(decFileName.c_str());
   
-  // Join partially unpacked files
-  join_unpacked_files();
+  // Join partially unpacked files. Restore the order, if it was kept. Or
+  // write the counts of k-mers, or the statistics, which don't depend on
+  // the order, or the first records
+  if (kmer_k)
+    write_kmers();
+  else if (stats_archive) {
+    Stats.merge();
+    print_seq_stat(true);
+  }
+  else if (head)
+    unpack_head(upkStruct, chunkPos);
+  else if (Perm.empty())
+    join_unpacked_files(cout);
+  else {
+    ofstream roFile(RO_FNAME);
+    join_unpacked_files(roFile);
+    roFile.close();
+    restore_order();
+  }
+  if (verbose && filtered())
+    cerr << nPass << " of " << nRead << " reads passed the filters.\n";
   
   const auto finish = high_resolution_clock::now();        // Stop timer
   std::chrono::duration<double> elapsed = finish - start;  // Dur. (sec)
 
   cerr << (verbose ? "Decompression done," : "Done,") << " in "
        << std::fixed << setprecision(4) << elapsed.count() << " seconds.\n";
+  print_stat("Decompression");
 }
 
 /**
@@ -362,6 +1019,8 @@ void Fastq::set_unpackTbl_unpackFn (unpackfq_s& upkStruct, const string& headers
   const auto headersLen = headers.length();
   const auto qscoresLen = qscores.length();
   u16 keyLen_hdr=0,  keyLen_qs=0;
+  upkStruct.unpackHdrFPtr = nullptr;    // Stays nullptr, if # > 39
+  upkStruct.unpackQSFPtr  = nullptr;
   
   // Header
   if (headersLen > MAX_C5)                keyLen_hdr = KEYLEN_C5;
@@ -435,27 +1094,31 @@ void Fastq::set_unpackTbl_unpackFn (unpackfq_s& upkStruct, const string& headers
 }
 
 /**
- * @brief Unpack: small header, small quality score.
- *        '@' at the beginning of headers not packed
+ * @brief Unpack. '@' at the beginning of headers not packed
  * @param upkStruct  Unpack structure
  * @param threadID   Thread ID
  */
-void Fastq::unpack_hS_qS (const unpackfq_s& upkStruct, byte threadID) {
-  unpackFP_t unpackHdr = upkStruct.unpackHdrFPtr;    // Function pointer
-  unpackFP_t unpackQS  = upkStruct.unpackQSFPtr;     // Function pointer
+void Fastq::unpack (const unpackfq_s& upkStruct, byte threadID) {
   pos_t      begPos    = upkStruct.begPos;
   u64        chunkSize = upkStruct.chunkSize;
   ifstream   in(DEC_FNAME);
   ofstream   upkfile(UPK_FNAME+to_string(threadID), std::ios_base::app);
-  string     upkHdrOut, upkSeqOut, upkQsOut;
+  assert(!in.is_open() || !upkfile.is_open(),
+         "Error: too many open files. Raise the limit, or use fewer threads.\n");
+  
+  stream_s strm[N_STRM];
+  set_streams(strm, upkStruct);
 
-  while (in.peek() != EOF) {
+  for (u64 chunkNo = threadID; in.peek() != EOF; chunkNo += n_threads) {
     char c;
+    const u64 memBytes = chunkSize * (shuffled ? UPK_MEM : 1);
+    budget.acquire(memBytes);
     in.seekg(begPos);      // Read the file from this position
     // Take a chunk of decrypted file
-    string decText;
-    for (u64 u = chunkSize; u--;) { in.get(c);    decText += c; }
+    string decText(chunkSize, '\0');
+    in.read(&decText[0], (std::streamsize) chunkSize);
     auto i = decText.begin();
+    chunkEnd = decText.end();
     pos_t endPos = in.tellg();   // Set the end position
 
     // Unshuffle
@@ -468,22 +1131,21 @@ void Fastq::unpack_hS_qS (const unpackfq_s& upkStruct, byte threadID) {
       unshuffle(i, chunkSize);
     }
 
-    upkfile << THR_ID_HDR + to_string(threadID) << '\n';
-    do {
-      upkfile << '@';
-      string plusMore;
-
-      (this->*unpackHdr) (upkHdrOut, i, upkStruct.hdrUnpack);
-      upkfile << (plusMore = upkHdrOut) << '\n';              ++i;  // Hdr
-  
-      unpack_seq(upkSeqOut, i);
-      upkfile << upkSeqOut << '\n';                                 // Seq
-
-      upkfile << (justPlus ? "+" : "+" + plusMore) << '\n';   ++i;  // +
-
-      (this->*unpackQS) (upkQsOut, i, upkStruct.qsUnpack);
-      upkfile << upkQsOut << '\n';                                  // Qs
-    } while (++i != decText.end());        // If trouble: change "!=" to "<"
+    if (kmer_k || stats_archive) {     // Count, with no text
+      if (kmer_k)    count_chunk(i, strm, threadID, chunkNo);
+      else           stat_chunk(i, strm, threadID, chunkNo);
+      end_chunk_stat(threadID, chunkNo, 0, chunkSize);
+    }
+    else {
+      string out;
+      unpack_chunk(out, i, strm);
+      in.seekg(endPos);
+      if (NoEol && Perm.empty() && in.peek() == 252 && !out.empty())
+        out.insert(out.end() - 1, LINE_OPEN);       // Last line, with no LF
+      upkfile << THR_ID_HDR + to_string(threadID) << '\n' << out;
+      end_chunk_stat(threadID, chunkNo, out.size(), chunkSize);
+    }
+    budget.release(memBytes);
 
     // Update the chunk size and positions (beg & end)
     for (byte t = n_threads; t--;) {
@@ -505,207 +1167,218 @@ void Fastq::unpack_hS_qS (const unpackfq_s& upkStruct, byte threadID) {
 }
 
 /**
- * @brief Unpack: small header, large quality score.
- *        '@' at the beginning of headers not packed
- * @param upkStruct  Unpack structure
- * @param threadID   Thread ID
+ * @brief Streams of a chunk: headers, sequences, quality scores
+ * @param[out] strm       Streams
+ * @param[in]  upkStruct  Unpack structure
  */
-void Fastq::unpack_hS_qL (const unpackfq_s& upkStruct, byte threadID) {
-  unpackFP_t unpackHdr = upkStruct.unpackHdrFPtr;    // Function pointer
-  pos_t      begPos    = upkStruct.begPos;
-  u64        chunkSize = upkStruct.chunkSize;
-  ifstream   in(DEC_FNAME);
-  ofstream   upkfile(UPK_FNAME+to_string(threadID), std::ios_base::app);
-  string     upkHdrOut, upkSeqOut, upkQsOut;
-
-  while (in.peek() != EOF) {
-    char c;
-    in.seekg(begPos);       // Read file from this position
-    // Take a chunk of decrypted file
-    string decText;
-    for (u64 u = chunkSize; u--;) { in.get(c);    decText += c; }
-    auto i = decText.begin();
-    pos_t endPos = in.tellg();    // Set the end position
-
-    // Unshuffle
-    if (shuffled) {
-      mutxFQ.lock();//----------------------------------------------------
-      if (verbose && shuffInProg)    cerr << "Unshuffling...\n";
-      shuffInProg = false;
-      mutxFQ.unlock();//--------------------------------------------------
-
-      unshuffle(i, chunkSize);
-    }
-
-    upkfile << THR_ID_HDR + to_string(threadID) << '\n';
-    do {
-      upkfile << '@';
-      string plusMore;
-
-      (this->*unpackHdr) (upkHdrOut, i, upkStruct.hdrUnpack);
-      upkfile << (plusMore = upkHdrOut) << '\n';               ++i; // Hdr
-  
-      unpack_seq(upkSeqOut, i);
-      upkfile << upkSeqOut << '\n';                                 // Seq
-
-      upkfile << (justPlus ? "+" : "+" + plusMore) << '\n';    ++i; // +
-  
-      unpack_large(upkQsOut, i, upkStruct.XChar_qs, upkStruct.qsUnpack);
-      upkfile << upkQsOut << '\n';                                  // Qs
-    } while (++i != decText.end());        // If trouble: change "!=" to "<"
+void Fastq::set_streams (stream_s* strm, const unpackfq_s& upkStruct) const {
+  strm[0].kind     = STRM_HDR;
+  strm[0].unpackFP = upkStruct.unpackHdrFPtr;
+  strm[0].unpack   = &upkStruct.hdrUnpack;
+  strm[0].XChar    = upkStruct.XChar_hdr;
+  strm[1].kind     = STRM_SEQ;
+  strm[2].kind     = STRM_QS;
+  strm[2].unpackFP = upkStruct.unpackQSFPtr;
+  strm[2].unpack   = &upkStruct.qsUnpack;
+  strm[2].XChar    = upkStruct.XChar_qs;
+}
 
-    // Update the chunk size and positions (beg & end)
-    for (byte t = n_threads; t--;) {
-      in.seekg(endPos);
-      in.get(c);
-      if (c == (char) 253) {
-        string chunkSizeStr;
-        while (in.get(c) && c != (char) 254)    chunkSizeStr += c;
+/**
+ * @brief Unpack a chunk into records, from a line of each stream. A read
+ *        which has not passed the filters is left out, or is empty, if
+ *        the order is restored. The lines end as they had in the file
+ * @param[out]    out   Records
+ * @param[in,out] i     Unshuffled chunk iterator
+ * @param[in]     strm  Streams
+ */
+void Fastq::unpack_chunk (string& out, string::iterator& i,
+                          const stream_s* strm) {
+  if (Legacy) {
+    unpack_legacy(out, i, strm);
+    return;
+  }
 
-        chunkSize = stoull(chunkSizeStr);
-        begPos    = in.tellg();
-        endPos    = begPos + (pos_t) chunkSize;
-      }
+  strms_t      txt;
+  vector<char> keep;              // If each read passes the filters
+  eol_s        eol;               // Ends of the lines
+  if (filtered())    decode_filter(txt, i, strm, keep);
+  else               decode_chunk(txt, i, strm);
+  decode_eol(eol, i);
+
+  out.clear();
+  if (txt[0].empty() && !Perm.empty())    out.assign(4*keep.size(), '\n');
+  auto h = txt[0].begin(),  s = txt[1].begin(),  q = txt[2].begin();
+  for (u64 r = 0; h != txt[0].end(); ++h, ++s, ++q, ++r) {
+    const auto hEnd = std::find(h, txt[0].end(), '\n');
+    const auto sEnd = std::find(s, txt[1].end(), '\n');
+    const auto qEnd = std::find(q, txt[2].end(), '\n');
+    if (!keep.empty() && !keep[r]) {
+      if (!Perm.empty())    out += "\n\n\n\n";
+      for (byte l = 4; l--;)    next_crlf(eol);
+      h = hEnd;    s = sEnd;    q = qEnd;
+      continue;
     }
+    out += '@';    out.append(h, hEnd);    put_eol(out, eol);         // Hdr
+    out.append(s, sEnd);                   put_eol(out, eol);         // Seq
+    out += '+';    if (!justPlus)  out.append(h, hEnd);
+                                           put_eol(out, eol);         // +
+    out.append(q, qEnd);                   put_eol(out, eol);         // Qs
+    h = hEnd;    s = sEnd;    q = qEnd;
   }
+}
 
-  upkfile.close();
-  in.close();
+/**
+ * @brief Unpack a chunk of an archive of version 1: the header, the sequence
+ *        and the quality scores of each record, packed, each one ended by
+ *        (char) 254
+ * @param[out]    out   Records
+ * @param[in,out] i     Unshuffled chunk iterator. It goes to the end
+ * @param[in]     strm  Streams
+ */
+void Fastq::unpack_legacy (string& out, string::iterator& i,
+                           const stream_s* strm) {
+  out.clear();
+  string hdr, field;
+  for (; i != chunkEnd; ++i) {
+    unpack_field(hdr, i, strm[0]);                                    // Hdr
+    out += '@';    out += hdr;    out += '\n';
+    unpack_field(field, ++i, strm[1]);                                // Seq
+    out += field;    out += '\n';
+    out += '+';    if (!justPlus)    out += hdr;    out += '\n';      // +
+    unpack_field(field, ++i, strm[2]);                                // Qs
+    out += field;    out += '\n';
+  }
 }
 
 /**
- * @brief Unpack: large header, small quality score.
- *        '@' at the beginning of headers not packed
+ * @brief Unpack the first records, for --head. The chunks are decrypted
+ *        one by one, until the records are written
  * @param upkStruct  Unpack structure
- * @param threadID   Thread ID
+ * @param pos        Position of the first chunk, in the decrypted file
  */
-void Fastq::unpack_hL_qS (const unpackfq_s& upkStruct, byte threadID) {
-  unpackFP_t unpackQS  = upkStruct.unpackQSFPtr;    // Function pointer
-  pos_t      begPos    = upkStruct.begPos;
-  u64        chunkSize = upkStruct.chunkSize;
-  ifstream   in(DEC_FNAME);
-  ofstream   upkfile(UPK_FNAME+to_string(threadID), std::ios_base::app);
-  string     upkHdrOut, upkSeqOut, upkQsOut;
-
-  while (in.peek() != EOF) {
-    char c;
-    in.seekg(begPos);       // Read file from this position
-    // Take a chunk of decrypted file
-    string decText;
-    for (u64 u = chunkSize; u--;) { in.get(c);    decText += c; }
+void Fastq::unpack_head (const unpackfq_s& upkStruct, u64 pos) {
+  stream_s strm[N_STRM];
+  set_streams(strm, upkStruct);
+
+  u64    nRec = 0;                // Records written
+  string decText, out;
+  for (u64 chunkNo = 0, beg, size;
+       nRec != head && next_chunk(pos, beg, size); ++chunkNo) {
+    decrypt_range(beg, size, decText);
     auto i = decText.begin();
-    pos_t endPos = in.tellg();    // Set the end position
-
-    // Unshuffle
-    if (shuffled) {
-      mutxFQ.lock();//----------------------------------------------------
-      if (verbose && shuffInProg)    cerr << "Unshuffling...\n";
-      shuffInProg = false;
-      mutxFQ.unlock();//--------------------------------------------------
-
-      unshuffle(i, chunkSize);
-    }
-
-    upkfile << THR_ID_HDR + to_string(threadID) << '\n';
-    do {
-      upkfile << '@';
-      string plusMore;
-  
-      unpack_large(upkHdrOut, i, upkStruct.XChar_hdr, upkStruct.hdrUnpack);
-      upkfile << (plusMore = upkHdrOut) << '\n';              ++i;  // Hdr
-  
-      unpack_seq(upkSeqOut, i);
-      upkfile << upkSeqOut << '\n';                                 // Seq
-
-      upkfile << (justPlus ? "+" : "+" + plusMore) << '\n';   ++i;  // +
-
-      (this->*unpackQS) (upkQsOut, i, upkStruct.qsUnpack);
-      upkfile << upkQsOut << '\n';                                  // Qs
-    } while (++i != decText.end());        // If trouble: change "!=" to "<"
-
-    // Update the chunk size and positions (beg & end)
-    for (byte t = n_threads; t--;) {
-      in.seekg(endPos);
-      in.get(c);
-      if (c == (char) 253) {
-        string chunkSizeStr;
-        while (in.get(c) && c != (char) 254)    chunkSizeStr += c;
-
-        chunkSize = stoull(chunkSizeStr);
-        begPos    = in.tellg();
-        endPos    = begPos + (pos_t) chunkSize;
-      }
+    chunkEnd = decText.end();
+    if (shuffled)    unshuffle(i, size);
+    unpack_chunk(out, i, strm);
+
+    auto e = out.cbegin();        // End of the records to write
+    for (u64 l = 0; e != out.cend() && nRec != head; ++l) {
+      e = std::find(e, out.cend(), '\n') + 1;
+      if (l % 4 == 3)    ++nRec;
     }
+    u64 next = pos, nextBeg, nextSize;
+    const bool noEol = NoEol && e == out.cend() && !out.empty() &&
+                       !next_chunk(next, nextBeg, nextSize);  // Last line
+    cout.write(out.data(), e - out.cbegin() - noEol);
+    end_chunk_stat(0, chunkNo, (u64) (e - out.cbegin()), size);
   }
-
-  upkfile.close();
-  in.close();
 }
 
 /**
- * @brief Unpack: large header, large quality score.
- *        '@' at the beginning of headers not packed
- * @param upkStruct  Unpack structure
- * @param threadID   Thread ID
+ * @brief Decode the streams of a chunk, with the filters on the reads. The
+ *        cheap ones, on the lengths and the quality scores, are checked
+ *        first, then the fraction of N on the sequences, then the pattern
+ *        on the names. A stream is decoded only if a read is left, to be
+ *        checked or written, else it is skipped by its size
+ * @param[out]    txt   Streams: headers, sequences, quality scores. Empty,
+ *                      if no read has passed
+ * @param[in,out] i     Encoded chunk iterator. It goes to the end
+ * @param[in]     strm  Properties of the streams
+ * @param[out]    keep  If each read has passed the filters
  */
-void Fastq::unpack_hL_qL (const unpackfq_s& upkStruct, byte threadID) {
-  pos_t    begPos    = upkStruct.begPos;
-  u64      chunkSize = upkStruct.chunkSize;
-  ifstream in(DEC_FNAME);
-  ofstream upkfile(UPK_FNAME+to_string(threadID), std::ios_base::app);
-  string   upkHdrOut, upkSeqOut, upkQsOut;
-
-  while (in.peek() != EOF) {
-    char c;
-    in.seekg(begPos);       // Read file from this position
-    // Take a chunk of decrypted file
-    string decText;
-    for (u64 u = chunkSize; u--;) { in.get(c);    decText += c; }
-    auto i = decText.begin();
-    pos_t endPos = in.tellg();    // Set the end position
-
-    // Unshuffle
-    if (shuffled) {
-      mutxFQ.lock();//----------------------------------------------------
-      if (verbose && shuffInProg)    cerr << "Unshuffling...\n";
-      shuffInProg = false;
-      mutxFQ.unlock();//--------------------------------------------------
-      
-      unshuffle(i, chunkSize);
-    }
-    
-    upkfile << THR_ID_HDR + to_string(threadID) << '\n';
-    do {
-      upkfile << '@';
-      string plusMore;
-  
-      unpack_large(upkHdrOut, i, upkStruct.XChar_hdr, upkStruct.hdrUnpack);
-      upkfile << (plusMore = upkHdrOut) << '\n';              ++i;  // Hdr
-  
-      unpack_seq(upkSeqOut, i);
-      upkfile << upkSeqOut << '\n';                                 // Seq
+void Fastq::decode_filter (strms_t& txt, string::iterator& i,
+                           const stream_s* strm, vector<char>& keep) {
+  string::iterator beg[N_STRM];           // Beginning of each stream
+  for (byte s = 0; s != N_STRM; ++s) { beg[s] = i;    skip_stream(i); }
+
+  bool left = true;                       // A read is left
+  if (min_len || min_mean_qual > 0)
+    left = check_reads(txt, beg[2], strm[2], 2, keep, &Fastq::pass_qual);
+  if (left && max_n_frac < 1)
+    left = check_reads(txt, beg[1], strm[1], 1, keep, &Fastq::pass_n);
+  if (left && !name_regex.empty())
+    left = check_reads(txt, beg[0], strm[0], 0, keep, &Fastq::pass_name);
+
+  const auto nKeep = (u64) std::count(keep.begin(), keep.end(), 1);
+  nRead += keep.size();
+  nPass += nKeep;
+  if (!nKeep) {
+    for (auto& t : txt)    t.clear();
+    return;
+  }
+  for (byte s = 0; s != N_STRM; ++s)
+    if (txt[s].empty())    decode_stream(txt[s], beg[s], strm[s]);
+}
 
-      upkfile << (justPlus ? "+" : "+" + plusMore) << '\n';   ++i;  // +
-  
-      unpack_large(upkQsOut, i, upkStruct.XChar_qs, upkStruct.qsUnpack);
-      upkfile << upkQsOut << '\n';                                  // Qs
-    } while (++i != decText.end());        // If trouble: change "!=" to "<"
+/**
+ * @brief  Decode a stream and check a filter on the reads which are left
+ * @param  txt   Streams
+ * @param  beg   Beginning of the encoded stream
+ * @param  strm  Properties of the stream
+ * @param  s     Stream number
+ * @param  keep  If each read has passed the filters, so far
+ * @param  pass  Filter on a line of the stream
+ * @return true, if a read is left
+ */
+bool Fastq::check_reads (strms_t& txt, string::iterator beg,
+                         const stream_s& strm, byte s, vector<char>& keep,
+                         passFP_t pass) {
+  decode_stream(txt[s], beg, strm);
+  const bool first = keep.empty();
+  bool left = false;
+  u64  r    = 0;
+  for (auto l = txt[s].cbegin(); l != txt[s].cend(); ++l, ++r) {
+    const auto lEnd = std::find(l, txt[s].cend(), '\n');
+    if (first)    keep.push_back(1);
+    if (keep[r] && !(this->*pass) (l, lEnd))    keep[r] = 0;
+    left |= (keep[r] != 0);
+    l = lEnd;
+  }
+  return left;
+}
 
-    // Update the chunk size and positions (beg & end)
-    for (byte t = n_threads; t--;) {
-      in.seekg(endPos);
-      in.get(c);
-      if (c == (char) 253) {
-        string chunkSizeStr;
-        while (in.get(c) && c != (char) 254)    chunkSizeStr += c;
+/**
+ * @brief  Filter on the length and the mean quality score of a read
+ * @param  beg  Beginning of the quality scores
+ * @param  end  End of the quality scores
+ * @return true, if passed
+ */
+bool Fastq::pass_qual (citer_t beg, citer_t end) const {
+  const auto len = (u64) (end - beg);
+  if (len < min_len)           return false;
+  if (min_mean_qual <= 0)      return true;
+  u64 sum = 0;
+  for (auto q = beg; q != end; ++q)    sum += (byte) *q - PHRED_OFF;
+  return len && sum >= min_mean_qual * len;
+}
 
-        chunkSize = stoull(chunkSizeStr);
-        begPos    = in.tellg();
-        endPos    = begPos + (pos_t) chunkSize;
-      }
-    }
-  }
+/**
+ * @brief  Filter on the fraction of N in a read
+ * @param  beg  Beginning of the sequence
+ * @param  end  End of the sequence
+ * @return true, if passed
+ */
+bool Fastq::pass_n (citer_t beg, citer_t end) const {
+  const auto nN = (u64) std::count_if(beg, end,
+                          [] (char c) { return c == 'N' || c == 'n'; });
+  return nN <= max_n_frac * (end - beg);
+}
 
-  upkfile.close();
-  in.close();
+/**
+ * @brief  Filter on the name of a read, by the pattern
+ * @param  beg  Beginning of the header, with no '@'
+ * @param  end  End of the header
+ * @return true, if passed
+ */
+bool Fastq::pass_name (citer_t beg, citer_t end) const {
+  return std::regex_search(beg, end, nameRe);
 }
\ No newline at end of file
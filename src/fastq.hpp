@@ -10,6 +10,8 @@
 #ifndef CRYFA_FASTQ_H
 #define CRYFA_FASTQ_H
 
+#include <regex>
+#include <atomic>
 #include "endecrypto.hpp"
 #include "security.hpp"
 
@@ -17,6 +19,7 @@
 struct packfq_s {
   packFP_t packHdrFPtr;      /**< @brief Points to a hdr packing function */
   packFP_t packQSFPtr;       /**< @brief Points to a qs packing function */
+  stream_s strm[N_STRM];     /**< @brief Streams: hdr, seq, qs */
 };
 
 /** @brief Unpakcing FASTQ */
@@ -31,6 +34,10 @@ struct unpackfq_s {
   unpackFP_t unpackQSFPtr;   /**< @brief Points to a qs unpacking function */
 };
 
+class Fastq;
+/** @brief Points to a filter on a line of a read */
+using passFP_t = bool (Fastq::*) (citer_t, citer_t) const;
+
 /**
  * @brief Compression/Decompression of FASTQ
  */
@@ -39,9 +46,13 @@ class Fastq : public EnDecrypto
  public:
   auto compress () -> void;
   auto decompress () -> void;
+  auto analyze () -> void;
   
  private:
   bool justPlus = true;     /**< @brief If line 3 is just +  @hideinitializer */
+  std::regex       nameRe;       /**< @brief Pattern of the names of reads */
+  std::atomic<u64> nRead {0};    /**< @brief Reads checked @hideinitializer */
+  std::atomic<u64> nPass {0};    /**< @brief Reads passed @hideinitializer */
   
   auto has_just_plus () const -> bool;
   auto gather_h_q (string&, string&) -> void;
@@ -49,10 +60,22 @@ class Fastq : public EnDecrypto
   auto pack (const packfq_s&, byte) -> void;
   auto set_unpackTbl_unpackFn (unpackfq_s&, const string&,
                                const string&) -> void;
-  auto unpack_hS_qS (const unpackfq_s&, byte) -> void;
-  auto unpack_hS_qL (const unpackfq_s&, byte) -> void;
-  auto unpack_hL_qS (const unpackfq_s&, byte) -> void;
-  auto unpack_hL_qL (const unpackfq_s&, byte) -> void;
+  auto unpack (const unpackfq_s&, byte) -> void;
+  auto set_streams (stream_s*, const unpackfq_s&) const -> void;
+  auto unpack_chunk (string&, string::iterator&, const stream_s*) -> void;
+  auto unpack_legacy (string&, string::iterator&, const stream_s*) -> void;
+  auto unpack_head (const unpackfq_s&, u64) -> void;
+  auto decode_filter (strms_t&, string::iterator&, const stream_s*,
+                      vector<char>&) -> void;
+  auto check_reads (strms_t&, string::iterator, const stream_s&, byte,
+                    vector<char>&, passFP_t) -> bool;
+  auto pass_qual (citer_t, citer_t) const -> bool;
+  auto pass_n (citer_t, citer_t) const -> bool;
+  auto pass_name (citer_t, citer_t) const -> bool;
+  auto reorder_reads () -> void;
+  auto bucket_reads (u64, byte, u64, byte, byte) -> void;
+  auto sort_buckets (u64, byte, byte) -> void;
+  auto restore_order () -> void;
 };
 
 #endif //CRYFA_FASTQ_H
\ No newline at end of file
@@ -12,7 +12,10 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <algorithm>
+#include <limits>
+#include <cstdlib>
 #include "assert.hpp"
 #include "def.hpp"
 using std::wifstream;
@@ -97,6 +100,108 @@ inline bool is_number (const string& s) {
                       [](char c) { return !std::isdigit(c); }) == s.end();
 }
 
+/**
+ * @brief  Check if a string is a decimal number, e.g., "0.05" or "30"
+ * @param  s  the input string
+ * @return Yes, if it is a decimal number
+ */
+inline bool is_decimal (const string& s) {
+  assert(s.empty(), "Error: the string is empty.\n");
+  const auto dot = s.find('.');
+  return s != "." && is_number(s.substr(0, dot)) &&
+         (dot == string::npos || s.size() == dot+1 ||
+          is_number(s.substr(dot+1)));
+}
+
+/**
+ * @brief  Convert a string to a number, with checking, instead of stoull(),
+ *         which throws no message of Cryfa
+ * @param  s    the input string
+ * @param  lo   Min
+ * @param  hi   Max
+ * @param  msg  the message shown if it is not a number from lo to hi
+ * @return Number
+ */
+inline u64 to_number (const string& s, u64 lo, u64 hi, const string& msg) {
+  assert(s.empty() || !is_number(s), msg);
+  u64 n = 0;
+  for (char c : s) {
+    const auto d = (u64) (c - '0');
+    assert(n > (std::numeric_limits<u64>::max() - d) / 10, msg);
+    n = n*10 + d;
+    assert(n > hi, msg);
+  }
+  assert(n < lo, msg);
+  return n;
+}
+
+/**
+ * @brief  Convert a string to a decimal number, with checking
+ * @param  s    the input string
+ * @param  lo   Min
+ * @param  hi   Max
+ * @param  msg  the message shown if it is not a number from lo to hi
+ * @return Number
+ */
+inline double to_decimal (const string& s, double lo, double hi,
+                          const string& msg) {
+  assert(s.empty() || !is_decimal(s), msg);
+  const double d = std::strtod(s.c_str(), nullptr);
+  assert(d < lo || d > hi, msg);
+  return d;
+}
+
+/**
+ * @brief  Convert a size to bytes
+ * @param  s  the input string, a number followed by K, M or G, e.g., "512M"
+ * @return Number of bytes
+ */
+inline u64 size_in_bytes (const string& s) {
+  assert(s.empty(), "Error: the size is empty.\n");
+  u64 unit = 1;
+  switch (s.back()) {
+    case 'k':  case 'K':  unit = 1024ull;                  break;
+    case 'm':  case 'M':  unit = 1024ull * 1024;           break;
+    case 'g':  case 'G':  unit = 1024ull * 1024 * 1024;    break;
+    default:                                               break;
+  }
+  const string num = (unit == 1) ? s : s.substr(0, s.size()-1);
+  return to_number(num, 0, std::numeric_limits<u64>::max() / unit,
+                   "Error: \"" + s + "\" is not a valid size.\n") * unit;
+}
+
+/**
+ * @brief  Bins of quality scores, by a map of ranges of Phred scores with
+ *         their bins, e.g., "0-9=6,10-29=20,30-93=37". The ranges may not
+ *         overlap. Other scores stay as they are
+ * @param  map  the map, as given after "custom:"
+ * @return Bin of each Phred score, 0 to 93
+ */
+inline vector<byte> qual_bins (const string& map) {
+  const string err = "Error: quality score bins must be \"illumina8\" or "
+                     "\"custom:LO-HI=BIN,...\", with Phred scores 0 to 93.\n";
+  assert(map.empty() || map.back() == ',' ||
+         map.find_first_not_of("0123456789-=,") != string::npos, err);
+  vector<byte> bin(PHRED_MAX + 1);
+  vector<bool> inRange(PHRED_MAX + 1, false);
+  for (byte q = 0; q <= PHRED_MAX; ++q)    bin[q] = q;
+
+  std::istringstream ss(map);
+  for (string range; getline(ss, range, ',');) {
+    u32  lo, hi, b;
+    char dash, eq;
+    std::istringstream rs(range);
+    assert(!(rs >> lo >> dash >> hi >> eq >> b) || !rs.eof() || dash != '-' ||
+           eq != '=' || lo > hi || hi > PHRED_MAX || b > PHRED_MAX, err);
+    for (u32 q = lo; q <= hi; ++q) {
+      assert(inRange[q], "Error: the ranges of quality score bins overlap.\n");
+      inRange[q] = true;
+      bin[q]     = (byte) b;
+    }
+  }
+  return bin;
+}
+
 /**
  * @brief Usage guide
  */
@@ -122,8 +227,8 @@ inline void help () {
      << "      Decrypt:                ./cryfa -k pass.txt -d enc > orig"<< '\n'
                                                                          << '\n'
      << "DESCRIPTION"                                                    << '\n'
-     << "      Compact & encrypt FASTA/FASTQ files."                     << '\n'
-     << "      Encrypt any text-based genomic data, e.g., VCF/SAM/BAM."  << '\n'
+     << "      Compact & encrypt FASTA/FASTQ/VCF/SAM/BED/GFF/GTF files." << '\n'
+     << "      Encrypt any text-based genomic data, e.g., BAM."          << '\n'
                                                                          << '\n'
      << "      -h,  --help"                                              << '\n'
      << "           usage guide"                                         << '\n'
@@ -137,12 +242,18 @@ inline void help () {
      << "      -d,  --dec"                                               << '\n'
      << "           decrypt & unpack"                                    << '\n'
                                                                          << '\n'
+     << "      --analyze"                                                << '\n'
+     << "           predict category, size and time, by sampling the input  \n"
+     << "           No output is made and no KEY_FILE is needed."        << '\n'
+                                                                         << '\n'
      << "      -f,  --force"                                             << '\n'
-     << "           force to consider input as non-FASTA/FASTQ"          << '\n'
+     << "           force to consider input as non-FASTA/FASTQ/VCF/SAM/  \n"
+     << "           BED/GFF/GTF"                                         << '\n'
      << "           Forces Cryfa not to compact, but shuffle and encrypt.    \n"
-     << "           If the input is FASTA/FASTQ, it is again considered as   \n"
-     << "           non-FASTA/FASTQ, therefore, compaction will be ignored,  \n"
-     << "           but shuffling and encryption will be performed."     << '\n'
+     << "           If the input is FASTA/FASTQ/VCF/SAM/BED/GFF/GTF, it is   \n"
+     << "           again considered as none of them, therefore,         \n"
+     << "           compaction will be ignored, but shuffling and            \n"
+     << "           encryption will be performed."                       << '\n'
                                                                          << '\n'
      << "      -v,  --verbose"                                           << '\n'
      << "           verbose mode (more information)"                     << '\n'
@@ -150,9 +261,104 @@ inline void help () {
      << "      -s,  --stop_shuffle"                                      << '\n'
      << "           stop shuffling the input"                            << '\n'
                                                                          << '\n'
+     << "      --stats"                                                  << '\n'
+     << "           print packing/unpacking and lock statistics"         << '\n'
+     << "           at the end"                                          << '\n'
+                                                                         << '\n'
+     << "      --trace"                                                  << '\n'
+     << "           print one line of statistics per chunk"              << '\n'
+                                                                         << '\n'
      << "      -t [NUMBER],  --thread [NUMBER]"                          << '\n'
      << "           number of threads"                                   << '\n'
                                                                          << '\n'
+     << "      --max-memory [SIZE]"                                      << '\n'
+     << "           max memory, e.g., 512M or 2G -- default: no limit"   << '\n'
+     << "           Threads wait for memory when it is exhausted, and the    \n"
+     << "           number of threads, the chunk size and the buckets of     \n"
+     << "           --reorder are fitted to it.                              \n"
+                                                                         << '\n'
+     << "      --deflate [LEVEL]"                                        << '\n'
+     << "           deflate level of the streams, after packing, from 1"  << '\n'
+     << "           (fast) to 9 (small). 0: off. Slower -- default: 0"   << '\n'
+                                                                         << '\n'
+     << "      --level [normal | max]"                                   << '\n'
+     << "           max: smallest sequences, by context mixing of order-k"<< '\n'
+     << "           models, e.g., for archiving. Slower -- default: normal \n"
+                                                                         << '\n'
+     << "      --dedup"                                                  << '\n'
+     << "           encode a sequence which is a duplicate of an earlier"<< '\n'
+     << "           one in the chunk by a reference to it, e.g., for"    << '\n'
+     << "           amplicon or PCR-heavy libraries. Larger chunks"      << '\n'
+                                                                         << '\n'
+     << "      --seekable"                                               << '\n'
+     << "           pack the sequences 3 bases in a byte, at a fixed"    << '\n'
+     << "           rate, and the other bases than A, C, G, T, N in a"   << '\n'
+     << "           side stream, so that the byte of a base is found"    << '\n'
+     << "           from its position, with no decoding. Larger"         << '\n'
+                                                                         << '\n'
+     << "      --reorder [keep | free]"                                  << '\n'
+     << "           reorder the reads of FASTQ by minimizer, for similar"<< '\n'
+     << "           reads to be packed together. keep: the order is"     << '\n'
+     << "           stored and restored. free: the order is lost. Mates" << '\n'
+     << "           of an interleaved paired file are moved together."   << '\n'
+     << "           Buckets sorted in memory take 256 MB each, less" << '\n'
+     << "           with --max-memory, or more for an input larger than" << '\n'
+     << "           32 GB, or with a low limit of open files, which"     << '\n'
+     << "           may also cut the threads of reordering."             << '\n'
+                                                                         << '\n'
+     << "      --qual-bin [illumina8 | custom:MAP]"                      << '\n'
+     << "           put quality scores of FASTQ in bins -- LOSSY"       << '\n'
+     << "           MAP: ranges of Phred scores and their bins, with no" << '\n'
+     << "           overlap, e.g., custom:0-9=6,10-29=20,30-93=37"       << '\n'
+                                                                         << '\n'
+     << "      --reference [REF_FILE]"                                   << '\n'
+     << "           FASTA file of a reference, to map the sequences on. The"<<'\n'
+     << "           same file is needed to decrypt & unpack."            << '\n'
+                                                                         << '\n'
+     << "      --stats-archive"                                          << '\n'
+     << "           print the base composition, GC and N percentages, and"<<'\n'
+     << "           histograms of the lengths and of the quality scores"<< '\n'
+     << "           of a packed file, with no unpacking. Instant, if it" << '\n'
+     << "           has been packed with --cache-stats."                 << '\n'
+                                                                         << '\n'
+     << "      --cache-stats"                                            << '\n'
+     << "           keep the statistics of --stats-archive in the packed"<< '\n'
+     << "           file, encrypted."                                    << '\n'
+                                                                         << '\n'
+     << "      --min-len [N], --min-mean-qual [Q], --max-n-frac [F]"    << '\n'
+     << "      --name-regex [PATTERN]"                                   << '\n'
+     << "           with -d, write only the reads of FASTQ which are at" << '\n'
+     << "           least N long, have a mean Phred score of at least Q,"<< '\n'
+     << "           a fraction of N of at most F (0 to 1), and a name"   << '\n'
+     << "           matching the pattern (ECMAScript). A chunk whose"    << '\n'
+     << "           reads all fail is not unpacked further."             << '\n'
+                                                                         << '\n'
+     << "      --head [N]"                                               << '\n'
+     << "           with -d, unpack only the first N records. Decrypting"<< '\n'
+     << "           stops as soon as they are written."                  << '\n'
+                                                                         << '\n'
+     << "      --sample [F]"                                             << '\n'
+     << "           with -d, unpack only a fraction F (0 to 1) of the"   << '\n'
+     << "           chunks of FASTQ, evenly spread. The rest are not"    << '\n'
+     << "           decrypted. Neither of them is authenticated, and the"<< '\n'
+     << "           reads are not put back in order, if reordered."      << '\n'
+                                                                         << '\n'
+     << "      --kmer-count [K] -o [FILE]"                               << '\n'
+     << "           with -d, count the canonical K-mers (1 <= K <= 32) of"<<'\n'
+     << "           the sequences into FILE, instead of unpacking."      << '\n'
+     << "           Headers and quality scores are not decoded."        << '\n'
+     << "           FILE: K, in a byte, the number of K-mers, then each" << '\n'
+     << "           K-mer and its count, sorted by K-mer, all in 64-bit"  << '\n'
+     << "           little endian. A K-mer is the smaller of its two"    << '\n'
+     << "           strands, 2 bits a base, A=0 C=1 G=2 T=3, the first"  << '\n'
+     << "           base in the high bits."                              << '\n'
+                                                                         << '\n'
+     << "      --profile [save:FILE | load:FILE]"                        << '\n'
+     << "           save/load the alphabets and the chunk size of a"     << '\n'
+     << "           FASTA/FASTQ file, to skip scanning it next time."    << '\n'
+     << "           A stream of a chunk with a symbol out of the"        << '\n'
+     << "           profile is not packed, but encoded by other codecs." << '\n'
+                                                                         << '\n'
      << "COPYRIGHT"                                                      << '\n'
      << "      Copyright (C) " << DEV_YEARS << ", IEETA, University of "
      <<                                                        "Aveiro." << '\n'
@@ -0,0 +1,285 @@
+/**
+ * @file      kmer.cpp
+ * @brief     Counting k-mers of sequences
+ * @author    Morteza Hosseini  (seyedmorteza@ua.pt)
+ * @author    Diogo Pratas      (pratas@ua.pt)
+ * @author    Armando J. Pinho  (ap@ua.pt)
+ * @copyright The GNU General Public License v3.0
+ */
+
+#include <fstream>
+#include <thread>
+#include <algorithm>
+#include <array>
+#include "kmer.hpp"
+#include "assert.hpp"
+using std::thread;
+
+namespace {
+/** @brief Codes of the bases: A, C, G, T: 0 to 3. Others: 4 */
+const byte* base_code () {
+  static const auto code = [] {
+    std::array<byte, 256> c;
+    c.fill(4);
+    c['A']=0;    c['C']=1;    c['G']=2;    c['T']=3;
+    c['a']=0;    c['c']=1;    c['g']=2;    c['t']=3;
+    return c;
+  }();
+  return code.data();
+}
+}
+
+/**
+ * @brief Set k and the tables
+ * @param k_       Length of the k-mers, 1 to 32
+ * @param nThread  Number of threads which count
+ * @param span_    Sequences might continue in the next chunk
+ */
+void KmerCount::init (byte k_, byte nThread, bool span_) {
+  k     = k_;
+  mask  = (k == 32) ? ~0ull : (1ull << 2*k) - 1;
+  shift = (byte) (2*k > KMER_PART_BITS ? 2*k - KMER_PART_BITS : 0);
+  span  = span_;
+  table.assign(nThread, vector<table_t>(1u << KMER_PART_BITS));
+  edges.assign(nThread, std::map<u64, edge_s>());
+}
+
+/**
+ * @brief Add a base to a k-mer, and count the k-mer, if it is complete
+ * @param thr   Thread ID
+ * @param r     Rolling state
+ * @param code  A, C, G, T: 0 to 3. Others: reset
+ */
+inline void KmerCount::push (byte thr, roll_s& r, byte code) {
+  if (code > 3) {
+    r.run = 0;
+    return;
+  }
+  r.fwd = (r.fwd << 2 | code) & mask;
+  r.rev = r.rev >> 2 | (u64) (3 - code) << 2*(k-1);
+  if (++r.run >= k) {
+    const u64 canon = std::min(r.fwd, r.rev);
+    ++table[thr][canon >> shift][canon];
+  }
+}
+
+/**
+ * @brief Keep the code of a base, if it is on an edge of the chunk
+ * @param e       Edges of the chunk. Not kept, if null
+ * @param field   Sequence number, in the chunk
+ * @param nField  Number of sequences, in the chunk
+ * @param pos     Position of the base, in the sequence
+ * @param len     Length of the sequence
+ * @param code    Code of the base
+ */
+inline void KmerCount::edge_code (edge_s* e, u64 field, u64 nField, u64 pos,
+                                  u64 len, byte code) const {
+  if (!e)    return;
+  if (field == 0 && pos + 1 < k)             e->head += (char) code;
+  if (field == nField-1 && pos + k > len)    e->tail += (char) code;
+}
+
+/**
+ * @brief Count the k-mers of lines of bases
+ * @param thr       Thread ID
+ * @param chunk     Chunk number
+ * @param beg       Beginning of the lines, each one ending with '\n'
+ * @param end       End of the lines
+ * @param fixedLen  A sequence every fixedLen bases, if not 0
+ */
+void KmerCount::add_bases (byte thr, u64 chunk, citer_t beg, citer_t end,
+                           u64 fixedLen) {
+  const byte* code = base_code();
+  roll_s r;
+  u64    pos = 0;
+  for (auto i = beg; i != end; ++i) {
+    if (*i == '\n' || (fixedLen && pos == fixedLen)) {
+      r.run = 0;
+      pos   = 0;
+      if (*i == '\n')    continue;
+    }
+    push(thr, r, code[(byte) *i]);
+    ++pos;
+  }
+
+  if (span && beg != end) {
+    edge_s& e = edges[thr][chunk];
+    const auto firstEnd = std::find(beg, end, '\n');
+    const auto lastEnd  = end - 1;
+    auto       lastBeg  = lastEnd;
+    while (lastBeg != beg && *(lastBeg-1) != '\n' && lastEnd-lastBeg+1 < k)
+      --lastBeg;
+    for (auto i = beg; i != firstEnd && e.head.size()+1 < k; ++i)
+      e.head += (char) code[(byte) *i];
+    for (auto i = lastBeg; i != lastEnd; ++i)
+      e.tail += (char) code[(byte) *i];
+    e.open = (firstEnd == lastEnd);
+  }
+}
+
+/**
+ * @brief Count the k-mers of a stream of the 2bit codec, with no unpacking
+ * @param thr       Thread ID
+ * @param chunk     Chunk number
+ * @param beg       Beginning of the encoded stream
+ * @param end       End of the encoded stream
+ * @param fixedLen  A sequence every fixedLen bases, if not 0
+ */
+void KmerCount::add_2bit (byte thr, u64 chunk, citer_t beg, citer_t end,
+                          u64 fixedLen) {
+  auto i = beg;
+  vector<u64> lens(get_count(i, end));
+  const u64 maxBases = 4 * (u64) (end - beg);
+  u64 total = 0;
+  for (auto& l : lens) {
+    l = get_varint(i, end);
+    assert(l > maxBases - total, WRONG_KEY);
+    total += l;
+  }
+  assert((u64) (end - i) != (total + 3) / 4, WRONG_KEY);
+  edge_s* e = span ? &edges[thr][chunk] : nullptr;
+  if (e)    e->open = (lens.size() <= 1);
+
+  byte bit = 0;    // Bases of the current byte, already counted
+  for (u64 f = 0; f != lens.size(); ++f) {
+    roll_s r;
+    for (u64 pos = 0; pos != lens[f]; ++pos, bit = (byte) ((bit + 1) % 4)) {
+      if (fixedLen && pos % fixedLen == 0)    r.run = 0;
+      const auto c = (byte) (((byte) *i >> (6 - 2*bit)) & 3);
+      push(thr, r, c);
+      edge_code(e, f, lens.size(), pos, lens[f], c);
+      if (bit == 3)    ++i;
+    }
+  }
+}
+
+/**
+ * @brief Count the k-mers of a stream of the packfix codec, with no
+ *        unpacking: a triplet byte gives 3 base codes. 'X' is taken from the
+ *        escapes
+ * @param thr       Thread ID
+ * @param chunk     Chunk number
+ * @param beg       Beginning of the encoded stream
+ * @param end       End of the encoded stream
+ * @param fixedLen  A sequence every fixedLen bases, if not 0
+ */
+void KmerCount::add_pack_fix (byte thr, u64 chunk, citer_t beg,
+                              citer_t end, u64 fixedLen) {
+  // Codes of the triplets: base-6 digits of A C G T N X
+  static const auto triplet = [] {
+    vector<std::array<byte, 3>> t(216);
+    for (u16 b = 0; b != 216; ++b)
+      t[b] = {{(byte) (b/36), (byte) (b/6 % 6), (byte) (b % 6)}};
+    return t;
+  }();
+  const byte* code = base_code();
+
+  citer_t i = beg;
+  vector<u64> lens(get_count(i, end));
+  const u64 maxLen = 3 * (u64) (end - beg);
+  u64 total=0, nByte=0;
+  for (auto& l : lens) {
+    l = get_varint(i, end);
+    assert(l > maxLen - total, WRONG_KEY);
+    total += l;
+    nByte += (l + 2) / 3;
+  }
+  u64     nEsc = get_count(i, end);
+  citer_t esc  = i;
+  for (u64 n = nEsc; n--; ++i) {
+    get_varint(i, end);
+    assert(i == end, WRONG_KEY);
+  }
+  assert((u64) (end - i) != nByte, WRONG_KEY);
+  edge_s* e = span ? &edges[thr][chunk] : nullptr;
+  if (e)    e->open = (lens.size() <= 1);
+
+  // Position of the next escape, in the text of the stream
+  u64 textPos = 0,  escPos = nEsc ? get_varint(esc, end) : ~0ull;
+  for (u64 f = 0; f != lens.size(); ++f) {
+    const u64 l = lens[f];
+    roll_s r;
+    for (u64 pos = 0; pos < l; ++i) {
+      assert((byte) *i >= triplet.size(), WRONG_KEY);
+      for (byte d : triplet[(byte) *i]) {
+        if (pos == l)    break;
+        if (fixedLen && pos % fixedLen == 0)    r.run = 0;
+        if (textPos == escPos) {
+          d = code[(byte) *esc++];
+          escPos = --nEsc ? escPos + get_varint(esc, end) : ~0ull;
+        }
+        push(thr, r, d);
+        edge_code(e, f, lens.size(), pos, l, d);
+        ++pos;    ++textPos;
+      }
+    }
+    ++textPos;                                                    // '\n'
+  }
+}
+
+/**
+ * @brief Merge the tables of partitions p, p+nThread, ... into the tables
+ *        of thread 0
+ * @param p        First partition
+ * @param nThread  Number of threads which merge
+ */
+void KmerCount::merge (byte p, byte nThread) {
+  for (u64 part = p; part < table[0].size(); part += nThread)
+    for (u64 t = 1; t != table.size(); ++t) {
+      for (const auto& e : table[t][part])
+        table[0][part][e.first] += e.second;
+      table_t().swap(table[t][part]);
+    }
+}
+
+/**
+ * @brief Count the k-mers across chunks, in order of the chunks. The last
+ *        k-1 bases before a chunk, which might be from several chunks, are
+ *        joined to its first bases. Call it after the tables are merged
+ */
+void KmerCount::join_edges () {
+  std::map<u64, edge_s> all;
+  for (auto& m : edges) { all.insert(m.begin(), m.end());    m.clear(); }
+
+  string carry;    // Last bases of the sequence, which is not ended yet
+  for (const auto& c : all) {
+    roll_s r;
+    for (char code : carry + c.second.head)    push(0, r, (byte) code);
+    if (c.second.open)    carry += c.second.tail;
+    else                  carry  = c.second.tail;
+    if (carry.size() >= k)    carry.erase(0, carry.size() - (k-1));
+  }
+}
+
+/**
+ * @brief Merge the tables, then write the counts, in order of the k-mers.
+ *        Binary: k (1 byte), number of k-mers (8 bytes), then each k-mer and
+ *        its count (8 bytes each), little-endian
+ * @param file  Output file name
+ */
+void KmerCount::write (const string& file) {
+  const auto nThread = (byte) table.size();
+  vector<thread> arrThread;
+  for (byte t = 0; t != nThread; ++t)
+    arrThread.emplace_back(&KmerCount::merge, this, t, nThread);
+  for (auto& thr : arrThread)    thr.join();
+  if (span)    join_edges();
+
+  u64 n = 0;
+  for (const auto& part : table[0])    n += part.size();
+
+  std::ofstream out(file, std::ios::binary);
+  assert(!out, "Error: failed creating \"" + file + "\".\n");
+  const auto put_u64 = [&out] (u64 v) {
+    char b[8];
+    for (byte s = 0; s != 8; ++s)    b[s] = (char) (v >> 8*s);
+    out.write(b, 8);
+  };
+  out.put((char) k);
+  put_u64(n);
+  for (const auto& part : table[0]) {
+    vector<std::pair<u64, u64>> sorted(part.begin(), part.end());
+    std::sort(sorted.begin(), sorted.end());
+    for (const auto& e : sorted) { put_u64(e.first);    put_u64(e.second); }
+  }
+}
@@ -0,0 +1,65 @@
+/**
+ * @file      kmer.hpp
+ * @brief     Counting k-mers of sequences
+ * @author    Morteza Hosseini  (seyedmorteza@ua.pt)
+ * @author    Diogo Pratas      (pratas@ua.pt)
+ * @author    Armando J. Pinho  (ap@ua.pt)
+ * @copyright The GNU General Public License v3.0
+ */
+
+#ifndef CRYFA_KMER_H
+#define CRYFA_KMER_H
+
+#include <unordered_map>
+#include <map>
+#include "codec.hpp"
+
+/**
+ * @brief Counts of canonical k-mers, 2 bits a base. Each thread counts in
+ *        its own tables, one per partition of the k-mers by their high
+ *        bits, so there are no locks. The tables of a partition are merged
+ *        at the end, in parallel with the other partitions. If a sequence
+ *        might continue in the next chunk, i.e., FASTA, the k-mers across
+ *        chunks are counted at the end, from the edges of the chunks
+ */
+class KmerCount
+{
+ public:
+  auto init (byte, byte, bool) -> void;
+  auto add_bases (byte, u64, citer_t, citer_t, u64) -> void;
+  auto add_2bit (byte, u64, citer_t, citer_t, u64) -> void;
+  auto add_pack_fix (byte, u64, citer_t, citer_t, u64) -> void;
+  auto write (const string&) -> void;
+
+ private:
+  using table_t = std::unordered_map<u64, u64>;
+
+  /** @brief Rolling state of a k-mer and its reverse complement */
+  struct roll_s {
+    u64 fwd = 0;   /**< @brief Forward @hideinitializer */
+    u64 rev = 0;   /**< @brief Reverse complement @hideinitializer */
+    u64 run = 0;   /**< @brief Bases since a reset @hideinitializer */
+  };
+
+  /** @brief Edges of a chunk: codes of the first k-1 bases of its first
+   *         sequence and of the last k-1 bases of its last one */
+  struct edge_s {
+    string head;          /**< @brief First bases */
+    string tail;          /**< @brief Last bases */
+    bool   open = false;  /**< @brief One sequence only @hideinitializer */
+  };
+
+  byte k     = 0;            /**< @brief Length of the k-mers @hideinitializer*/
+  u64  mask  = 0;            /**< @brief 2k low bits @hideinitializer */
+  byte shift = 0;            /**< @brief k-mer to partition @hideinitializer */
+  bool span  = false;        /**< @brief Across chunks @hideinitializer */
+  vector<vector<table_t>> table;  /**< @brief By thread, then by partition */
+  vector<std::map<u64, edge_s>> edges;  /**< @brief By thread, then chunk */
+
+  auto push (byte, roll_s&, byte) -> void;
+  auto edge_code (edge_s*, u64, u64, u64, u64, byte) const -> void;
+  auto join_edges () -> void;
+  auto merge (byte, byte) -> void;
+};
+
+#endif //CRYFA_KMER_H
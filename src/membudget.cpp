@@ -0,0 +1,63 @@
+/**
+ * @file      membudget.cpp
+ * @brief     Budget of memory
+ * @author    Morteza Hosseini  (seyedmorteza@ua.pt)
+ * @author    Diogo Pratas      (pratas@ua.pt)
+ * @author    Armando J. Pinho  (ap@ua.pt)
+ * @copyright The GNU General Public License v3.0
+ */
+
+#include "membudget.hpp"
+
+/**
+ * @brief Set the max bytes
+ * @param bytes  Max bytes. 0: no limit
+ */
+void MemBudget::set_cap (u64 bytes) {
+  std::lock_guard<StatMutex> lock(mutx);
+  capBytes = bytes;
+}
+
+/**
+ * @brief  Max bytes
+ * @return Max bytes. 0: no limit
+ */
+u64 MemBudget::cap () const {
+  return capBytes;
+}
+
+/**
+ * @brief   Acquire memory. Wait while the budget is exhausted
+ * @param   bytes  Bytes needed
+ * @warning If no memory is in use, the request is granted even if it is
+ *          greater than the budget, so that one thread always makes progress
+ */
+void MemBudget::acquire (u64 bytes) {
+  if (!capBytes)    return;
+  
+  std::unique_lock<StatMutex> lock(mutx);
+  const auto fits = [this, bytes] {
+    return usedBytes == 0 || usedBytes + bytes <= capBytes;
+  };
+  if (!fits()) {
+    const auto start = std::chrono::steady_clock::now();
+    cv.wait(lock, fits);
+    mutx.add_wait((u64) std::chrono::duration_cast<std::chrono::nanoseconds>
+                    (std::chrono::steady_clock::now() - start).count());
+  }
+  usedBytes += bytes;
+}
+
+/**
+ * @brief Release memory
+ * @param bytes  Bytes released
+ */
+void MemBudget::release (u64 bytes) {
+  if (!capBytes)    return;
+  
+  {
+    std::lock_guard<StatMutex> lock(mutx);
+    usedBytes -= bytes;
+  }
+  cv.notify_all();
+}
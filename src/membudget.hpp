@@ -0,0 +1,39 @@
+/**
+ * @file      membudget.hpp
+ * @brief     Budget of memory
+ * @author    Morteza Hosseini  (seyedmorteza@ua.pt)
+ * @author    Diogo Pratas      (pratas@ua.pt)
+ * @author    Armando J. Pinho  (ap@ua.pt)
+ * @copyright The GNU General Public License v3.0
+ */
+
+#ifndef CRYFA_MEMBUDGET_H
+#define CRYFA_MEMBUDGET_H
+
+#include <mutex>
+#include <condition_variable>
+#include "def.hpp"
+#include "statmutex.hpp"
+
+/**
+ * @brief Budget of memory, shared by the threads. Before reading a chunk, a
+ *        thread acquires the memory it needs, and waits while the budget is
+ *        exhausted. After writing the chunk, it releases the memory.
+ */
+class MemBudget
+{
+ public:
+  MemBudget () = default;
+  auto set_cap (u64) -> void;
+  auto cap () const -> u64;
+  auto acquire (u64) -> void;
+  auto release (u64) -> void;
+  
+ private:
+  u64 capBytes  = 0;  /**< @brief Max bytes. 0: no limit @hideinitializer */
+  u64 usedBytes = 0;  /**< @brief Bytes in use @hideinitializer */
+  StatMutex                   mutx{"budget"};  /**< @brief Mutex */
+  std::condition_variable_any cv;   /**< @brief To wait for memory */
+};
+
+#endif //CRYFA_MEMBUDGET_H
@@ -12,6 +12,7 @@
 
 #include <iostream>
 #include <algorithm>
+#include <cwctype>
 #include "def.hpp"
 #include "fn.hpp"
 using std::runtime_error;
@@ -40,26 +41,75 @@ inline void check_pass (const string& fname) {
   assert(pass.size() < 8, "Error: the password size must be at least 8.\n");
 }
 
+/**
+ * @brief  If each column of a line is a number
+ * @param  line  Line, tab-separated
+ * @return For each column, true if it is a number
+ */
+inline vector<bool> num_cols (const std::wstring& line) {
+  vector<bool> num(1, true);
+  bool         empty = true;
+  for (wchar_t c : line) {
+    if (c == L'\t') {
+      num.back() = num.back() && !empty;
+      num.push_back(true);
+      empty = true;
+    }
+    else {
+      if (!iswdigit(c))    num.back() = false;
+      empty = false;
+    }
+  }
+  num.back() = num.back() && !empty;
+  return num;
+}
+
+/**
+ * @brief  Format of a file, by looking inside it
+ * @param  inFileName  File name
+ * @return 'A': FASTA, 'Q': FASTQ, 'V': VCF, 'M': SAM, 'T': BED/GFF/GTF or
+ *         'n': none of them
+ */
 inline char frmt (const string &inFileName) {
   wchar_t c;
   wifstream in(inFileName);
   assert(!in.good(), "Error: failed opening '" + inFileName + "'.\n");
 
+  // Vcf
+  std::wstring line;
+  if (getline(in, line) && line.compare(0, 16, L"##fileformat=VCF") == 0)
+    { in.close();    return 'V'; }
+  in.clear();   in.seekg(0, std::ios::beg); // Return to beginning of the file
+
   // Skip leading blank lines or spaces
   while (in.peek()=='\n' || in.peek()==' ')    in.get(c);
 
-  // Fastq
+  // Fastq, or Sam: 11 columns, with FLAG and POS
   while (in.peek() == '@')     IGNORE_THIS_LINE(in);
-  byte nTabs=0;    while (in.get(c) && c!='\n')  if (c=='\t') ++nTabs;
+  getline(in, line);
+  vector<bool> num = num_cols(line);
 
   if (in.peek() == '+') { in.close();    return 'Q'; }            // Fastq
+  if (num.size() >= 11 && num[1] && num[3])
+                        { in.close();    return 'M'; }            // Sam
+
+  // Bed: start and end. Gff/Gtf: 9 columns, with start and end. Comments,
+  // blank, track and browser lines come before the first record, in any order
+  in.clear();   in.seekg(0, std::ios::beg); // Return to beginning of the file
+  while (getline(in, line) && (line.empty() || line[0] == L'#' ||
+                               line.compare(0, 5, L"track") == 0 ||
+                               line.compare(0, 7, L"browser") == 0)) {}
+  num = num_cols(line);
+  if ((num.size() >= 3 && num[1] && num[2]) ||
+      (num.size() >= 9 && num[3] && num[4]))
+                        { in.close();    return 'T'; }            // Bed/Gff
 
-  // Fasta or Not Fasta/Fastq
+  // Fasta or none of them
   in.clear();   in.seekg(0, std::ios::beg); // Return to beginning of the file
   while (in.peek()!='>' && in.peek()!=EOF)    IGNORE_THIS_LINE(in);
 
   if (in.peek() == '>') { in.close();    return 'A'; }      // Fasta
-  else                  { in.close();    return 'n'; }      // Not Fasta/Fastq
+  else                  { in.close();    return 'n'; }      // None of them
 }
 
 /**
@@ -67,7 +117,7 @@ inline char frmt (const string &inFileName) {
  * @param  par   An object to hold parameters
  * @param  argc  Number of command line options
  * @param  argv  Array of command line options
- * @return 'c': compress+encrypt or 'd': decrypt+decompress
+ * @return 'c': compress+encrypt, 'd': decrypt+decompress or 'a': analyze
  */
 char parse (Param& par, int argc, char** argv) {
   if (argc < 2)
@@ -83,8 +133,10 @@ char parse (Param& par, int argc, char** argv) {
         exist(vArgs.begin(), vArgs.end(), "--help"))
       help();
   
-    // key -- MANDATORY
-    assert(!exist(vArgs.begin(), vArgs.end(), "-k") &&
+    // key -- MANDATORY, except for analysis
+    const bool analyze = exist(vArgs.begin(), vArgs.end(), "--analyze");
+    assert(!analyze &&
+           !exist(vArgs.begin(), vArgs.end(), "-k") &&
            !exist(vArgs.begin(), vArgs.end(), "--key"),
            "Error: no password file has been set.\n");
     for (auto i=vArgs.begin(); i!=vArgs.end(); ++i) {
@@ -98,26 +150,149 @@ char parse (Param& par, int argc, char** argv) {
       }
     }
     
-    // verbose, thread
+    // verbose, stats, trace, thread, max memory, reference, k-mer, stats of
+    // archive, filters, head, sample, output
     for (auto i=vArgs.begin(); i!=vArgs.end(); ++i) {
       if (*i=="-v"  || *i=="--verbose") {
         par.verbose = true;
         cerr << "Verbose mode on.\n";
       }
+      else if (*i=="--stats")
+        par.stats = true;
+      else if (*i=="--trace")
+        par.trace = true;
       else if ((*i=="-t" || *i=="--thread") &&
                i+1!=vArgs.end() && (*(i+1))[0]!='-' && is_number(*(i+1)))
-        par.n_threads = static_cast<byte>(stoi(*++i));
+        par.n_threads = static_cast<byte>(to_number(*++i, 1, 255,
+                          "Error: number of threads must be 1 to 255.\n"));
+      else if (*i=="--max-memory") {
+        if (i+1!=vArgs.end() && (*(i+1))[0]!='-')
+          par.max_memory = size_in_bytes(*++i);
+        else throw runtime_error("Error: no size has been set for memory.\n");
+      }
+      else if (*i=="--reference") {
+        if (i+1!=vArgs.end() && (*(i+1))[0]!='-') {
+          par.reference = *++i;
+          assert_file_good(par.reference, "Error opening the reference \""
+                                          + par.reference + "\".\n");
+        }
+        else throw runtime_error("Error: no reference has been set.\n");
+      }
+      else if (*i=="--kmer-count") {
+        const string arg = (i+1 != vArgs.end()) ? *++i : "";
+        par.kmer_k = static_cast<byte>(to_number(arg, 1, 32,
+                                   "Error: k-mer size must be 1 to 32.\n"));
+      }
+      else if (*i=="--stats-archive")
+        par.stats_archive = true;
+      else if (*i=="--min-len") {
+        const string arg = (i+1 != vArgs.end()) ? *++i : "";
+        par.min_len = to_number(arg, 0, std::numeric_limits<u64>::max(),
+                                "Error: min length must be a number.\n");
+      }
+      else if (*i=="--min-mean-qual") {
+        const string arg = (i+1 != vArgs.end()) ? *++i : "";
+        par.min_mean_qual = to_decimal(arg, 0,
+                            std::numeric_limits<double>::max(),
+                            "Error: min mean quality must be a number.\n");
+      }
+      else if (*i=="--max-n-frac") {
+        const string arg = (i+1 != vArgs.end()) ? *++i : "";
+        par.max_n_frac = to_decimal(arg, 0, 1,
+                         "Error: max fraction of N must be 0 to 1.\n");
+      }
+      else if (*i=="--name-regex") {
+        if (i+1!=vArgs.end())
+          par.name_regex = *++i;
+        else throw runtime_error("Error: no pattern of names has been "
+                                 "set.\n");
+      }
+      else if (*i=="--head") {
+        const string arg = (i+1 != vArgs.end()) ? *++i : "";
+        par.head = to_number(arg, 1, std::numeric_limits<u64>::max(),
+                       "Error: number of records must be at least 1.\n");
+      }
+      else if (*i=="--sample") {
+        const string arg = (i+1 != vArgs.end()) ? *++i : "";
+        const string err = "Error: sample fraction must be more than 0, up "
+                           "to 1.\n";
+        par.sample = to_decimal(arg, 0, 1, err);
+        assert(par.sample == 0, err);
+      }
+      else if (*i=="-o" || *i=="--output") {
+        if (i+1!=vArgs.end() && (*(i+1))[0]!='-')
+          par.out_file = *++i;
+        else throw runtime_error("Error: no output file has been set.\n");
+      }
     }
+    assert(par.kmer_k && par.out_file.empty(),
+           "Error: counting k-mers needs an output file (-o).\n");
+    assert((par.head || par.sample > 0) && (par.kmer_k || par.stats_archive),
+           "Error: --head and --sample can't be set with --kmer-count or "
+           "--stats-archive.\n");
+    const bool dec = exist(vArgs.begin(), vArgs.end(), "-d") ||
+                     exist(vArgs.begin(), vArgs.end(), "--dec");
+    assert(!dec && (par.head || par.sample > 0 || par.kmer_k ||
+                    par.min_len || par.min_mean_qual > 0 ||
+                    par.max_n_frac < 1 || !par.name_regex.empty()),
+           "Error: --head, --sample, --kmer-count and the filters on reads "
+           "are only for decrypting, with -d.\n");
+    assert(par.head && par.sample > 0,
+           "Error: --head and --sample can't be set together.\n");
     
-    // Decrypt+decompress
-    if (exist(vArgs.begin(), vArgs.end(), "-d") ||
-        exist(vArgs.begin(), vArgs.end(), "--dec"))
-      return 'd';
+    // Decrypt+decompress, or the statistics of an archive
+    if (dec || par.stats_archive)    return 'd';
     
-    // stop_shuffle, frmt
+    // stop_shuffle, deflate, level, dedup, seekable, cache stats, reorder,
+    // qual_bin, profile, frmt
     for (auto i=vArgs.begin(); i!=vArgs.end(); ++i) {
       if (*i=="-s"  || *i=="--stop_shuffle")
         par.stop_shuffle = true;
+      else if (*i=="--deflate") {
+        const string arg = (i+1 != vArgs.end()) ? *++i : "";
+        par.deflate_level = static_cast<byte>(to_number(arg, 0, 9,
+                                   "Error: deflate level must be 0 to 9.\n"));
+      }
+      else if (*i=="--level") {
+        const string arg = (i+1 != vArgs.end()) ? *++i : "";
+        if      (arg == "max")       par.level_max = true;
+        else if (arg == "normal")    par.level_max = false;
+        else throw runtime_error("Error: level must be normal or max.\n");
+      }
+      else if (*i=="--dedup")
+        par.dedup = true;
+      else if (*i=="--seekable")
+        par.seekable = true;
+      else if (*i=="--cache-stats")
+        par.cache_stats = true;
+      else if (*i=="--reorder") {
+        const string arg = (i+1 != vArgs.end()) ? *++i : "";
+        if (arg == "keep" || arg == "free")    par.reorder = arg;
+        else throw runtime_error("Error: reorder must be keep or free.\n");
+      }
+      else if (*i=="--qual-bin") {
+        const string arg = (i+1 != vArgs.end()) ? *++i : "";
+        if (arg == "illumina8")
+          par.qual_bin = arg;
+        else if (arg.compare(0, 7, "custom:") == 0) {
+          qual_bins(arg.substr(7));             // Check the map
+          par.qual_bin = arg;
+        }
+        else throw runtime_error("Error: quality score bins must be "
+                                 "illumina8 or custom:MAP.\n");
+      }
+      else if (*i=="--profile") {
+        const string arg = (i+1 != vArgs.end()) ? *++i : "";
+        if      (arg.compare(0, 5, "save:") == 0 && arg.size() > 5)
+          par.profile_save = arg.substr(5);
+        else if (arg.compare(0, 5, "load:") == 0 && arg.size() > 5) {
+          par.profile_load = arg.substr(5);
+          assert_file_good(par.profile_load, "Error opening the profile \""
+                                             + par.profile_load + "\".\n");
+        }
+        else throw runtime_error("Error: profile must be save:FILE or "
+                                 "load:FILE.\n");
+      }
       else if (*i=="-f" || *i=="--force")
         par.format='n';
 //      else if ((*i=="-f" || *i=="--format") &&
@@ -131,12 +306,16 @@ char parse (Param& par, int argc, char** argv) {
     if (!exist(vArgs.begin(), vArgs.end(), "-f") &&
         !exist(vArgs.begin(), vArgs.end(), "--force"))
       par.format = frmt(par.in_file);  // Not standard input file
+    assert(!par.qual_bin.empty() && par.format != 'Q',
+           "Error: quality score bins are only for FASTQ.\n");
+    assert(!par.reorder.empty() && par.format != 'Q',
+           "Error: reordering the reads is only for FASTQ.\n");
 //    if (!exist(vArgs.begin(), vArgs.end(), "-f") &&
 //        !exist(vArgs.begin(), vArgs.end(), "--format"))
 //      par.format = frmt(par.in_file);  // Not standard input file
 
-    // Compress+encrypt
-    return 'c';
+    // Analyze or compress+encrypt
+    return analyze ? 'a' : 'c';
   }
 }
 
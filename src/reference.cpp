@@ -0,0 +1,190 @@
+/**
+ * @file      reference.cpp
+ * @brief     Reference sequence, with an index of its k-mers
+ * @author    Morteza Hosseini  (seyedmorteza@ua.pt)
+ * @author    Diogo Pratas      (pratas@ua.pt)
+ * @author    Armando J. Pinho  (ap@ua.pt)
+ * @copyright The GNU General Public License v3.0
+ */
+
+#include <fstream>
+#include <algorithm>
+#include "reference.hpp"
+#include "assert.hpp"
+#include "cryptopp/sha.h"
+using std::ifstream;
+using CryptoPP::SHA256;
+
+constexpr u32 NO_POS = 0xFFFFFFFF;    /**< @brief Empty bucket/end of chain */
+
+/**
+ * @brief Load a FASTA file, hash it and index its k-mers
+ * @param file_name  Name of the file
+ */
+void Reference::load (const string& file_name) {
+  ifstream in(file_name, std::ios::binary);
+  assert(!in.good(), "Error opening the reference \"" + file_name + "\".\n");
+
+  // Bases, in uppercase. Headers are ignored
+  SHA256 sha;
+  string block(BLOCK_SIZE, '\0');
+  bool   inHdr = false,  lineBeg = true;
+  seq.clear();
+  while (in.read(&block[0], BLOCK_SIZE) || in.gcount()) {
+    const auto n = (size_t) in.gcount();
+    sha.Update((const byte*) block.data(), n);
+    for (auto c = block.begin(); c != block.begin() + n; ++c) {
+      if (lineBeg && *c == '>')    inHdr = true;
+      lineBeg = (*c == '\n');
+      if (lineBeg)                          inHdr = false;
+      else if (!inHdr && *c != '\r')
+        seq += (*c >= 'a' && *c <= 'z') ? (char) (*c - 'a' + 'A') : *c;
+    }
+  }
+  hash.resize(SHA256::DIGESTSIZE);
+  sha.Final((byte*) &hash[0]);
+  assert(seq.size() >= NO_POS, "Error: the reference is larger than 4G "
+                               "bases.\n");
+
+  // Index
+  byte bits = 10;
+  while (bits != 32 && (1ull << bits) < 2 * seq.size() / REF_STEP)    ++bits;
+  shift = (byte) (64 - bits);
+  head.assign(1ull << bits, NO_POS);
+  next.assign(seq.size() / REF_STEP + 1, NO_POS);
+  for (u64 p = 0, k; p + REF_K <= seq.size(); p += REF_STEP)
+    if (kmer(seq, p, k)) {
+      u32& h = head[bucket(k)];
+      next[p / REF_STEP] = h;
+      h = (u32) p;
+    }
+}
+
+/**
+ * @brief  If a reference has been loaded
+ * @return true, if loaded
+ */
+bool Reference::loaded () const {
+  return !hash.empty();
+}
+
+/**
+ * @brief  SHA-256 of the reference file, to identify it
+ * @return 32 bytes
+ */
+const string& Reference::digest () const {
+  return hash;
+}
+
+/**
+ * @brief  Number of bases
+ * @return Size
+ */
+u64 Reference::size () const {
+  return seq.size();
+}
+
+/**
+ * @brief  Find where a piece of sequence maps on the reference, on the
+ *         forward or the reverse complement strand, with the fewest
+ *         mismatches. No insertion or deletion
+ * @param  piece    Bases
+ * @param  maxEdit  Max mismatches
+ * @param  pos      Position on the reference
+ * @param  rc       If on the reverse complement strand
+ * @return true, if found
+ */
+bool Reference::find (const string& piece, u64 maxEdit, u64& pos,
+                      bool& rc) const {
+  if (!loaded() || piece.size() < REF_K || piece.size() > seq.size())
+    return false;
+
+  const u64 len = piece.size();
+  u64  best = maxEdit + 1,  tries = 0;
+  string rcPiece(piece.rbegin(), piece.rend());
+  for (char& c : rcPiece)
+    c = (c=='A') ? 'T' : (c=='C') ? 'G' : (c=='G') ? 'C' : (c=='T') ? 'A' : c;
+
+  for (byte strand = 0; strand != 2; ++strand) {
+    const string& s = strand ? rcPiece : piece;
+    for (u64 o = 0, k; o + REF_K <= len && tries < REF_TRY; ++o) {
+      if (!kmer(s, o, k))    continue;
+      u32 cand = head[bucket(k)];
+      for (byte c = 0; cand != NO_POS && c != REF_CAND;
+           cand = next[cand / REF_STEP], ++c) {
+        u64 kRef;
+        if (cand < o || cand - o + len > seq.size() ||
+            !kmer(seq, cand, kRef) || kRef != k)    continue;  // Other k-mer
+        ++tries;
+        const u64 m = mismatch(s, cand - o, best);
+        if (m < best) {
+          best = m;    pos = cand - o;    rc = (strand == 1);
+          if (best == 0)    return true;
+        }
+      }
+    }
+  }
+  return best <= maxEdit;
+}
+
+/**
+ * @brief Append a part of the reference
+ * @param[out] out  Output
+ * @param[in]  pos  Position
+ * @param[in]  len  Length
+ * @param[in]  rc   If reverse complement
+ */
+void Reference::copy (string& out, u64 pos, u64 len, bool rc) const {
+  assert(pos > seq.size() || len > seq.size() - pos,
+         "Error: position out of the reference.\n");
+  if (!rc) { out.append(seq, pos, len);    return; }
+  for (u64 i = pos + len; i-- != pos;) {
+    const char c = seq[i];
+    out += (c=='A') ? 'T' : (c=='C') ? 'G' : (c=='G') ? 'C' : (c=='T') ? 'A' : c;
+  }
+}
+
+/**
+ * @brief  A k-mer, 2 bits per base
+ * @param  s    Bases
+ * @param  beg  Beginning of the k-mer
+ * @param  k    The k-mer
+ * @return false, if there is another symbol than A, C, G, T
+ */
+bool Reference::kmer (const string& s, u64 beg, u64& k) const {
+  k = 0;
+  for (auto i = s.begin() + beg; i != s.begin() + beg + REF_K; ++i) {
+    switch (*i) {
+      case 'A':  k <<= 2;             break;
+      case 'C':  k = k << 2 | 1;      break;
+      case 'G':  k = k << 2 | 2;      break;
+      case 'T':  k = k << 2 | 3;      break;
+      default:   return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief  Bucket of a k-mer in the hash table
+ * @param  k  The k-mer
+ * @return Bucket
+ */
+u64 Reference::bucket (u64 k) const {
+  return (k * 0x9E3779B97F4A7C15ull) >> shift;
+}
+
+/**
+ * @brief  Mismatches of a piece against the reference
+ * @param  s      Bases
+ * @param  pos    Position on the reference
+ * @param  limit  Stop counting at this
+ * @return Mismatches, up to limit
+ */
+u64 Reference::mismatch (const string& s, u64 pos, u64 limit) const {
+  u64 m = 0;
+  auto r = seq.begin() + pos;
+  for (auto i = s.begin(); i != s.end() && m != limit; ++i, ++r)
+    m += (*i != *r);
+  return m;
+}
@@ -0,0 +1,43 @@
+/**
+ * @file      reference.hpp
+ * @brief     Reference sequence, with an index of its k-mers
+ * @author    Morteza Hosseini  (seyedmorteza@ua.pt)
+ * @author    Diogo Pratas      (pratas@ua.pt)
+ * @author    Armando J. Pinho  (ap@ua.pt)
+ * @copyright The GNU General Public License v3.0
+ */
+
+#ifndef CRYFA_REFERENCE_H
+#define CRYFA_REFERENCE_H
+
+#include "def.hpp"
+
+/**
+ * @brief Reference sequence. The bases of all records of a FASTA file, in
+ *        uppercase, one after the other. The k-mers starting at every
+ *        REF_STEP bases are indexed, in a hash table of chains. It is built
+ *        once and then only read, by all threads
+ */
+class Reference
+{
+ public:
+  auto load (const string&) -> void;
+  auto loaded () const -> bool;
+  auto digest () const -> const string&;
+  auto size () const -> u64;
+  auto find (const string&, u64, u64&, bool&) const -> bool;
+  auto copy (string&, u64, u64, bool) const -> void;
+
+ private:
+  string      seq;      /**< @brief Bases */
+  string      hash;     /**< @brief SHA-256 of the file */
+  vector<u32> head;     /**< @brief Last position of each hash of k-mer */
+  vector<u32> next;     /**< @brief Previous position, same hash. By p/STEP */
+  byte        shift = 0;/**< @brief For hashing @hideinitializer */
+
+  auto kmer (const string&, u64, u64&) const -> bool;
+  auto bucket (u64) const -> u64;
+  auto mismatch (const string&, u64, u64) const -> u64;
+};
+
+#endif //CRYFA_REFERENCE_H
@@ -0,0 +1,364 @@
+/**
+ * @file      sam.cpp
+ * @brief     Compression/Decompression of SAM
+ * @author    Morteza Hosseini  (seyedmorteza@ua.pt)
+ * @author    Diogo Pratas      (pratas@ua.pt)
+ * @author    Armando J. Pinho  (ap@ua.pt)
+ * @copyright The GNU General Public License v3.0
+ */
+
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <sstream>
+#include "sam.hpp"
+using std::chrono::high_resolution_clock;
+using std::cerr;
+using std::ifstream;
+using std::to_string;
+
+namespace {
+/**
+ * @brief  If all chars of a field are printable, with no space, as in the
+ *         names of the reads and the quality scores
+ * @param  s  Field
+ * @return true, if so
+ */
+bool printable (const string& s) {
+  return !s.empty() &&
+         std::all_of(s.begin(), s.end(), [] (char c) { return c>32 && c<127;});
+}
+
+/**
+ * @brief  If CIGAR is "*", or lengths and operations, e.g., "76M2I22M", with
+ *         the lengths as they are printed
+ * @param  cigar  CIGAR
+ * @return true, if so
+ */
+bool cigar_ok (const string& cigar) {
+  if (cigar == "*")    return true;
+  if (cigar.empty())   return false;
+  for (auto i = cigar.begin(); i != cigar.end(); ++i) {
+    const auto op = std::find_if(i, cigar.end(),
+                                 [] (char c) { return !isdigit(c); });
+    if (op == cigar.end() || !strchr("MIDNSHP=X", *op) ||
+        !canonical_num(string(i, op)))
+      return false;
+    i = op;
+  }
+  return true;
+}
+}
+
+/**
+ * @brief Compress
+ */
+void Sam::compress () {
+  const auto start = high_resolution_clock::now();                // Start timer
+  string     headers, qscores;
+
+  if (verbose)    cerr << "Calculating number of different characters...\n";
+  ifstream in(in_file);
+  gather_h_q(in, headers, qscores);
+  in.close();
+  if (verbose)
+    cerr << "In names of reads, they are " << headers.length() << ".\n"
+         << "In quality scores, they are " << qscores.length() << ".\n";
+
+  set_pack(headers, qscores);
+  compress_table('M', headers, qscores,
+                 static_cast<packTblFP_t>(&Sam::pack_chunk), start);
+}
+
+/**
+ * @brief Analyze. Predict the compaction ratio and the time by packing
+ *        blocks sampled across the file, with the chars of the sample
+ */
+void Sam::analyze () {
+  vector<vector<string>> smpl;
+  double    scanSec;
+  const u64 smplBytes = sample_lines(smpl, scanSec);
+  string    text, headers, qscores;
+  for (const auto& block : smpl)
+    for (const auto& line : block) { text += line;    text += '\n'; }
+  std::istringstream iss(text);
+  gather_h_q(iss, headers, qscores);
+
+  set_pack(headers, qscores);
+  // File type, shuffle flag, version, headers, (char) 254, q scores, '\n'
+  analyze_table("SAM", smpl, smplBytes, scanSec,
+                static_cast<packTblFP_t>(&Sam::pack_chunk),
+                headers.size() + qscores.size() + 6);
+}
+
+/**
+ * @brief Gather the chars of the names of the reads and of the quality
+ *        scores, in the records
+ * @param[in]  in       Lines
+ * @param[out] headers  Chars of the names of the reads
+ * @param[out] qscores  Chars of the quality scores
+ */
+void Sam::gather_h_q (std::istream& in, string& headers, string& qscores) {
+  bool hChars[256], qChars[256];
+  memset(hChars, false, 256);
+  memset(qChars, false, 256);
+
+  tblcols_s cols;
+  for (string line; getline(in, line);) {
+    const u64 nCol = split_line(cols, line);
+    if (!is_record(cols, line, nCol))    continue;
+    for (char c : cols.col[0])     hChars[(byte) c] = true;
+    for (char c : cols.col[10])    qChars[(byte) c] = true;
+  }
+
+  for (byte i = 33; i != 127; ++i)    if (*(hChars+i))  headers += i;
+  for (byte i = 33; i != 127; ++i)    if (*(qChars+i))  qscores += i;
+}
+
+/**
+ * @brief Streams of a chunk. The names of the reads are headers, the runs of
+ *        lines a layout, and the others columns, but the sequences and the
+ *        quality scores
+ */
+void Sam::set_streams () {
+  strm.assign(N_SAM_STRM, stream_s());
+  for (auto& st : strm)    st.kind = STRM_COL;
+  strm[TBL_LAYOUT].kind = STRM_LAYOUT;
+  strm[SAM_QNAME].kind  = STRM_HDR;
+  strm[SAM_SEQ].kind    = STRM_SEQ;
+  strm[SAM_QUAL].kind   = STRM_QS;
+}
+
+/**
+ * @brief Set the streams, and the packers of the names of the reads and of
+ *        the quality scores, by the categories of their chars
+ * @param headers  Chars of the names of the reads
+ * @param qscores  Chars of the quality scores
+ */
+void Sam::set_pack (const string& headers, const string& qscores) {
+  set_streams();
+  strm[SAM_QNAME].packFP = cat_pack_fn(headers, Hdrs, HdrMap,
+                                       &EnDecrypto::pack_hL_fa_fq);
+  strm[SAM_QNAME].map    = &HdrMap;
+  strm[SAM_QUAL].packFP  = cat_pack_fn(qscores, QSs, QsMap,
+                                       &EnDecrypto::pack_qL_fq);
+  strm[SAM_QUAL].map     = &QsMap;
+  HdrCat = category(headers.length());
+  QsCat  = category(qscores.length());
+}
+
+/**
+ * @brief  If a line is a record which is given back the same by the streams
+ * @param  cols  Columns of the chunk. The columns of the line are in col
+ * @param  line  Line
+ * @param  nCol  Number of columns of the line
+ * @return true, if so
+ */
+bool Sam::is_record (const tblcols_s& cols, const string& line,
+                     u64 nCol) const {
+  if (line[0] == '@' || nCol < SAM_MIN_COL)    return false;
+  const auto& col = cols.col;
+  if (!printable(col[0]) || !printable(col[10]) || !canonical_num(col[3]) ||
+      !cigar_ok(col[5]) || (col[6] == "=" && !canonical_num(col[7])))
+    return false;
+  for (u64 c = SAM_MIN_COL; c != nCol; ++c)                        // Tags
+    if (col[c].size() < 5 || col[c][2] != ':' || col[c][4] != ':')
+      return false;
+  return true;
+}
+
+/**
+ * @brief Pack a chunk: a record by its columns, or any other line as it is
+ * @param[out] context  Packed chunk
+ * @param[in]  lines    Lines
+ */
+void Sam::pack_chunk (string& context, const vector<string>& lines) {
+  tblcols_s cols;
+  cols.strm.resize(N_SAM_STRM);
+  for (const auto& line : lines) {
+    const u64 nCol = split_line(cols, line);
+    if (is_record(cols, line, nCol)) {
+      add_record(cols, nCol);
+      add_layout(cols, nCol);
+    }
+    else    add_raw(cols, line);
+  }
+  end_runs(cols, SAM_RNAME);
+  encode_table(context, cols);
+}
+
+/**
+ * @brief Add the columns of a record to the streams
+ * @param cols  Columns of the chunk. The columns of the line are in col
+ * @param nCol  Number of columns of the line
+ */
+void Sam::add_record (tblcols_s& cols, u64 nCol) const {
+  const auto& col = cols.col;
+  auto&       s   = cols.strm;
+  const auto field = [&] (byte str, const string& f) {
+    s[str] += f;
+    s[str] += '\n';
+  };
+
+  field(SAM_QNAME, col[0]);
+  field(SAM_FLAG,  col[1]);
+  const u64 pos = stoull(col[3]);
+  add_name_pos(cols, SAM_RNAME, SAM_POS, col[2], pos);
+  field(SAM_MAPQ,  col[4]);
+
+  // CIGAR: the operations, e.g., "MIM", and the lengths, e.g., "76 2 22"
+  const string& cigar = col[5];
+  if (cigar == "*")    field(SAM_CIGAR_OP, cigar);
+  else {
+    for (auto i = cigar.begin(); i != cigar.end(); ++i) {
+      const auto op = std::find_if(i, cigar.end(),
+                                   [] (char c) { return !isdigit(c); });
+      s[SAM_CIGAR_OP] += *op;
+      if (i != cigar.begin())    s[SAM_CIGAR_LEN] += ' ';
+      s[SAM_CIGAR_LEN].append(i, op);
+      i = op;
+    }
+    s[SAM_CIGAR_OP] += '\n';
+  }
+  s[SAM_CIGAR_LEN] += '\n';
+
+  // The mate: its position as delta, if it is on the same reference
+  field(SAM_RNEXT, col[6]);
+  if (col[6] == "=")    field(SAM_PNEXT, to_string((i64)(stoull(col[7])-pos)));
+  else                  field(SAM_PNEXT, col[7]);
+  field(SAM_TLEN, col[8]);
+  field(SAM_SEQ,  col[9]);
+  field(SAM_QUAL, col[10]);
+  if (nCol == SAM_MIN_COL)    return;
+
+  // Tags: the keys with the types, e.g., "NM:i\tMD:Z", by index, and the
+  // values
+  string keys, vals;
+  for (u64 c = SAM_MIN_COL; c != nCol; ++c) {
+    if (c != SAM_MIN_COL) {
+      keys += '\t';
+      vals += '\t';
+    }
+    keys.append(col[c], 0, 4);
+    vals.append(col[c], 5, string::npos);
+  }
+  field(SAM_TAG_KEY, to_string(add_dict(cols, keys)));
+  field(SAM_TAG_VAL, vals);
+}
+
+/**
+ * @brief Decompress
+ */
+void Sam::decompress () {
+  const auto start = high_resolution_clock::now();          // Start timer
+  budget.set_cap(max_memory);
+  char     c;                     // Chars in file
+  string   headers, qscores;
+  ifstream in(DEC_FNAME);
+
+  in.ignore(1);                   // Jump over decText[0]==(char) 123
+  in.get(c);    shuffled = (c==(char) 128); // Check if file had been shuffled
+  read_version(in);
+  read_no_eol(in);
+  while (in.get(c) && c != (char) 254)    headers += c;
+  while (in.get(c) && c != '\n')          qscores += c;
+
+  if (verbose)
+    cerr << headers.length()
+         <<" different characters are included in names of reads.\n"
+         << qscores.length()
+         <<" different characters are included in quality scores.\n";
+
+  set_streams();
+  strm[SAM_QNAME].unpackFP = cat_unpack_fn(headers, hdrUnpack,
+                                           strm[SAM_QNAME].XChar);
+  strm[SAM_QNAME].unpack   = &hdrUnpack;
+  strm[SAM_QUAL].unpackFP  = cat_unpack_fn(qscores, qsUnpack,
+                                           strm[SAM_QUAL].XChar);
+  strm[SAM_QUAL].unpack    = &qsUnpack;
+  HdrCat = category(headers.length());
+  QsCat  = category(qscores.length());
+
+  decompress_table(in, static_cast<unpackTblFP_t>(&Sam::unpack_chunk), start);
+}
+
+/**
+ * @brief Unpack a chunk into lines, from the columns in the streams
+ * @param[out]    out  Lines
+ * @param[in,out] i    Unshuffled chunk iterator
+ */
+void Sam::unpack_chunk (string& out, string::iterator& i) {
+  tbltext_s t;
+  decode_table(t, i, N_SAM_STRM);
+
+  out.clear();
+  while (t.c[TBL_LAYOUT] != t.txt[TBL_LAYOUT].cend()) {
+    citer_t b;
+    auto e = next_field(t, TBL_LAYOUT, b);
+    const auto x    = std::find(b, e, 'x');
+    const u64  nCol = stoull(string(b, x));
+    for (u64 n = stoull(string(x + 1, e)); n--;) {
+      if (!nCol) {                                          // As it is
+        put_field(out, t, TBL_RAW);
+        out += '\n';
+        continue;
+      }
+
+      put_field(out, t, SAM_QNAME);    out += '\t';
+      put_field(out, t, SAM_FLAG);     out += '\t';
+      get_name_pos(out, t, SAM_RNAME, SAM_POS);
+      const u64 pos = t.pos;
+      out += '\t';
+      put_field(out, t, SAM_MAPQ);     out += '\t';
+
+      // CIGAR: a length before each operation
+      citer_t op, len;
+      const auto opEnd  = next_field(t, SAM_CIGAR_OP,  op);
+      const auto lenEnd = next_field(t, SAM_CIGAR_LEN, len);
+      if (*op == '*')    out += '*';
+      else {
+        for (; op != opEnd; ++op) {
+          const auto sp = std::find(len, lenEnd, ' ');
+          out.append(len, sp);
+          out += *op;
+          len = sp + (sp != lenEnd);
+        }
+      }
+      out += '\t';
+
+      // The mate
+      const auto rEnd = next_field(t, SAM_RNEXT, b);
+      const bool same = (rEnd - b == 1 && *b == '=');
+      out.append(b, rEnd);
+      out += '\t';
+      if (same) {
+        e = next_field(t, SAM_PNEXT, b);
+        out += to_string(pos + (u64) stoll(string(b, e)));
+      }
+      else    put_field(out, t, SAM_PNEXT);
+      out += '\t';
+      put_field(out, t, SAM_TLEN);     out += '\t';
+      put_field(out, t, SAM_SEQ);      out += '\t';
+      put_field(out, t, SAM_QUAL);
+
+      // Tags: a value after each key
+      if (nCol != SAM_MIN_COL) {
+        const string& keys = get_dict(t, SAM_TAG_KEY);
+        citer_t v;
+        const auto vEnd = next_field(t, SAM_TAG_VAL, v);
+        for (auto k = keys.cbegin();;) {
+          const auto kEnd = std::find(k, keys.cend(), '\t');
+          const auto val  = std::find(v, vEnd, '\t');
+          out += '\t';
+          out.append(k, kEnd);
+          out += ':';
+          out.append(v, val);
+          if (kEnd == keys.cend())    break;
+          k = kEnd + 1;
+          v = val + 1;
+        }
+      }
+      out += '\n';
+    }
+  }
+}
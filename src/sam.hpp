@@ -0,0 +1,60 @@
+/**
+ * @file      sam.hpp
+ * @brief     Compression/Decompression of SAM
+ * @author    Morteza Hosseini  (seyedmorteza@ua.pt)
+ * @author    Diogo Pratas      (pratas@ua.pt)
+ * @author    Armando J. Pinho  (ap@ua.pt)
+ * @copyright The GNU General Public License v3.0
+ */
+
+#ifndef CRYFA_SAM_H
+#define CRYFA_SAM_H
+
+#include "table.hpp"
+
+constexpr byte SAM_QNAME     = 3;   /**< @brief Names of the reads */
+constexpr byte SAM_FLAG      = 4;   /**< @brief Flags */
+constexpr byte SAM_RNAME     = 5;   /**< @brief Runs of references */
+constexpr byte SAM_POS       = 6;   /**< @brief Deltas of positions */
+constexpr byte SAM_MAPQ      = 7;   /**< @brief Mapping qualities */
+constexpr byte SAM_CIGAR_OP  = 8;   /**< @brief Operations of CIGAR */
+constexpr byte SAM_CIGAR_LEN = 9;   /**< @brief Lengths of CIGAR */
+constexpr byte SAM_RNEXT     = 10;  /**< @brief References of the mates */
+constexpr byte SAM_PNEXT     = 11;  /**< @brief Positions of the mates */
+constexpr byte SAM_TLEN      = 12;  /**< @brief Lengths of the templates */
+constexpr byte SAM_SEQ       = 13;  /**< @brief Sequences */
+constexpr byte SAM_QUAL      = 14;  /**< @brief Quality scores */
+constexpr byte SAM_TAG_KEY   = 15;  /**< @brief Index of the keys of tags */
+constexpr byte SAM_TAG_VAL   = 16;  /**< @brief Values of tags */
+constexpr byte N_SAM_STRM    = 17;  /**< @brief Streams in a chunk of SAM */
+constexpr byte SAM_MIN_COL   = 11;  /**< @brief Columns of a record, min */
+
+/**
+ * @brief Compression/Decompression of SAM. The columns of the records of a
+ *        chunk go to their own streams: the names of the reads as headers
+ *        and the quality scores as such, by the categories of their chars
+ *        in the file, the sequences as sequences, the references as runs,
+ *        the positions as deltas, CIGAR by operations and lengths, and the
+ *        keys of the tags by a dictionary
+ */
+class Sam : public Table
+{
+ public:
+  auto compress () -> void;
+  auto decompress () -> void;
+  auto analyze () -> void;
+
+ private:
+  vector<string> hdrUnpack;  /**< @brief Lookup table for unpacking names */
+  vector<string> qsUnpack;   /**< @brief Lookup table for unpacking q scores*/
+
+  auto gather_h_q (std::istream&, string&, string&) -> void;
+  auto set_streams () -> void;
+  auto set_pack (const string&, const string&) -> void;
+  auto is_record (const tblcols_s&, const string&, u64) const -> bool;
+  auto pack_chunk (string&, const vector<string>&) -> void;
+  auto add_record (tblcols_s&, u64) const -> void;
+  auto unpack_chunk (string&, string::iterator&) -> void;
+};
+
+#endif //CRYFA_SAM_H
@@ -11,7 +11,9 @@
 #include <mutex>
 #include <cstring>
 #include <iomanip>      // setw, setprecision
+#include <limits>
 #include "security.hpp"
+#include "statmutex.hpp"
 #include "fn.hpp"
 #include "cryptopp/aes.h"
 #include "cryptopp/eax.h"
@@ -31,12 +33,38 @@ using CryptoPP::CBC_Mode;
 using CryptoPP::StreamTransformationFilter;
 using CryptoPP::FileSource;
 using CryptoPP::FileSink;
+using CryptoPP::StringSource;
+using CryptoPP::StringSink;
 using CryptoPP::Redirector;
 using CryptoPP::AuthenticatedEncryptionFilter;
 using CryptoPP::AuthenticatedDecryptionFilter;
 using CryptoPP::GCM;
 
-std::mutex mutxSec;    /**< @brief Mutex */
+StatMutex mutxSec("mutxSec");    /**< @brief Mutex */
+std::array<byte, 16> Security::cipherKey;
+std::array<byte, 16> Security::cipherJ0;
+u64                  Security::plainSize = 0;
+
+namespace {
+/**
+ * @brief Multiply in GF(2^128), as GHASH of GCM: x = x * y
+ * @param x  Block
+ * @param y  Block
+ */
+void gf_mult (byte* x, const byte* y) {
+  byte z[16] {},  v[16];
+  memcpy(v, y, 16);
+  for (int i = 0; i != 128; ++i) {
+    if (x[i/8] >> (7 - i%8) & 1)
+      for (int b = 0; b != 16; ++b)    z[b] ^= v[b];
+    const bool lsb = (v[15] & 1) != 0;
+    for (int b = 15; b; --b)    v[b] = (byte) (v[b] >> 1 | v[b-1] << 7);
+    v[0] >>= 1;
+    if (lsb)    v[0] ^= 0xe1;
+  }
+  memcpy(x, z, 16);
+}
+}
 
 /**
  * @brief   Encrypt
@@ -133,6 +161,99 @@ void Security::decrypt () {
        << std::fixed << setprecision(4) << elapsed.count() << " seconds.\n";
 }
 
+/**
+ * @brief   Set the cipher for decrypt_range(): the key, and the counter
+ *          block of GCM, from the IV of 16 bytes
+ * @details GCM is AES in counter mode, which can be decrypted from any
+ *          position. The tag is at the end, so the data is not
+ *          authenticated
+ */
+void Security::open_cipher () {
+  assert_file_good(in_file, "Error: failed opening \"" + in_file + "\".\n");
+  byte iv[AES::BLOCKSIZE];
+  memset(cipherKey.data(), 0x00, cipherKey.size());
+  memset(iv, 0x00, (size_t) AES::BLOCKSIZE);
+  const string pass = file_to_string(key_file);
+  build_key(cipherKey.data(), pass);
+  build_iv(iv, pass);
+
+  // J0 = GHASH(IV, then the length of IV in bits), with H = AES(0)
+  byte h[AES::BLOCKSIZE] {},  len[AES::BLOCKSIZE] {};
+  AES::Encryption aes(cipherKey.data(), cipherKey.size());
+  aes.ProcessBlock(h);
+  len[AES::BLOCKSIZE - 1] = (byte) (8 * AES::BLOCKSIZE);
+  memset(cipherJ0.data(), 0x00, cipherJ0.size());
+  for (const byte* blk : {(const byte*) iv, (const byte*) len}) {
+    for (byte b = 0; b != AES::BLOCKSIZE; ++b)    cipherJ0[b] ^= blk[b];
+    gf_mult(cipherJ0.data(), h);
+  }
+
+  ifstream in(in_file, std::ios::binary | std::ios::ate);
+  const auto fileSize = (u64) in.tellg();
+  plainSize = fileSize > TAG_SIZE ? fileSize - TAG_SIZE : 0;
+}
+
+/**
+ * @brief Decrypt a range of the packed file, with no authentication. Call
+ *        open_cipher() first
+ * @param pos  Position, in the decrypted file
+ * @param len  Length. Cut at the end of the file
+ * @param out  Decrypted
+ */
+void Security::decrypt_range (u64 pos, u64 len, string& out) const {
+  out.clear();
+  if (pos >= plainSize)    return;
+  len = std::min(len, plainSize - pos);
+
+  const u64 blk   = AES::BLOCKSIZE;
+  const u64 first = pos / blk;
+  const u64 nBlk  = (pos + len + blk - 1) / blk - first;
+  string cipher(nBlk * blk, '\0'),  ctr(nBlk * blk, '\0');
+  ifstream in(in_file, std::ios::binary);
+  in.seekg((std::streamoff) (first * blk));
+  in.read(&cipher[0], (std::streamsize) std::min(nBlk*blk, plainSize-first*blk));
+
+  // Counter blocks: J0, with the last 4 bytes + 1 + block number
+  const u32 j0 = (u32) cipherJ0[12] << 24 | (u32) cipherJ0[13] << 16 |
+                 (u32) cipherJ0[14] << 8  | (u32) cipherJ0[15];
+  for (u64 b = 0; b != nBlk; ++b) {
+    const auto c = (u32) (j0 + first + b + 1);
+    char* p = &ctr[b * blk];
+    memcpy(p, cipherJ0.data(), 12);
+    p[12] = (char) (c >> 24);    p[13] = (char) (c >> 16);
+    p[14] = (char) (c >> 8);     p[15] = (char) c;
+  }
+  AES::Encryption aes(cipherKey.data(), cipherKey.size());
+  string plain(nBlk * blk, '\0');
+  aes.AdvancedProcessBlocks((const byte*) ctr.data(),
+                            (const byte*) cipher.data(),
+                            (byte*) &plain[0], plain.size(), 0);
+  out.assign(plain, pos - first*blk, len);
+}
+
+/**
+ * @brief  Speed of encryption on this machine. Encrypts 1 MB with AES/GCM
+ * @return Bytes per second
+ */
+double Security::gcm_speed () const {
+  byte key[AES::DEFAULT_KEYLENGTH], iv[AES::BLOCKSIZE];
+  memset(key, 0x00, (size_t) AES::DEFAULT_KEYLENGTH);   // AES key
+  memset(iv,  0x00, (size_t) AES::BLOCKSIZE);           // Initialization Vector
+  const string plain(1024 * 1024, 'A');
+  string       cipher;
+
+  const auto start = high_resolution_clock::now();  // Start timer
+  GCM<AES>::Encryption e;
+  e.SetKeyWithIV(key, sizeof(key), iv, sizeof(iv));
+  StringSource(plain, true,
+               new AuthenticatedEncryptionFilter(e, new StringSink(cipher),
+                                                 false, TAG_SIZE));
+  const auto finish = high_resolution_clock::now();        // Stop timer
+  std::chrono::duration<double> elapsed = finish - start;  // Dur. (sec)
+  
+  return elapsed.count() > 0 ? plain.size() / elapsed.count() : 1e12;
+}
+
 /**
  * @brief Random number seed -- Emulate C srand()
  * @param s  Seed
@@ -190,19 +311,32 @@ void Security::shuffle (string& str) {
  * @param size  Size of shuffled string
  */
 void Security::unshuffle (string::iterator& i, u64 size) {
-  string shuffledStr;     // Copy of shuffled string
-  for (u64 j=0; j!=size; ++j, ++i)    shuffledStr += *i;
+  // Positions of 4 bytes, instead of 8, when they fit. std::shuffle depends
+  // only on the difference type, so the permutation is the same
+  if (size <= std::numeric_limits<u32>::max())
+    unshuffle_pos<u32>(i, size);
+  else
+    unshuffle_pos<u64>(i, size);
+}
+
+/**
+ * @brief Unshuffle, with positions of type T
+ * @param i     Shuffled string iterator
+ * @param size  Size of shuffled string
+ */
+template <typename T>
+void Security::unshuffle_pos (string::iterator& i, u64 size) {
+  const string shuffledStr(i, i+size);     // Copy of shuffled string
   auto shIt = shuffledStr.begin();
-  i -= size;
   
   // Shuffle vector of positions
-  vector<u64> vPos(size);
+  vector<T> vPos(size);
   std::iota(vPos.begin(), vPos.end(), 0);     // Insert 0 .. N-1
   gen_shuff_seed();
   std::shuffle(vPos.begin(), vPos.end(), rng_t(seed_shared));
   
   // Insert unshuffled data
-  for (const u64& vI : vPos)  *(i + vI) = *shIt++;       // *shIt, then ++shIt
+  for (const T& vI : vPos)  *(i + vI) = *shIt++;         // *shIt, then ++shIt
 }
 
 /**
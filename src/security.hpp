@@ -10,6 +10,7 @@
 #ifndef CRYFA_SECURITY_H
 #define CRYFA_SECURITY_H
 
+#include <array>
 #include "def.hpp"
 
 /**
@@ -20,23 +21,31 @@ class Security : public Param
  public:
   Security () = default;
   auto decrypt () -> void;
+  auto open_cipher () -> void;
+  auto decrypt_range (u64, u64, string&) const -> void;
   
  protected:
   bool shuffInProg = true;  /**< @brief Shuffle in progress @hideinitializer */
   bool shuffled    = true;  /**< @hideinitializer */
   
   auto encrypt () -> void;
+  auto gcm_speed () const -> double;
   auto shuffle (string&) -> void;
   auto unshuffle (string::iterator&, u64) -> void;
   
  private:
   u64  seed_shared;         /**< @brief Shared seed */
+  static std::array<byte, 16> cipherKey;  /**< @brief Key, of decrypt_range*/
+  static std::array<byte, 16> cipherJ0;   /**< @brief Pre-counter block */
+  static u64 plainSize;     /**< @brief Size of the decrypted file */
 //    const int TAG_SIZE = 12; /**< @brief Tag size used in GCC mode auth enc */
 
   auto srandom (u32) -> void;
   auto random () -> int;
   auto random_engine () -> std::minstd_rand0&;
   auto gen_shuff_seed () -> void;
+  template <typename T>
+  auto unshuffle_pos (string::iterator&, u64) -> void;
   auto build_iv (byte*, const string&) -> void;
   auto build_key (byte*, const string&) -> void;
 
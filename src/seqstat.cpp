@@ -0,0 +1,393 @@
+/**
+ * @file      seqstat.cpp
+ * @brief     Statistics of the sequences and the quality scores of a file
+ * @author    Morteza Hosseini  (seyedmorteza@ua.pt)
+ * @author    Diogo Pratas      (pratas@ua.pt)
+ * @author    Armando J. Pinho  (ap@ua.pt)
+ * @copyright The GNU General Public License v3.0
+ */
+
+#include <iomanip>      // setw, setprecision
+#include <algorithm>
+#include <array>
+#include "seqstat.hpp"
+#include "assert.hpp"
+using std::setw;
+using std::setprecision;
+
+namespace {
+/** @brief Bases of the 2bit codec and of the packfix codec */
+const char BASE_2BIT[] = "ACGT";
+const char BASE_FIX[]  = "ACGTNX";
+
+/** @brief Percentage */
+double pct (u64 part, u64 whole) { return whole ? 100.0 * part / whole : 0; }
+}
+
+/**
+ * @brief Set the counts
+ * @param nThread  Number of threads which count
+ * @param span_    Sequences might continue in the next chunk
+ */
+void SeqStat::init (byte nThread, bool span_) {
+  span = span_;
+  count.assign(nThread, count_s());
+  edges.assign(nThread, std::map<u64, edge_s>());
+}
+
+/**
+ * @brief Add the lengths of the sequences of a chunk
+ * @param thr       Thread ID
+ * @param chunk     Chunk number
+ * @param lens      Lengths of the fields
+ * @param fixedLen  A sequence every fixedLen bases, if not 0
+ */
+void SeqStat::add_lens (byte thr, u64 chunk, const vector<u64>& lens,
+                        u64 fixedLen) {
+  auto& len = count[thr].len;
+  if (!span) {
+    for (u64 l : lens)
+      if (fixedLen)    len[fixedLen] += l / fixedLen;
+      else             ++len[l];
+    return;
+  }
+
+  vector<u64> field;
+  if (!fixedLen)    field = lens;
+  else
+    for (u64 l : lens)    field.insert(field.end(), l / fixedLen, fixedLen);
+  if (field.empty())    return;
+
+  edge_s& e = edges[thr][chunk];
+  e.first = field.front();
+  e.last  = field.back();
+  e.open  = (field.size() == 1);
+  for (u64 f = 1; f + 1 < field.size(); ++f)    ++len[field[f]];
+}
+
+/**
+ * @brief Add lines of bases
+ * @param thr    Thread ID
+ * @param chunk  Chunk number
+ * @param beg    Beginning of the lines, each one ending with '\n'
+ * @param end    End of the lines
+ */
+void SeqStat::add_bases (byte thr, u64 chunk, citer_t beg, citer_t end) {
+  u64* base = count[thr].base;
+  vector<u64> lens;
+  for (auto i = beg; i != end; ++i) {
+    const auto lf = std::find(i, end, '\n');
+    lens.push_back((u64) (lf - i));
+    for (; i != lf; ++i)    ++base[(byte) *i];
+  }
+  add_lens(thr, chunk, lens, 0);
+}
+
+/**
+ * @brief Add a stream of the 2bit codec, with no unpacking: the bases of a
+ *        byte are taken from a table
+ * @param thr       Thread ID
+ * @param chunk     Chunk number
+ * @param beg       Beginning of the encoded stream
+ * @param end       End of the encoded stream
+ * @param fixedLen  A sequence every fixedLen bases, if not 0
+ */
+void SeqStat::add_2bit (byte thr, u64 chunk, citer_t beg, citer_t end,
+                        u64 fixedLen) {
+  static const auto comp = [] {
+    std::array<std::array<byte, 4>, 256> c {};
+    for (u16 b = 0; b != 256; ++b)
+      for (byte s = 0; s != 4; ++s)    ++c[b][(b >> 2*s) & 3];
+    return c;
+  }();
+
+  auto i = beg;
+  vector<u64> lens(get_count(i, end));
+  const u64 maxBases = 4 * (u64) (end - beg);
+  u64 total = 0;
+  for (auto& l : lens) {
+    l = get_varint(i, end);
+    assert(l > maxBases - total, WRONG_KEY);
+    total += l;
+  }
+  assert((u64) (end - i) != (total + 3) / 4, WRONG_KEY);
+
+  u64 acc[4] {};
+  for (const auto full = i + (i64) (total / 4); i != full; ++i)
+    for (byte s = 0; s != 4; ++s)    acc[s] += comp[(byte) *i][s];
+  for (byte s = 0; s != total % 4; ++s)                     // Last byte
+    ++acc[((byte) *i >> (6 - 2*s)) & 3];
+
+  for (byte s = 0; s != 4; ++s)
+    count[thr].base[(byte) BASE_2BIT[s]] += acc[s];
+  add_lens(thr, chunk, lens, fixedLen);
+}
+
+/**
+ * @brief Add a stream of the packfix codec, with no unpacking: the bases of
+ *        a byte are taken from a table. The pads are taken out, and the
+ *        escapes are put instead of 'X'
+ * @param thr       Thread ID
+ * @param chunk     Chunk number
+ * @param beg       Beginning of the encoded stream
+ * @param end       End of the encoded stream
+ * @param fixedLen  A sequence every fixedLen bases, if not 0
+ */
+void SeqStat::add_pack_fix (byte thr, u64 chunk, citer_t beg, citer_t end,
+                            u64 fixedLen) {
+  static const auto comp = [] {
+    std::array<std::array<byte, 6>, 256> c {};
+    for (u16 b = 0; b != 216; ++b) {
+      ++c[b][b/36];    ++c[b][b/6 % 6];    ++c[b][b % 6];
+    }
+    return c;
+  }();
+
+  u64* base = count[thr].base;
+  citer_t i = beg;
+  vector<u64> lens(get_count(i, end));
+  const u64 maxLen = 3 * (u64) (end - beg);
+  u64 total=0, nByte=0, pad=0;
+  for (auto& l : lens) {
+    l = get_varint(i, end);
+    assert(l > maxLen - total, WRONG_KEY);
+    total += l;
+    nByte += (l + 2) / 3;
+    pad   += (3 - l%3) % 3;
+  }
+  const u64 nEsc = get_count(i, end);
+  for (u64 e = nEsc; e--; ++i) {
+    get_varint(i, end);
+    assert(i == end, WRONG_KEY);
+    ++base[(byte) *i];
+  }
+  assert((u64) (end - i) != nByte, WRONG_KEY);
+
+  u64 acc[6] {};
+  for (; i != end; ++i) {
+    assert((byte) *i >= 216, WRONG_KEY);
+    for (byte s = 0; s != 6; ++s)    acc[s] += comp[(byte) *i][s];
+  }
+  assert(acc[0] < pad || acc[5] != nEsc, WRONG_KEY);
+  acc[0] -= pad;                                            // Pads: A
+
+  for (byte s = 0; s != 5; ++s)    base[(byte) BASE_FIX[s]] += acc[s];
+  add_lens(thr, chunk, lens, fixedLen);
+}
+
+/**
+ * @brief Add a stream of the pack codec of sequences, with no unpacking: the
+ *        bases of a byte are taken from the unpack table, and an 'X' from
+ *        the bytes which follow
+ * @param thr       Thread ID
+ * @param chunk     Chunk number
+ * @param beg       Beginning of the encoded stream
+ * @param end       End of the encoded stream
+ * @param fixedLen  A sequence every fixedLen bases, if not 0
+ * @param unpack    Table for unpacking 3 bases from a byte
+ */
+void SeqStat::add_pack (byte thr, u64 chunk, citer_t beg, citer_t end,
+                        u64 fixedLen, const vector<string>& unpack) {
+  u64* base = count[thr].base;
+  vector<u64> lens;
+  u64 l = 0;
+  for (auto i = beg; i != end; ++i) {
+    if (*i == (char) 254) {                                 // End of field
+      lens.push_back(l);
+      l = 0;
+    }
+    else if (*i == (char) 255) {                   // Len not multiple of 3
+      assert(++i == end, WRONG_KEY);
+      ++base[(byte) *i];
+      ++l;
+    }
+    else {
+      assert((byte) *i >= unpack.size(), WRONG_KEY);
+      for (char c : unpack[(byte) *i]) {
+        if (c == 'X') { assert(++i == end, WRONG_KEY);    c = *i; }
+        ++base[(byte) c];
+      }
+      l += 3;
+    }
+  }
+  add_lens(thr, chunk, lens, fixedLen);
+}
+
+/**
+ * @brief Add lines of quality scores
+ * @param thr  Thread ID
+ * @param beg  Beginning of the lines, each one ending with '\n'
+ * @param end  End of the lines
+ */
+void SeqStat::add_qs (byte thr, citer_t beg, citer_t end) {
+  u64* qs = count[thr].qs;
+  for (auto i = beg; i != end; ++i)    ++qs[(byte) *i];
+  qs['\n'] = 0;
+}
+
+/**
+ * @brief Add a stream of the pack codec of quality scores, with no
+ *        unpacking: the scores of a byte, or 2 bytes, are taken from the
+ *        unpack table
+ * @param thr      Thread ID
+ * @param beg      Beginning of the encoded stream
+ * @param end      End of the encoded stream
+ * @param unpack   Table for unpacking
+ * @param twoByte  A tuple is packed in 2 bytes
+ */
+void SeqStat::add_qs_pack (byte thr, citer_t beg, citer_t end,
+                           const vector<string>& unpack, bool twoByte) {
+  u64* qs = count[thr].qs;
+  for (auto i = beg; i != end;) {
+    if (*i == (char) 254)    ++i;                           // End of field
+    else if (*i == (char) 255) {                  // Len not multiple of key
+      assert(end - i < 2, WRONG_KEY);
+      ++qs[(byte) *(i+1)];
+      i += 2;
+    }
+    else if (twoByte) {
+      assert(end - i < 2, WRONG_KEY);
+      const u16 idx = (u16) ((byte) *i << 8 | (byte) *(i+1));
+      assert(idx >= unpack.size(), WRONG_KEY);
+      for (char c : unpack[idx])    ++qs[(byte) c];
+      i += 2;
+    }
+    else {
+      assert((byte) *i >= unpack.size(), WRONG_KEY);
+      for (char c : unpack[(byte) *i])    ++qs[(byte) c];
+      ++i;
+    }
+  }
+}
+
+/**
+ * @brief Merge the counts of the threads. Then join the sequences across
+ *        chunks, in order of the chunks. The empty sequence before the
+ *        first header of a FASTA file is not counted
+ */
+void SeqStat::merge () {
+  count_s& all = count[0];
+  for (u64 t = 1; t < count.size(); ++t) {
+    for (u16 s = 0; s != 256; ++s) {
+      all.base[s] += count[t].base[s];
+      all.qs[s]   += count[t].qs[s];
+    }
+    for (const auto& e : count[t].len)    all.len[e.first] += e.second;
+  }
+  count.resize(1);
+  if (!span)    return;
+
+  std::map<u64, edge_s> chunks;
+  for (auto& m : edges) { chunks.insert(m.begin(), m.end());    m.clear(); }
+
+  u64  carry = 0;           // Length of the sequence, which is not ended yet
+  bool first = true;
+  for (const auto& c : chunks) {
+    carry += c.second.first;
+    if (c.second.open)    continue;
+    if (!first || carry)    ++all.len[carry];
+    first = false;
+    carry = c.second.last;
+  }
+  if (!chunks.empty() && (!first || carry))    ++all.len[carry];
+}
+
+/**
+ * @brief Save the merged counts, to be loaded with no unpacking
+ * @param out  Output: symbols and counts of bases, of quality scores, then
+ *             lengths and counts of sequences, as varints
+ */
+void SeqStat::save (string& out) const {
+  const auto put_sym = [&out] (const u64* cnt) {
+    put_varint(out, (u64) std::count_if(cnt, cnt+256,
+                                        [] (u64 n) { return n != 0; }));
+    for (u16 s = 0; s != 256; ++s)
+      if (cnt[s]) { put_varint(out, s);    put_varint(out, cnt[s]); }
+  };
+  put_sym(count[0].base);
+  put_sym(count[0].qs);
+  put_varint(out, count[0].len.size());
+  for (const auto& e : count[0].len) {
+    put_varint(out, e.first);
+    put_varint(out, e.second);
+  }
+}
+
+/**
+ * @brief Load the counts, saved by save()
+ * @param i    Beginning of the saved counts
+ * @param end  End of the saved counts
+ */
+void SeqStat::load (citer_t i, citer_t end) {
+  count.assign(1, count_s());
+  edges.clear();
+  const auto get_sym = [&i, end] (u64* cnt) {
+    for (u64 n = get_count(i, end); n--;) {
+      const auto s = (byte) get_varint(i, end);
+      cnt[s] = get_varint(i, end);
+    }
+  };
+  get_sym(count[0].base);
+  get_sym(count[0].qs);
+  for (u64 n = get_count(i, end); n--;) {
+    const u64 len = get_varint(i, end);
+    count[0].len[len] = get_varint(i, end);
+  }
+}
+
+/**
+ * @brief Print the merged counts
+ * @param out    Output, e.g., cout
+ * @param fastq  Print the quality scores, too
+ */
+void SeqStat::print (std::ostream& out, bool fastq) const {
+  const count_s& c = count[0];
+  u64 nSeq = 0,  nBase = 0;
+  for (const auto& e : c.len) { nSeq += e.second;  nBase += e.first*e.second; }
+  const auto sum = [&c] (const char* sym) {
+    u64 n = 0;
+    for (; *sym; ++sym)    n += c.base[(byte) *sym];
+    return n;
+  };
+  const u64 gc = sum("CGcg"),  acgt = sum("ACGTacgt"),  n = sum("Nn");
+
+  out << std::fixed << setprecision(2)
+      << "  Sequences              " << nSeq  << '\n'
+      << "  Bases                  " << nBase << '\n';
+  if (nSeq)
+    out << "  Length                 min " << c.len.begin()->first
+        << ", max " << c.len.rbegin()->first
+        << ", mean " << (double) nBase / nSeq << '\n';
+  out << "  GC                     " << pct(gc, acgt) << "%\n"
+      << "  N                      " << pct(n, nBase) << "%\n"
+      << "  Bases by symbol       ";
+  for (u16 s = 0; s != 256; ++s)
+    if (c.base[s])    out << "  " << (char) s << ':' << c.base[s];
+  out << '\n';
+
+  // Lengths: each one, or in bins of the same width
+  out << "  Length histogram\n";
+  if (c.len.size() <= STAT_LEN_BIN) {
+    for (const auto& e : c.len)
+      out << "  " << setw(22) << e.first << "  " << e.second << '\n';
+  }
+  else {
+    const u64 lo    = c.len.begin()->first;
+    const u64 width = (c.len.rbegin()->first - lo) / STAT_LEN_BIN + 1;
+    vector<u64> bin(STAT_LEN_BIN);
+    for (const auto& e : c.len)    bin[(e.first - lo) / width] += e.second;
+    for (u64 b = 0; b != STAT_LEN_BIN; ++b)
+      if (bin[b])
+        out << "  " << setw(10) << lo + b*width << " - "
+            << setw(9) << lo + (b+1)*width - 1 << "  " << bin[b] << '\n';
+  }
+
+  if (!fastq)    return;
+  u64 nQs = 0;
+  for (u64 q : c.qs)    nQs += q;
+  out << "  Quality histogram\n";
+  for (u16 s = 0; s != 256; ++s)
+    if (c.qs[s])
+      out << "  " << setw(22) << "Q" + std::to_string(s - PHRED_OFF)
+          << "  " << c.qs[s] << " (" << pct(c.qs[s], nQs) << "%)\n";
+}
@@ -0,0 +1,63 @@
+/**
+ * @file      seqstat.hpp
+ * @brief     Statistics of the sequences and the quality scores of a file
+ * @author    Morteza Hosseini  (seyedmorteza@ua.pt)
+ * @author    Diogo Pratas      (pratas@ua.pt)
+ * @author    Armando J. Pinho  (ap@ua.pt)
+ * @copyright The GNU General Public License v3.0
+ */
+
+#ifndef CRYFA_SEQSTAT_H
+#define CRYFA_SEQSTAT_H
+
+#include <map>
+#include <ostream>
+#include "codec.hpp"
+
+/**
+ * @brief Base composition, histogram of the sequence lengths and histogram
+ *        of the quality scores. Each thread counts on its own, then they are
+ *        merged. If a sequence might continue in the next chunk, i.e., FASTA,
+ *        the lengths of the first and the last sequences of a chunk are
+ *        joined with the neighbor chunks at the merge
+ */
+class SeqStat
+{
+ public:
+  auto init (byte, bool) -> void;
+  auto add_bases (byte, u64, citer_t, citer_t) -> void;
+  auto add_2bit (byte, u64, citer_t, citer_t, u64) -> void;
+  auto add_pack_fix (byte, u64, citer_t, citer_t, u64) -> void;
+  auto add_pack (byte, u64, citer_t, citer_t, u64,
+                 const vector<string>&) -> void;
+  auto add_qs (byte, citer_t, citer_t) -> void;
+  auto add_qs_pack (byte, citer_t, citer_t, const vector<string>&,
+                    bool) -> void;
+  auto merge () -> void;
+  auto save (string&) const -> void;
+  auto load (citer_t, citer_t) -> void;
+  auto print (std::ostream&, bool) const -> void;
+
+ private:
+  /** @brief Counts of a thread */
+  struct count_s {
+    u64 base[256] {};                /**< @brief Bases, by symbol */
+    u64 qs[256] {};                  /**< @brief Quality scores, by symbol */
+    std::map<u64, u64> len;          /**< @brief Sequences, by length */
+  };
+
+  /** @brief Lengths of the first and the last sequences of a chunk */
+  struct edge_s {
+    u64  first = 0;       /**< @brief First sequence @hideinitializer */
+    u64  last  = 0;       /**< @brief Last sequence @hideinitializer */
+    bool open  = false;   /**< @brief One sequence only @hideinitializer */
+  };
+
+  bool span = false;                  /**< @brief Across chunks @hideinitializer*/
+  vector<count_s> count;              /**< @brief By thread */
+  vector<std::map<u64, edge_s>> edges;/**< @brief By thread, then chunk */
+
+  auto add_lens (byte, u64, const vector<u64>&, u64) -> void;
+};
+
+#endif //CRYFA_SEQSTAT_H
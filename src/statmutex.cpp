@@ -0,0 +1,144 @@
+/**
+ * @file      statmutex.cpp
+ * @brief     Mutex with lock contention statistics
+ * @author    Morteza Hosseini  (seyedmorteza@ua.pt)
+ * @author    Diogo Pratas      (pratas@ua.pt)
+ * @author    Armando J. Pinho  (ap@ua.pt)
+ * @copyright The GNU General Public License v3.0
+ */
+
+#include <iomanip>      // setw, setprecision
+#include <algorithm>
+#include "statmutex.hpp"
+using std::cerr;
+using std::setw;
+using std::setprecision;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+
+namespace {
+/** @brief Mutexes alive, to be reported. Built on first use */
+vector<const StatMutex*>& registry () {
+  static vector<const StatMutex*> reg;
+  return reg;
+}
+std::mutex mutxReg;    /**< @brief Mutex of the registry */
+}
+
+/**
+ * @brief Constructor. Register the mutex, to be reported
+ * @param name_  Name, in the statistics
+ */
+StatMutex::StatMutex (const string& name_) : name(name_) {
+  std::lock_guard<std::mutex> lock(mutxReg);
+  registry().push_back(this);
+}
+
+/**
+ * @brief Destructor. Unregister the mutex
+ */
+StatMutex::~StatMutex () {
+  std::lock_guard<std::mutex> lock(mutxReg);
+  auto& reg = registry();
+  reg.erase(std::remove(reg.begin(), reg.end(), this), reg.end());
+}
+
+/**
+ * @brief Lock. Time the wait only if the lock is contended
+ */
+void StatMutex::lock () {
+  if (mutx.try_lock()) {
+    lockedAt = clock_t::now();
+    ++nAcquire;
+    return;
+  }
+
+  const auto start = clock_t::now();
+  mutx.lock();
+  lockedAt = clock_t::now();
+  const auto wait =
+    (u64) duration_cast<nanoseconds>(lockedAt - start).count();
+  ++nAcquire;
+  ++nContend;
+  waitNs += wait;
+  if (wait > maxWaitNs)    maxWaitNs = wait;
+}
+
+/**
+ * @brief  Try to lock
+ * @return true, if locked
+ */
+bool StatMutex::try_lock () {
+  if (!mutx.try_lock())    return false;
+  lockedAt = clock_t::now();
+  ++nAcquire;
+  return true;
+}
+
+/**
+ * @brief Unlock. Add the hold time to the histogram
+ */
+void StatMutex::unlock () {
+  const auto hold =
+    (u64) duration_cast<nanoseconds>(clock_t::now() - lockedAt).count();
+  holdNs += hold;
+  ++holdHist[hist_bin(hold)];
+  mutx.unlock();
+}
+
+/**
+ * @brief   Add a wait on a condition, e.g., for a queue or a budget
+ * @param   ns  Nanoseconds waited
+ * @warning Call it while the lock is held
+ */
+void StatMutex::add_wait (u64 ns) {
+  ++nCondWait;
+  condNs += ns;
+}
+
+/**
+ * @brief  Bin of the hold time histogram: <256ns, <1us, <4us, ..., >=4ms
+ * @param  ns  Hold time in nanoseconds
+ * @return Bin
+ */
+byte StatMutex::hist_bin (u64 ns) {
+  byte bin = 0;
+  for (ns >>= 8; ns && bin != HOLD_HIST_BIN-1; ns >>= 2)    ++bin;
+  return bin;
+}
+
+/**
+ * @brief Print statistics of this mutex
+ */
+void StatMutex::print () const {
+  static const char* binName[HOLD_HIST_BIN] =
+    {"<256ns", "<1us", "<4us", "<16us", "<64us", "<256us", "<1ms", "<4ms",
+     ">=4ms"};
+  const auto ms = [] (u64 ns) -> double { return ns / 1e6; };
+
+  cerr << "  " << std::left << setw(10) << name << std::right
+       << " acquired " << nAcquire << ", contended " << nContend
+       << std::fixed << setprecision(2)
+       << " (" << (nAcquire ? 100.0 * nContend / nAcquire : 0.0) << "%)"
+       << setprecision(3)
+       << ", wait " << ms(waitNs) << " ms (max " << ms(maxWaitNs) << " ms)"
+       << ", hold " << ms(holdNs) << " ms\n";
+  if (nCondWait)
+    cerr << "  " << setw(10) << ' ' << " waited on condition " << nCondWait
+         << " times, " << ms(condNs) << " ms\n";
+
+  cerr << "  " << setw(10) << ' ' << " hold";
+  for (byte b = 0; b != HOLD_HIST_BIN; ++b)
+    if (holdHist[b])    cerr << "  " << binName[b] << ':' << holdHist[b];
+  cerr << '\n';
+}
+
+/**
+ * @brief Print statistics of the mutexes which have been locked
+ */
+void StatMutex::print_all () {
+  std::lock_guard<std::mutex> lock(mutxReg);
+  cerr << "Lock statistics:\n";
+  for (const StatMutex* m : registry())
+    if (m->nAcquire)    m->print();
+}
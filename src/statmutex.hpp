@@ -0,0 +1,53 @@
+/**
+ * @file      statmutex.hpp
+ * @brief     Mutex with lock contention statistics
+ * @author    Morteza Hosseini  (seyedmorteza@ua.pt)
+ * @author    Diogo Pratas      (pratas@ua.pt)
+ * @author    Armando J. Pinho  (ap@ua.pt)
+ * @copyright The GNU General Public License v3.0
+ */
+
+#ifndef CRYFA_STATMUTEX_H
+#define CRYFA_STATMUTEX_H
+
+#include <mutex>
+#include <chrono>
+#include "def.hpp"
+
+/**
+ * @brief Mutex which counts acquisitions and measures the wait and hold
+ *        times. The counters are updated while the lock is held, so they
+ *        need no atomics, and an uncontended lock costs two clock reads
+ */
+class StatMutex
+{
+ public:
+  explicit StatMutex (const string&);
+  ~StatMutex ();
+  StatMutex (const StatMutex&) = delete;
+  auto operator= (const StatMutex&) -> StatMutex& = delete;
+  auto lock () -> void;
+  auto try_lock () -> bool;
+  auto unlock () -> void;
+  auto add_wait (u64) -> void;
+  static auto print_all () -> void;
+
+ private:
+  using clock_t = std::chrono::steady_clock;
+  std::mutex   mutx;                /**< @brief Mutex */
+  const string name;                /**< @brief Name, in the statistics */
+  clock_t::time_point lockedAt;     /**< @brief Time of the last lock */
+  u64 nAcquire  = 0;  /**< @brief Acquisitions @hideinitializer */
+  u64 nContend  = 0;  /**< @brief Acquisitions that waited @hideinitializer */
+  u64 waitNs    = 0;  /**< @brief Total wait for the lock @hideinitializer */
+  u64 maxWaitNs = 0;  /**< @brief Max wait for the lock @hideinitializer */
+  u64 holdNs    = 0;  /**< @brief Total hold time @hideinitializer */
+  u64 nCondWait = 0;  /**< @brief Waits on a condition @hideinitializer */
+  u64 condNs    = 0;  /**< @brief Total wait on a condition @hideinitializer */
+  u64 holdHist[HOLD_HIST_BIN] {};   /**< @brief Histogram of hold times */
+
+  static auto hist_bin (u64) -> byte;
+  auto print () const -> void;
+};
+
+#endif //CRYFA_STATMUTEX_H
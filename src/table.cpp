@@ -0,0 +1,531 @@
+/**
+ * @file      table.cpp
+ * @brief     Compression/Decompression of tab-separated text, by columns
+ * @author    Morteza Hosseini  (seyedmorteza@ua.pt)
+ * @author    Diogo Pratas      (pratas@ua.pt)
+ * @author    Armando J. Pinho  (ap@ua.pt)
+ * @copyright The GNU General Public License v3.0
+ */
+
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <iomanip>      // setw, setprecision
+#include <algorithm>
+#include "table.hpp"
+#include "statmutex.hpp"
+#include "assert.hpp"
+using std::chrono::high_resolution_clock;
+using std::thread;
+using std::cout;
+using std::cerr;
+using std::ifstream;
+using std::ofstream;
+using std::to_string;
+using std::setprecision;
+
+StatMutex mutxTBL("mutxTBL");    /**< @brief Mutex */
+
+/**
+ * @brief Compress. The streams have to be set
+ * @param type     Type: 'V' for VCF, ...
+ * @param headers  Chars of the stream of headers, if any
+ * @param qscores  Chars of the stream of quality scores, if any
+ * @param packFP   Packs a chunk of lines
+ * @param start    Start time
+ */
+void Table::compress_table (char type, const string& headers,
+                            const string& qscores, packTblFP_t packFP,
+                            tpoint_t start) {
+  thread arrThr[n_threads];
+  budget.set_cap(max_memory);
+  detect_no_eol();
+
+  // Distribute file among threads, for reading and packing
+  for (byte t=0; t != n_threads; ++t)
+    arrThr[t] = thread(&Table::guard, this,
+                       [this, packFP, t] { pack(packFP, t); });
+  for (auto& thr : arrThr)
+    if (thr.joinable())    thr.join();
+  rethrow();
+
+  if (verbose)    cerr << "Shuffling done!\n";
+
+  // Join partially packed and/or shuffled files
+  join_packed_files(headers, qscores, type, false);
+
+  const auto finish = high_resolution_clock::now();                // Stop timer
+  std::chrono::duration<double> elapsed = finish - start;          // Dur. (sec)
+
+  cerr << (verbose ? "Compaction done" : "Done") << ", in "
+       << std::fixed << setprecision(4) << elapsed.count() << " seconds.\n";
+  print_stat("Compaction");
+
+  // Cout encrypted content
+  encrypt();
+}
+
+/**
+ * @brief Pack. A chunk is of lines up to COL_BLOCK_SIZE bytes
+ * @param packFP    Packs a chunk of lines
+ * @param threadID  Thread ID
+ */
+void Table::pack (packTblFP_t packFP, byte threadID) {
+  ifstream       in(in_file);
+  string         context;
+  vector<string> lines;
+  ofstream pkfile(PK_FNAME+to_string(threadID), std::ios_base::app);
+
+  // Chunks ignored at the beginning
+  for (byte t = threadID; t--;)    skip_block(in);
+
+  for (u64 chunkNo = threadID; in.peek() != EOF; chunkNo += n_threads) {
+    budget.acquire(COL_BLOCK_SIZE * PK_MEM);
+    context.clear();
+    lines.clear();
+    u64 inBytes = 0;
+    for (string line; inBytes < COL_BLOCK_SIZE && getline(in, line);) {
+      inBytes += line.size() + !in.eof();
+      lines.emplace_back(std::move(line));
+    }
+    (this->*packFP)(context, lines);
+    end_chunk_stat(threadID, chunkNo, inBytes, context.size());
+
+    // Shuffle
+    if (!stop_shuffle) {
+      mutxTBL.lock();//---------------------------------------------------
+      if (verbose && shuffInProg)    cerr << "Shuffling...\n";
+      shuffInProg = false;
+      mutxTBL.unlock();//-------------------------------------------------
+
+      shuffle(context);
+    }
+
+    // For unshuffling: insert the size of packed context in the beginning
+    string contextSize;
+    contextSize += (char) 253;
+    contextSize += to_string(context.size());
+    contextSize += (char) 254;
+    context.insert(0, contextSize);
+
+    // Write header containing threadID for each partially packed file
+    pkfile << THR_ID_HDR << to_string(threadID) << '\n';
+    pkfile << context << '\n';
+    budget.release(COL_BLOCK_SIZE * PK_MEM);
+
+    // Ignore to go to the next related chunk
+    for (byte t = n_threads - 1; t--;)    skip_block(in);
+  }
+
+  pkfile.close();
+  in.close();
+}
+
+/**
+ * @brief  Read blocks of lines sampled across the file, to analyze it. The
+ *         blocks are of chunks, COL_BLOCK_SIZE bytes, as many as make
+ *         SMPL_N_BLOCK*SMPL_BLOCK_SIZE bytes, each starting at the beginning
+ *         of a line. A small file is read as a whole
+ * @param[out] smpl     Lines of the sampled blocks
+ * @param[out] scanSec  Seconds spent to read them
+ * @return Bytes sampled
+ */
+u64 Table::sample_lines (vector<vector<string>>& smpl, double& scanSec) const {
+  const auto start = high_resolution_clock::now();
+  ifstream in(in_file);
+  in.seekg(0, std::ios::end);
+  const auto fileSize = (u64) in.tellg();
+  const u64  smplSize = SMPL_N_BLOCK * SMPL_BLOCK_SIZE;
+  const u64  nBlock   = (fileSize > smplSize) ? smplSize / COL_BLOCK_SIZE : 1;
+  u64 smplBytes = 0;
+
+  smpl.assign(nBlock, vector<string>());
+  for (u64 b = 0; b != nBlock; ++b) {
+    in.clear();
+    in.seekg((std::streamoff) (b * (fileSize / nBlock)));
+    if (b)    IGNORE_THIS_LINE(in);            // Partial line
+
+    u64 bytes = 0;
+    for (string line; (nBlock == 1 || bytes < COL_BLOCK_SIZE) &&
+                      getline(in, line);) {
+      bytes += line.size() + !in.eof();
+      smpl[b].emplace_back(std::move(line));
+    }
+    smplBytes += bytes;
+  }
+  in.close();
+
+  std::chrono::duration<double> elapsed = high_resolution_clock::now() - start;
+  scanSec = elapsed.count();
+  return smplBytes;
+}
+
+/**
+ * @brief Analyze. Predict the compaction ratio and the time by packing the
+ *        sampled blocks in chunks, as pack() does. The streams have to be set
+ * @param format     Name of the format, e.g., "VCF"
+ * @param smpl       Lines of the sampled blocks
+ * @param smplBytes  Bytes sampled
+ * @param scanSec    Seconds spent to read the sample
+ * @param packFP     Packs a chunk of lines
+ * @param hdrBytes   Bytes of the header of the packed file
+ */
+void Table::analyze_table (const string& format,
+                           const vector<vector<string>>& smpl, u64 smplBytes,
+                           double scanSec, packTblFP_t packFP, u64 hdrBytes) {
+  stats = true;             // The estimates are made from the telemetry
+  ifstream in(in_file, std::ios::ate);
+  const auto fileSize = (u64) in.tellg();
+  in.close();
+
+  // Pack and shuffle the sample, chunk by chunk
+  const auto start = high_resolution_clock::now();
+  for (const auto& block : smpl)
+    for (auto line = block.begin(); line != block.end();) {
+      vector<string> lines;
+      u64 inBytes = 0;
+      for (; inBytes < COL_BLOCK_SIZE && line != block.end(); ++line) {
+        inBytes += line->size() + 1;
+        lines.push_back(*line);
+      }
+      string context;
+      (this->*packFP)(context, lines);
+      if (!stop_shuffle)    shuffle(context);
+      end_chunk_stat(0, KStat.nChunk, inBytes, context.size());
+    }
+  std::chrono::duration<double> packSec = high_resolution_clock::now() - start;
+
+  cerr << "Analysis of \"" << in_file << "\" (" << format << "):\n";
+  print_stat("Sample");
+  print_estimate(fileSize, smplBytes, hdrBytes, scanSec, packSec.count(),
+                 true);
+}
+
+/**
+ * @brief  Split a line by tabs, reusing the strings of the columns
+ * @param  cols  Columns of the chunk. The columns of the line go to col
+ * @param  line  Line
+ * @return Number of columns
+ */
+u64 Table::split_line (tblcols_s& cols, const string& line) const {
+  u64 nCol = 0;
+  for (auto b = line.begin();; ++nCol) {
+    const auto e = std::find(b, line.end(), '\t');
+    if (nCol == cols.col.size())    cols.col.emplace_back();
+    cols.col[nCol].assign(b, e);
+    if (e == line.end())    break;
+    b = e + 1;
+  }
+  return nCol + 1;
+}
+
+/**
+ * @brief Add a line to the layout, e.g., "0x40" then "10x9000"
+ * @param cols  Columns of the chunk
+ * @param nCol  Number of columns of the line. 0, if it is not a record
+ */
+void Table::add_layout (tblcols_s& cols, u64 nCol) const {
+  if (cols.colRun && nCol == cols.nCol)    ++cols.colRun;
+  else {
+    if (cols.colRun)
+      cols.strm[TBL_LAYOUT] += to_string(cols.nCol) + 'x' +
+                               to_string(cols.colRun) + '\n';
+    cols.nCol   = nCol;
+    cols.colRun = 1;
+  }
+}
+
+/**
+ * @brief Add a line which is not a record, as it is
+ * @param cols  Columns of the chunk
+ * @param line  Line
+ */
+void Table::add_raw (tblcols_s& cols, const string& line) const {
+  cols.strm[TBL_RAW] += line;
+  cols.strm[TBL_RAW] += '\n';
+  add_layout(cols, 0);
+}
+
+/**
+ * @brief Add a name, e.g., chromosome, as runs, and a position, as delta in
+ *        the run
+ * @param cols     Columns of the chunk
+ * @param nameStr  Stream of names
+ * @param posStr   Stream of positions
+ * @param name     Name
+ * @param pos      Position
+ */
+void Table::add_name_pos (tblcols_s& cols, byte nameStr, byte posStr,
+                          const string& name, u64 pos) const {
+  if (cols.nameRun && name == cols.name)    ++cols.nameRun;
+  else {
+    if (cols.nameRun)
+      cols.strm[nameStr] += cols.name + '\t' + to_string(cols.nameRun) + '\n';
+    cols.name    = name;
+    cols.nameRun = 1;
+    cols.pos     = 0;
+  }
+  cols.strm[posStr] += to_string((i64) (pos - cols.pos));
+  cols.strm[posStr] += '\n';
+  cols.pos = pos;
+}
+
+/**
+ * @brief  Index of an entry in the dictionary of the chunk. New entries are
+ *         added to it
+ * @param  cols   Columns of the chunk
+ * @param  entry  Entry, e.g., keys of INFO
+ * @return Index
+ */
+u64 Table::add_dict (tblcols_s& cols, const string& entry) const {
+  const auto found = cols.dict.find(entry);
+  if (found != cols.dict.end())    return found->second;
+  const u64 idx = cols.dict.size();
+  cols.dict.emplace(entry, idx);
+  cols.strm[TBL_DICT] += entry;
+  cols.strm[TBL_DICT] += '\n';
+  return idx;
+}
+
+/**
+ * @brief End the runs of lines and of names, if any
+ * @param cols     Columns of the chunk
+ * @param nameStr  Stream of names
+ */
+void Table::end_runs (tblcols_s& cols, byte nameStr) const {
+  if (cols.colRun) {
+    cols.strm[TBL_LAYOUT] += to_string(cols.nCol) + 'x' +
+                             to_string(cols.colRun) + '\n';
+    cols.colRun = 0;
+  }
+  if (cols.nameRun) {
+    cols.strm[nameStr] += cols.name + '\t' + to_string(cols.nameRun) + '\n';
+    cols.nameRun = 0;
+  }
+}
+
+/**
+ * @brief Encode the streams of a chunk
+ * @param[out] context  Packed chunk
+ * @param[in]  cols     Columns of the chunk
+ */
+void Table::encode_table (string& context, const tblcols_s& cols) {
+  for (size_t s = 0; s != strm.size(); ++s)
+    encode_stream(context, cols.strm[s], strm[s]);
+}
+
+/**
+ * @brief Decode the streams of a chunk, and its dictionary
+ * @param[out]    t     Streams of the chunk
+ * @param[in,out] i     Unshuffled chunk iterator
+ * @param[in]     nStr  Number of streams
+ */
+void Table::decode_table (tbltext_s& t, string::iterator& i, byte nStr) {
+  t.txt.resize(nStr);
+  for (byte s = 0; s != nStr; ++s)    decode_stream(t.txt[s], i, strm[s]);
+  index_table(t);
+}
+
+/**
+ * @brief Start the streams of a chunk, decoded, and read its dictionary
+ * @param t  Streams of the chunk
+ */
+void Table::index_table (tbltext_s& t) const {
+  t.c.clear();
+  for (const auto& txt : t.txt)    t.c.emplace_back(txt.cbegin());
+
+  const string& dict = t.txt[TBL_DICT];
+  for (auto d = dict.cbegin(); d != dict.cend(); ++d) {
+    const auto e = std::find(d, dict.cend(), '\n');
+    t.dict.emplace_back(d, e);
+    d = e;
+  }
+}
+
+/**
+ * @brief  A field of a stream. Then the stream goes on after it
+ * @param  t    Streams of the chunk
+ * @param  s    Stream
+ * @param  beg  Beginning of the field
+ * @return End of the field
+ */
+citer_t Table::next_field (tbltext_s& t, byte s, citer_t& beg) const {
+  beg = t.c[s];
+  const auto end = std::find(beg, t.txt[s].cend(), '\n');
+  assert(end == t.txt[s].cend(), WRONG_KEY);
+  t.c[s] = end + 1;
+  return end;
+}
+
+/**
+ * @brief Append a field of a stream
+ * @param out  Lines
+ * @param t    Streams of the chunk
+ * @param s    Stream
+ */
+void Table::put_field (string& out, tbltext_s& t, byte s) const {
+  citer_t beg;
+  const auto end = next_field(t, s, beg);
+  out.append(beg, end);
+}
+
+/**
+ * @brief Append a name and a position, as "name\tpos"
+ * @param out      Lines
+ * @param t        Streams of the chunk
+ * @param nameStr  Stream of names
+ * @param posStr   Stream of positions
+ */
+void Table::get_name_pos (string& out, tbltext_s& t, byte nameStr,
+                          byte posStr) const {
+  citer_t b;
+  if (!t.nameRun) {
+    const auto e   = next_field(t, nameStr, b);
+    const auto tab = std::find(b, e, '\t');
+    t.name.assign(b, tab);
+    t.nameRun = stoull(string(tab + 1, e));
+    t.pos = 0;
+  }
+  --t.nameRun;
+  const auto e = next_field(t, posStr, b);
+  t.pos += (u64) stoll(string(b, e));
+  out += t.name;
+  out += '\t';
+  out += to_string(t.pos);
+}
+
+/**
+ * @brief  Entry of the dictionary, by the index in a stream
+ * @param  t  Streams of the chunk
+ * @param  s  Stream
+ * @return Entry
+ */
+const string& Table::get_dict (tbltext_s& t, byte s) const {
+  citer_t b;
+  const auto e   = next_field(t, s, b);
+  const u64  idx = stoull(string(b, e));
+  assert(idx >= t.dict.size(), WRONG_KEY);
+  return t.dict[idx];
+}
+
+/**
+ * @brief Decompress, from the first chunk on. The streams have to be set
+ * @param in        Decrypted file
+ * @param unpackFP  Unpacks a chunk into lines
+ * @param start     Start time
+ */
+void Table::decompress_table (ifstream& in, unpackTblFP_t unpackFP,
+                              tpoint_t start) {
+  char        c;                  // Chars in file
+  unpacktbl_s upkStruct;          // Collection of inputs to pass to unpack...
+  thread      arrThread[n_threads];// Array of threads
+  assert(kmer_k || stats_archive || filtered(),
+         "Error: k-mers, statistics and filters are only for FASTA and "
+         "FASTQ.\n");
+  assert(Legacy, "Error: corrupted file.\n");          // Always versioned
+
+  // Distribute file among threads, for reading and unpacking
+  for (byte t=0; t != n_threads; ++t) {
+    in.get(c);
+    if (c == (char) 253) {
+      string chunkSizeStr;             // Chunk size (string) -- For unshuffling
+      while (in.get(c) && c != (char) 254)    chunkSizeStr += c;
+      const auto offset = stoull(chunkSizeStr); // To traverse decompressed file
+
+      upkStruct.begPos    = in.tellg();
+      upkStruct.chunkSize = offset;
+
+      arrThread[t] = thread(&Table::guard, this,
+                            [=] { unpack(unpackFP, upkStruct, t); });
+
+      // Jump to the beginning of the next chunk
+      in.seekg((std::streamoff) offset, std::ios_base::cur);
+    }
+    // End of file
+    if (in.peek() == 252)    break;
+  }
+  // Join threads
+  for (auto& thr : arrThread)
+    if (thr.joinable())    thr.join();
+  rethrow();
+
+  if (verbose)    cerr << "Unshuffling done!\n";
+
+  // Close/delete decrypted file
+  in.close();
+  const string decFileName = DEC_FNAME;
+  std::remove(decFileName.c_str());
+
+  // Join partially unpacked files
+  join_unpacked_files(cout);
+
+  const auto finish = high_resolution_clock::now();        // Stop timer
+  std::chrono::duration<double> elapsed = finish - start;  // Dur. (sec)
+
+  cerr << (verbose ? "Decompression done" : "Done") << ", in "
+       << std::fixed << setprecision(4) << elapsed.count() << " seconds.\n";
+  print_stat("Decompression");
+}
+
+/**
+ * @brief Unpack
+ * @param unpackFP   Unpacks a chunk into lines
+ * @param upkStruct  Unpack structure
+ * @param threadID   Thread ID
+ */
+void Table::unpack (unpackTblFP_t unpackFP, const unpacktbl_s& upkStruct,
+                    byte threadID) {
+  pos_t      begPos    = upkStruct.begPos;
+  u64        chunkSize = upkStruct.chunkSize;
+  ifstream   in(DEC_FNAME);
+  ofstream   upkfile(UPK_FNAME+to_string(threadID), std::ios_base::app);
+
+  for (u64 chunkNo = threadID; in.peek() != EOF; chunkNo += n_threads) {
+    char c;
+    const u64 memBytes = chunkSize * (shuffled ? UPK_MEM : 1);
+    budget.acquire(memBytes);
+    in.seekg(begPos);      // Read the file from this position
+    // Take a chunk of decrypted file
+    string decText(chunkSize, '\0');
+    in.read(&decText[0], (std::streamsize) chunkSize);
+    auto i = decText.begin();
+    chunkEnd = decText.end();
+    pos_t endPos = in.tellg();   // Set the end position
+
+    // Unshuffle
+    if (shuffled) {
+      mutxTBL.lock();//---------------------------------------------------
+      if (verbose && shuffInProg)    cerr << "Unshuffling...\n";
+      shuffInProg = false;
+      mutxTBL.unlock();//-------------------------------------------------
+
+      unshuffle(i, chunkSize);
+    }
+
+    string out;
+    (this->*unpackFP)(out, i);
+    in.seekg(endPos);
+    if (NoEol && in.peek() == 252 && !out.empty())  // Last line, with no LF
+      out.insert(out.end() - 1, LINE_OPEN);
+    upkfile << THR_ID_HDR + to_string(threadID) << '\n' << out;
+    end_chunk_stat(threadID, chunkNo, out.size(), chunkSize);
+    budget.release(memBytes);
+
+    // Update the chunk size and positions (beg & end)
+    for (byte t = n_threads; t--;) {
+      in.seekg(endPos);
+      in.get(c);
+      if (c == (char) 253) {
+        string chunkSizeStr;
+        while (in.get(c) && c != (char) 254)    chunkSizeStr += c;
+
+        chunkSize = stoull(chunkSizeStr);
+        begPos    = in.tellg();
+        endPos    = begPos + (pos_t) chunkSize;
+      }
+    }
+  }
+
+  upkfile.close();
+  in.close();
+}
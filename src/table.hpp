@@ -0,0 +1,104 @@
+/**
+ * @file      table.hpp
+ * @brief     Compression/Decompression of tab-separated text, by columns
+ * @author    Morteza Hosseini  (seyedmorteza@ua.pt)
+ * @author    Diogo Pratas      (pratas@ua.pt)
+ * @author    Armando J. Pinho  (ap@ua.pt)
+ * @copyright The GNU General Public License v3.0
+ */
+
+#ifndef CRYFA_TABLE_H
+#define CRYFA_TABLE_H
+
+#include <map>
+#include <chrono>
+#include <algorithm>
+#include <cctype>
+#include "endecrypto.hpp"
+
+constexpr byte TBL_LAYOUT = 0;   /**< @brief Runs of lines, by columns */
+constexpr byte TBL_RAW    = 1;   /**< @brief Lines not records, e.g., ## */
+constexpr byte TBL_DICT   = 2;   /**< @brief Dictionary of the chunk */
+
+class Table;
+
+// Type define
+typedef std::chrono::high_resolution_clock::time_point tpoint_t;
+typedef void (Table::*packTblFP_t) (string&, const vector<string>&);
+typedef void (Table::*unpackTblFP_t) (string&, string::iterator&);
+
+/** @brief Columns of a chunk, while they are gathered */
+struct tblcols_s {
+  vector<string> strm;            /**< @brief Streams */
+  std::map<string, u64> dict;     /**< @brief Entries of dictionary -> index */
+  vector<string> col;             /**< @brief Columns of a line */
+  string name;                    /**< @brief Name of the run, e.g., chrom */
+  u64    nameRun = 0;             /**< @brief Records in the name run */
+  u64    pos     = 0;             /**< @brief Position of the last record */
+  u64    nCol    = 0;             /**< @brief Columns of the layout run */
+  u64    colRun  = 0;             /**< @brief Lines in the layout run */
+};
+
+/** @brief Streams of a chunk, while they are read back */
+struct tbltext_s {
+  vector<string>  txt;            /**< @brief Streams */
+  vector<citer_t> c;              /**< @brief Position in each stream */
+  vector<string>  dict;           /**< @brief Dictionary of the chunk */
+  string name;                    /**< @brief Name of the run, e.g., chrom */
+  u64    nameRun = 0;             /**< @brief Records left in the name run */
+  u64    pos     = 0;             /**< @brief Position of the last record */
+};
+
+/** @brief Unpacking tables */
+struct unpacktbl_s {
+  pos_t begPos;       /**< @brief Begining position for each thread */
+  u64   chunkSize;    /**< @brief Chunk size */
+};
+
+/**
+ * @brief Compression/Decompression of tab-separated text, by columns. A
+ *        chunk is of lines up to COL_BLOCK_SIZE bytes. The records go to
+ *        streams by their columns, and the other lines as they are. A layout
+ *        has runs of lines with the same number of columns, 0 for the others
+ */
+class Table : public EnDecrypto
+{
+ protected:
+  vector<stream_s> strm;       /**< @brief Streams of a chunk */
+
+  auto compress_table (char, const string&, const string&, packTblFP_t,
+                       tpoint_t) -> void;
+  auto sample_lines (vector<vector<string>>&, double&) const -> u64;
+  auto analyze_table (const string&, const vector<vector<string>>&, u64,
+                      double, packTblFP_t, u64) -> void;
+  auto decompress_table (std::ifstream&, unpackTblFP_t, tpoint_t) -> void;
+  auto split_line (tblcols_s&, const string&) const -> u64;
+  auto add_layout (tblcols_s&, u64) const -> void;
+  auto add_raw (tblcols_s&, const string&) const -> void;
+  auto add_name_pos (tblcols_s&, byte, byte, const string&, u64) const ->void;
+  auto add_dict (tblcols_s&, const string&) const -> u64;
+  auto end_runs (tblcols_s&, byte) const -> void;
+  auto encode_table (string&, const tblcols_s&) -> void;
+  auto decode_table (tbltext_s&, string::iterator&, byte) -> void;
+  auto index_table (tbltext_s&) const -> void;
+  auto next_field (tbltext_s&, byte, citer_t&) const -> citer_t;
+  auto put_field (string&, tbltext_s&, byte) const -> void;
+  auto get_name_pos (string&, tbltext_s&, byte, byte) const -> void;
+  auto get_dict (tbltext_s&, byte) const -> const string&;
+
+ private:
+  auto pack (packTblFP_t, byte) -> void;
+  auto unpack (unpackTblFP_t, const unpacktbl_s&, byte) -> void;
+};
+
+/**
+ * @brief  If a number is as it is printed, so that it is given back the same
+ * @param  num  Number
+ * @return true, if so
+ */
+inline bool canonical_num (const string& num) {
+  return !num.empty() && num.size() <= 18 && (num.size()==1 || num[0]!='0') &&
+         std::all_of(num.begin(), num.end(), [] (char c) { return isdigit(c);});
+}
+
+#endif //CRYFA_TABLE_H
@@ -0,0 +1,313 @@
+/**
+ * @file      tsv.cpp
+ * @brief     Compression/Decompression of tabular text, e.g., BED/GFF/GTF
+ * @author    Morteza Hosseini  (seyedmorteza@ua.pt)
+ * @author    Diogo Pratas      (pratas@ua.pt)
+ * @author    Armando J. Pinho  (ap@ua.pt)
+ * @copyright The GNU General Public License v3.0
+ */
+
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <set>
+#include <sstream>
+#include "tsv.hpp"
+#include "assert.hpp"
+using std::chrono::high_resolution_clock;
+using std::cerr;
+using std::ifstream;
+using std::to_string;
+
+namespace {
+/** @brief Signed to unsigned, small magnitudes to small numbers */
+inline u64 zig (i64 n) { return ((u64) n << 1) ^ (u64) (n >> 63); }
+
+/** @brief Unsigned to signed, back from zig() */
+inline i64 unzig (u64 n) { return (i64) (n >> 1) ^ -(i64) (n & 1); }
+
+/** @brief Bytes of a number, written by put_varint */
+inline u64 varint_len (u64 n) {
+  u64 len = 1;
+  for (; n >= 0x80; n >>= 7)    ++len;
+  return len;
+}
+}
+
+/**
+ * @brief Compress
+ */
+void Tsv::compress () {
+  const auto start = high_resolution_clock::now();                // Start timer
+  string     headers;
+
+  if (verbose)    cerr << "Calculating number of different characters...\n";
+  ifstream in(in_file);
+  gather_h(in, headers);
+  in.close();
+  if (verbose)    cerr << "In text, they are " << headers.length() << ".\n";
+
+  set_pack(headers);
+  compress_table('T', headers, "",
+                 static_cast<packTblFP_t>(&Tsv::pack_chunk), start);
+}
+
+/**
+ * @brief Analyze. Predict the compaction ratio and the time by packing
+ *        blocks sampled across the file, with the chars of the sample
+ */
+void Tsv::analyze () {
+  vector<vector<string>> smpl;
+  double    scanSec;
+  const u64 smplBytes = sample_lines(smpl, scanSec);
+  string    text, headers;
+  for (const auto& block : smpl)
+    for (const auto& line : block) { text += line;    text += '\n'; }
+  std::istringstream iss(text);
+  gather_h(iss, headers);
+
+  set_pack(headers);
+  // File type, shuffle flag, version, headers, (char) 254
+  analyze_table("BED/GFF/GTF", smpl, smplBytes, scanSec,
+                static_cast<packTblFP_t>(&Tsv::pack_chunk),
+                headers.size() + 5);
+}
+
+/**
+ * @brief Gather the chars of the records, for the columns of text
+ * @param[in]  in       Lines
+ * @param[out] headers  Chars
+ */
+void Tsv::gather_h (std::istream& in, string& headers) {
+  bool hChars[256];
+  memset(hChars, false, 256);
+
+  tblcols_s cols;
+  for (string line; getline(in, line);) {
+    if (!is_record(line, split_line(cols, line)))    continue;
+    for (char c : line)    hChars[(byte) c] = true;
+  }
+
+  for (byte i = 32; i != 127; ++i)    if (*(hChars+i))  headers += i;
+}
+
+/**
+ * @brief Streams of a chunk. The runs of lines are a layout, and the others
+ *        columns. A column of text is headers, in the chunk
+ */
+void Tsv::set_streams () {
+  strm.assign(N_TSV_STRM, stream_s());
+  for (auto& st : strm)    st.kind = STRM_COL;
+  strm[TBL_LAYOUT].kind = STRM_LAYOUT;
+}
+
+/**
+ * @brief Set the streams, and the packers of the columns of text, by the
+ *        category of the chars
+ * @param headers  Chars of the records
+ */
+void Tsv::set_pack (const string& headers) {
+  set_streams();
+  const packFP_t packFP = cat_pack_fn(headers, Hdrs, HdrMap,
+                                      &EnDecrypto::pack_hL_fa_fq);
+  for (byte c = 0; c != TSV_MAX_COL; ++c) {
+    strm[TSV_COL + c].packFP = packFP;
+    strm[TSV_COL + c].map    = &HdrMap;
+  }
+  HdrCat = category(headers.length());
+}
+
+/**
+ * @brief  If a line is a record: not a comment, with 2 to TSV_MAX_COL
+ *         columns of printable chars
+ * @param  line  Line
+ * @param  nCol  Number of columns of the line
+ * @return true, if so
+ */
+bool Tsv::is_record (const string& line, u64 nCol) const {
+  return line[0] != '#' && nCol >= 2 && nCol <= TSV_MAX_COL &&
+         std::all_of(line.begin(), line.end(),
+                     [] (char c) { return c == '\t' || (c >= 32 && c < 127); });
+}
+
+/**
+ * @brief Pack a chunk: a record by its columns, or any other line as it is.
+ *        The type of each column is inferred from its values in the chunk
+ * @param[out] context  Packed chunk
+ * @param[in]  lines    Lines
+ */
+void Tsv::pack_chunk (string& context, const vector<string>& lines) {
+  tblcols_s cols;
+  cols.strm.resize(N_TSV_STRM);
+  vector<vector<string>> rows;
+  u64 maxCol = 0;
+  for (const auto& line : lines) {
+    const u64 nCol = split_line(cols, line);
+    if (is_record(line, nCol)) {
+      rows.emplace_back(cols.col.begin(), cols.col.begin() + (i64) nCol);
+      add_layout(cols, nCol);
+      maxCol = std::max(maxCol, nCol);
+    }
+    else    add_raw(cols, line);
+  }
+  end_runs(cols, TBL_RAW);                              // No runs of names
+
+  string& types = cols.strm[TSV_TYPE];
+  for (u64 c = 0; c != maxCol; ++c)    types += col_type(rows, c, types);
+
+  vector<u64> prev(maxCol, 0);
+  for (const auto& r : rows) {
+    for (u64 c = 0; c != r.size(); ++c) {
+      string& s = cols.strm[TSV_COL + c];
+      switch (types[c]) {
+        case COL_ROW: {
+          const u64 v = stoull(r[c]);
+          put_varint(s, zig((i64) (v - prev[c])));
+          prev[c] = v;
+          break;
+        }
+        case COL_LEFT:
+          put_varint(s, zig((i64) (stoull(r[c]) - stoull(r[c-1]))));   break;
+        case COL_DICT:
+          put_varint(s, add_dict(cols, r[c]));                         break;
+        default:
+          s += r[c];
+          s += '\n';
+      }
+    }
+  }
+
+  // The columns of text go through the header packers
+  vector<stream_s> st(strm);
+  for (u64 c = 0; c != maxCol; ++c)
+    if (types[c] == COL_TEXT)    st[TSV_COL + c].kind = STRM_HDR;
+  for (byte s = 0; s != N_TSV_STRM; ++s)
+    encode_stream(context, cols.strm[s], st[s]);
+}
+
+/**
+ * @brief  Type of a column in a chunk. Numbers as deltas, to the row up or
+ *         to the column on the left, whichever is smaller. Few strings by
+ *         the dictionary. Any other text by the header packers
+ * @param  rows   Records of the chunk, by columns
+ * @param  c      Column
+ * @param  types  Types of the columns on the left
+ * @return Type
+ */
+char Tsv::col_type (const vector<vector<string>>& rows, u64 c,
+                    const string& types) const {
+  bool num = true,  few = true;
+  std::set<string> seen;
+  for (const auto& r : rows) {
+    if (r.size() <= c)    continue;
+    if (num && !canonical_num(r[c]))    num = false;
+    if (few && seen.insert(r[c]).second && seen.size() > TSV_DICT_MAX)
+      few = false;
+    if (!num && !few)    break;
+  }
+  if (!num)    return few ? COL_DICT : COL_TEXT;
+
+  const bool left = c && (types[c-1] == COL_ROW || types[c-1] == COL_LEFT);
+  u64 rowBytes = 0,  leftBytes = 0,  prev = 0;
+  for (const auto& r : rows) {
+    if (r.size() <= c)    continue;
+    const u64 v = stoull(r[c]);
+    rowBytes += varint_len(zig((i64) (v - prev)));
+    prev = v;
+    if (left)    leftBytes += varint_len(zig((i64) (v - stoull(r[c-1]))));
+  }
+  return (left && leftBytes < rowBytes) ? COL_LEFT : COL_ROW;
+}
+
+/**
+ * @brief Decompress
+ */
+void Tsv::decompress () {
+  const auto start = high_resolution_clock::now();          // Start timer
+  budget.set_cap(max_memory);
+  char     c;                     // Chars in file
+  string   headers;
+  ifstream in(DEC_FNAME);
+
+  in.ignore(1);                   // Jump over decText[0]==(char) 122
+  in.get(c);    shuffled = (c==(char) 128); // Check if file had been shuffled
+  read_version(in);
+  read_no_eol(in);
+  while (in.get(c) && c != (char) 254)    headers += c;
+
+  if (verbose)
+    cerr << headers.length() << " different characters are included in text.\n";
+
+  set_streams();
+  char XChar = 0;
+  const unpackFP_t unpackFP = cat_unpack_fn(headers, hdrUnpack, XChar);
+  for (byte col = 0; col != TSV_MAX_COL; ++col) {
+    strm[TSV_COL + col].unpackFP = unpackFP;
+    strm[TSV_COL + col].unpack   = &hdrUnpack;
+    strm[TSV_COL + col].XChar    = XChar;
+  }
+  HdrCat = category(headers.length());
+
+  decompress_table(in, static_cast<unpackTblFP_t>(&Tsv::unpack_chunk), start);
+}
+
+/**
+ * @brief Unpack a chunk into lines, from the columns in the streams
+ * @param[out]    out  Lines
+ * @param[in,out] i    Unshuffled chunk iterator
+ */
+void Tsv::unpack_chunk (string& out, string::iterator& i) {
+  tbltext_s t;
+  t.txt.resize(N_TSV_STRM);
+  for (byte s = 0; s != TSV_COL; ++s)    decode_stream(t.txt[s], i, strm[s]);
+  const string types = t.txt[TSV_TYPE];
+  for (byte c = 0; c != TSV_MAX_COL; ++c) {
+    stream_s st = strm[TSV_COL + c];
+    if (c < types.size() && types[c] == COL_TEXT)    st.kind = STRM_HDR;
+    decode_stream(t.txt[TSV_COL + c], i, st);
+  }
+  index_table(t);
+
+  out.clear();
+  vector<u64> prev(types.size(), 0),  cur(types.size(), 0);
+  while (t.c[TBL_LAYOUT] != t.txt[TBL_LAYOUT].cend()) {
+    citer_t b;
+    const auto e    = next_field(t, TBL_LAYOUT, b);
+    const auto x    = std::find(b, e, 'x');
+    const u64  nCol = stoull(string(b, x));
+    assert(x == e || nCol > types.size() || nCol > TSV_MAX_COL, WRONG_KEY);
+    for (u64 n = stoull(string(x + 1, e)); n--;) {
+      if (!nCol) {                                          // As it is
+        put_field(out, t, TBL_RAW);
+        out += '\n';
+        continue;
+      }
+
+      for (u64 c = 0; c != nCol; ++c) {
+        const byte s   = (byte) (TSV_COL + c);
+        const auto end = t.txt[s].cend();
+        if (c)    out += '\t';
+        switch (types[c]) {
+          case COL_ROW:
+            cur[c] = prev[c] += (u64) unzig(get_varint(t.c[s], end));
+            out += to_string(cur[c]);
+            break;
+          case COL_LEFT:
+            assert(c == 0, WRONG_KEY);
+            cur[c] = cur[c-1] + (u64) unzig(get_varint(t.c[s], end));
+            out += to_string(cur[c]);
+            break;
+          case COL_DICT: {
+            const u64 idx = get_varint(t.c[s], end);
+            assert(idx >= t.dict.size(), WRONG_KEY);
+            out += t.dict[idx];
+            break;
+          }
+          default:
+            put_field(out, t, s);
+        }
+      }
+      out += '\n';
+    }
+  }
+}
@@ -0,0 +1,53 @@
+/**
+ * @file      tsv.hpp
+ * @brief     Compression/Decompression of tabular text, e.g., BED/GFF/GTF
+ * @author    Morteza Hosseini  (seyedmorteza@ua.pt)
+ * @author    Diogo Pratas      (pratas@ua.pt)
+ * @author    Armando J. Pinho  (ap@ua.pt)
+ * @copyright The GNU General Public License v3.0
+ */
+
+#ifndef CRYFA_TSV_H
+#define CRYFA_TSV_H
+
+#include "table.hpp"
+
+constexpr byte TSV_TYPE     = 3;    /**< @brief Types of the columns */
+constexpr byte TSV_COL      = 4;    /**< @brief Stream of the first column */
+constexpr byte TSV_MAX_COL  = 24;   /**< @brief Columns of a record, max */
+constexpr byte N_TSV_STRM   = TSV_COL + TSV_MAX_COL; /**< @brief Streams */
+constexpr u64  TSV_DICT_MAX = 255;  /**< @brief Entries of a column, max, to
+                                                be by the dictionary */
+constexpr char COL_ROW      = 'r';  /**< @brief Numbers, delta to the row up*/
+constexpr char COL_LEFT     = 'c';  /**< @brief Numbers, delta to the left */
+constexpr char COL_DICT     = 'd';  /**< @brief By the dictionary */
+constexpr char COL_TEXT     = 't';  /**< @brief Text, by the header packers */
+
+/**
+ * @brief Compression/Decompression of tabular text, e.g., BED/GFF/GTF. The
+ *        type of each column is inferred in each chunk: numbers as deltas,
+ *        to the row up or to the column on the left, e.g., end to start,
+ *        few strings by a dictionary, and any other text by the header
+ *        packers, by the category of the chars of the file
+ */
+class Tsv : public Table
+{
+ public:
+  auto compress () -> void;
+  auto decompress () -> void;
+  auto analyze () -> void;
+
+ private:
+  vector<string> hdrUnpack;  /**< @brief Lookup table for unpacking text */
+
+  auto gather_h (std::istream&, string&) -> void;
+  auto set_streams () -> void;
+  auto set_pack (const string&) -> void;
+  auto is_record (const string&, u64) const -> bool;
+  auto pack_chunk (string&, const vector<string>&) -> void;
+  auto col_type (const vector<vector<string>>&, u64, const string&) const
+    -> char;
+  auto unpack_chunk (string&, string::iterator&) -> void;
+};
+
+#endif //CRYFA_TSV_H
@@ -0,0 +1,255 @@
+/**
+ * @file      vcf.cpp
+ * @brief     Compression/Decompression of VCF
+ * @author    Morteza Hosseini  (seyedmorteza@ua.pt)
+ * @author    Diogo Pratas      (pratas@ua.pt)
+ * @author    Armando J. Pinho  (ap@ua.pt)
+ * @copyright The GNU General Public License v3.0
+ */
+
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include "vcf.hpp"
+using std::chrono::high_resolution_clock;
+using std::ifstream;
+using std::to_string;
+
+namespace {
+/** @brief Genotypes with a code of 4 bits, which is the index */
+const char* const GT_CODE[GT_ESC] = {
+  "0/0", "0/1", "1/1", "./.", "0|0", "0|1", "1|0", "1|1", "0", "1", ".",
+  "1/0", ".|.", "0/2", "1/2"
+};
+
+/**
+ * @brief  Code of a genotype
+ * @param  gt   Genotype
+ * @param  len  Length
+ * @return Code, or GT_ESC, if it has none
+ */
+byte gt_code (const char* gt, size_t len) {
+  if (len > 3)    return GT_ESC;
+  for (byte c = 0; c != GT_ESC; ++c)
+    if (strlen(GT_CODE[c]) == len && !memcmp(GT_CODE[c], gt, len))  return c;
+  return GT_ESC;
+}
+}
+
+/**
+ * @brief Compress
+ */
+void Vcf::compress () {
+  const auto start = high_resolution_clock::now();                // Start timer
+  set_streams();
+  compress_table('V', "", "", static_cast<packTblFP_t>(&Vcf::pack_chunk),
+                 start);
+}
+
+/**
+ * @brief Analyze. Predict the compaction ratio and the time by packing
+ *        blocks sampled across the file
+ */
+void Vcf::analyze () {
+  vector<vector<string>> smpl;
+  double    scanSec;
+  const u64 smplBytes = sample_lines(smpl, scanSec);
+  set_streams();
+  // File type, shuffle flag, version, (char) 254
+  analyze_table("VCF", smpl, smplBytes, scanSec,
+                static_cast<packTblFP_t>(&Vcf::pack_chunk), 5);
+}
+
+/**
+ * @brief Streams of a chunk. The alleles are sequences, the runs of lines
+ *        a layout, and the others columns
+ */
+void Vcf::set_streams () {
+  strm.assign(N_VCF_STRM, stream_s());
+  for (auto& st : strm)    st.kind = STRM_COL;
+  strm[TBL_LAYOUT].kind = STRM_LAYOUT;
+  strm[VCF_REF].kind    = STRM_SEQ;
+  strm[VCF_ALT].kind    = STRM_SEQ;
+}
+
+/**
+ * @brief Pack a chunk: a record by its columns, or any other line as it is
+ * @param[out] context  Packed chunk
+ * @param[in]  lines    Lines
+ */
+void Vcf::pack_chunk (string& context, const vector<string>& lines) {
+  tblcols_s cols;
+  cols.strm.resize(N_VCF_STRM);
+  for (const auto& line : lines) {
+    const u64 nCol = split_line(cols, line);
+    if (line[0] != '#' && nCol >= VCF_MIN_COL && canonical_num(cols.col[1])) {
+      add_record(cols, nCol);
+      add_layout(cols, nCol);
+    }
+    else    add_raw(cols, line);
+  }
+  end_runs(cols, VCF_CHROM);
+  encode_table(context, cols);
+}
+
+/**
+ * @brief Add the columns of a record to the streams
+ * @param cols  Columns of the chunk. The columns of the line are in col
+ * @param nCol  Number of columns of the line
+ */
+void Vcf::add_record (tblcols_s& cols, u64 nCol) const {
+  const auto& col = cols.col;
+  auto&       s   = cols.strm;
+
+  add_name_pos(cols, VCF_CHROM, VCF_POS, col[0], stoull(col[1]));
+
+  for (byte c = 2; c != 7; ++c) {               // ID, REF, ALT, QUAL, FILTER
+    s[VCF_ID + c - 2] += col[c];
+    s[VCF_ID + c - 2] += '\n';
+  }
+
+  // INFO: the keys, e.g., "DP=;AF=;DB", by index, and the values
+  string keys, vals;
+  const string& info = col[7];
+  u64 nVal = 0;
+  for (auto b = info.begin();;) {
+    const auto e  = std::find(b, info.end(), ';');
+    const auto eq = std::find(b, e, '=');
+    keys.append(b, eq == e ? e : eq + 1);
+    if (eq != e) {
+      if (nVal++)    vals += ';';
+      vals.append(eq + 1, e);
+    }
+    if (e == info.end())    break;
+    keys += ';';
+    b = e + 1;
+  }
+  s[VCF_INFO_KEY] += to_string(add_dict(cols, keys));    s[VCF_INFO_KEY] += '\n';
+  s[VCF_INFO_VAL] += vals;                               s[VCF_INFO_VAL] += '\n';
+  if (nCol == VCF_MIN_COL)    return;
+
+  // FORMAT, by index. Genotypes in 4 bits, 2 samples in a byte, if FORMAT
+  // starts with GT. The rest of the samples, as they are
+  s[VCF_FORMAT] += to_string(add_dict(cols, col[8]));    s[VCF_FORMAT] += '\n';
+  if (nCol == VCF_MIN_COL + 1)    return;
+  const bool gt = (col[8] == "GT" || col[8].compare(0, 3, "GT:") == 0);
+  byte pair = 0;
+  for (u64 c = VCF_MIN_COL + 1; c != nCol; ++c) {
+    const string& smp = col[c];
+    if (c != VCF_MIN_COL + 1)    s[VCF_SAMPLE] += '\t';
+    if (!gt) {
+      s[VCF_SAMPLE] += smp;
+      continue;
+    }
+    const size_t gtLen = std::min(smp.find(':'), smp.size());
+    const byte   code  = gt_code(smp.data(), gtLen);
+    if (code == GT_ESC) {
+      s[VCF_GT_X].append(smp, 0, gtLen);
+      s[VCF_GT_X] += '\n';
+    }
+    if ((c - VCF_MIN_COL - 1) % 2 == 0)    pair = (byte) (code << 4);
+    else                                   s[VCF_GT] += (char) (pair | code);
+    s[VCF_SAMPLE].append(smp, gtLen, string::npos);
+  }
+  if (gt && (nCol - VCF_MIN_COL - 1) % 2)    s[VCF_GT] += (char) pair;
+  s[VCF_SAMPLE] += '\n';
+}
+
+/**
+ * @brief Decompress
+ */
+void Vcf::decompress () {
+  const auto start = high_resolution_clock::now();          // Start timer
+  budget.set_cap(max_memory);
+  char     c;                     // Chars in file
+  ifstream in(DEC_FNAME);
+
+  in.ignore(1);                   // Jump over decText[0]==(char) 124
+  in.get(c);    shuffled = (c==(char) 128); // Check if file had been shuffled
+  read_version(in);
+  read_no_eol(in);
+  in.ignore(1);                   // (char) 254. No alphabet
+
+  set_streams();
+  decompress_table(in, static_cast<unpackTblFP_t>(&Vcf::unpack_chunk), start);
+}
+
+/**
+ * @brief Unpack a chunk into lines, from the columns in the streams
+ * @param[out]    out  Lines
+ * @param[in,out] i    Unshuffled chunk iterator
+ */
+void Vcf::unpack_chunk (string& out, string::iterator& i) {
+  tbltext_s t;
+  decode_table(t, i, N_VCF_STRM);
+
+  out.clear();
+  while (t.c[TBL_LAYOUT] != t.txt[TBL_LAYOUT].cend()) {
+    citer_t b;
+    auto e = next_field(t, TBL_LAYOUT, b);
+    const auto x    = std::find(b, e, 'x');
+    const u64  nCol = stoull(string(b, x));
+    for (u64 n = stoull(string(x + 1, e)); n--;) {
+      if (!nCol) {                                          // As it is
+        put_field(out, t, TBL_RAW);
+        out += '\n';
+        continue;
+      }
+
+      get_name_pos(out, t, VCF_CHROM, VCF_POS);
+      for (byte s = VCF_ID; s != VCF_FILTER + 1; ++s) {
+        out += '\t';
+        put_field(out, t, s);
+      }
+      out += '\t';
+
+      // INFO: a value after each key which ends with '='
+      const string& keys = get_dict(t, VCF_INFO_KEY);
+      citer_t v;
+      const auto vEnd = next_field(t, VCF_INFO_VAL, v);
+      for (auto k = keys.cbegin();;) {
+        const auto kEnd = std::find(k, keys.cend(), ';');
+        out.append(k, kEnd);
+        if (kEnd != k && *(kEnd - 1) == '=') {
+          const auto val = std::find(v, vEnd, ';');
+          out.append(v, val);
+          v = val + (val != vEnd);
+        }
+        if (kEnd == keys.cend())    break;
+        out += ';';
+        k = kEnd + 1;
+      }
+      if (nCol == VCF_MIN_COL) {
+        out += '\n';
+        continue;
+      }
+
+      // FORMAT, then the samples
+      const string& fmt = get_dict(t, VCF_FORMAT);
+      out += '\t';
+      out += fmt;
+      if (nCol == VCF_MIN_COL + 1) {
+        out += '\n';
+        continue;
+      }
+      const bool gt   = (fmt == "GT" || fmt.compare(0, 3, "GT:") == 0);
+      const u64  nSmp = nCol - VCF_MIN_COL - 1;
+      citer_t    g    = t.c[VCF_GT];
+      if (gt)    t.c[VCF_GT] += (i64) (nSmp + 1) / 2;
+      citer_t smp;
+      const auto smpEnd = next_field(t, VCF_SAMPLE, smp);
+      for (u64 k = 0; k != nSmp; ++k) {
+        out += '\t';
+        if (gt) {
+          const byte code = (k % 2) ? (byte) *g++ & 15 : (byte) *g >> 4;
+          if (code == GT_ESC)    put_field(out, t, VCF_GT_X);
+          else                   out += GT_CODE[code];
+        }
+        const auto tab = std::find(smp, smpEnd, '\t');
+        out.append(smp, tab);
+        smp = tab + (tab != smpEnd);
+      }
+      out += '\n';
+    }
+  }
+}
@@ -0,0 +1,52 @@
+/**
+ * @file      vcf.hpp
+ * @brief     Compression/Decompression of VCF
+ * @author    Morteza Hosseini  (seyedmorteza@ua.pt)
+ * @author    Diogo Pratas      (pratas@ua.pt)
+ * @author    Armando J. Pinho  (ap@ua.pt)
+ * @copyright The GNU General Public License v3.0
+ */
+
+#ifndef CRYFA_VCF_H
+#define CRYFA_VCF_H
+
+#include "table.hpp"
+
+constexpr byte VCF_CHROM    = 3;   /**< @brief Runs of chromosomes */
+constexpr byte VCF_POS      = 4;   /**< @brief Deltas of positions */
+constexpr byte VCF_ID       = 5;   /**< @brief IDs */
+constexpr byte VCF_REF      = 6;   /**< @brief Reference alleles */
+constexpr byte VCF_ALT      = 7;   /**< @brief Alternate alleles */
+constexpr byte VCF_QUAL     = 8;   /**< @brief Qualities */
+constexpr byte VCF_FILTER   = 9;   /**< @brief Filters */
+constexpr byte VCF_INFO_KEY = 10;  /**< @brief Index of the keys of INFO */
+constexpr byte VCF_INFO_VAL = 11;  /**< @brief Values of INFO */
+constexpr byte VCF_FORMAT   = 12;  /**< @brief Index of FORMAT */
+constexpr byte VCF_GT       = 13;  /**< @brief Genotypes, 4 bits each */
+constexpr byte VCF_GT_X     = 14;  /**< @brief Genotypes with no code */
+constexpr byte VCF_SAMPLE   = 15;  /**< @brief Samples, after genotypes */
+constexpr byte N_VCF_STRM   = 16;  /**< @brief Streams in a chunk of VCF */
+constexpr byte VCF_MIN_COL  = 8;   /**< @brief Columns of a record, min */
+constexpr byte GT_ESC       = 15;  /**< @brief Code of a genotype with none */
+
+/**
+ * @brief Compression/Decompression of VCF. The columns of the records of a
+ *        chunk go to their own streams: the chromosomes as runs, the
+ *        positions as deltas, the alleles as sequences, the keys of INFO
+ *        and FORMAT by a dictionary, and the genotypes in 4 bits
+ */
+class Vcf : public Table
+{
+ public:
+  auto compress () -> void;
+  auto decompress () -> void;
+  auto analyze () -> void;
+
+ private:
+  auto set_streams () -> void;
+  auto pack_chunk (string&, const vector<string>&) -> void;
+  auto add_record (tblcols_s&, u64) const -> void;
+  auto unpack_chunk (string&, string::iterator&) -> void;
+};
+
+#endif //CRYFA_VCF_H
@@ -0,0 +1,560 @@
+#!/bin/bash
+          #######################################################
+          #        Round trips of Cryfa over small files        #
+          #       - - - - - - - - - - - - - - - - - - - -       #
+          #        Morteza Hosseini    seyedmorteza@ua.pt       #
+          #        Diogo Pratas        pratas@ua.pt             #
+          #        Armando J. Pinho    ap@ua.pt                 #
+          #######################################################
+# usage: roundtrip.sh CRYFA
+# Packs and unpacks the files of data/ and the files generated here, with
+# the options of each test, and checks that they are given back exactly.
+# The codecs used, printed by --trace, have to cover the registry.
+
+CRYFA=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+DATA=$ROOT/test/data
+KEY=$ROOT/pass.txt
+TIMEOUT=60                  # Seconds, for a pack or an unpack
+CODECS="pack 2bit rans deflate pack+deflate cm ref rle packlen packfix"
+
+WORK=$(mktemp -d)
+trap 'rm -fr $WORK' EXIT
+cd $WORK                    # Cryfa makes its temporary files here
+nFail=0
+
+### Generate a file: fq_fix, fq_var, fq_run, fq_amp, fq_il, fa_ml, fa_long,
+### fa_mix or fa_ref. Random, but the same on each run
+function gen
+{
+    awk -v kind=$1 -v part=$2 '
+    # Park-Miller, exact in the doubles of awk
+    function rnd(n) { s = s * 16807 % 2147483647;  return int(s/2147483647*n) }
+    function seq(len,    r) {
+      r = "";  while (length(r) < len)  r = r substr("ACGT", rnd(4)+1, 1)
+      return r
+    }
+    function qs(len,    r) {
+      r = "";  while (length(r) < len)  r = r substr("#+5?FIJ", rnd(7)+1, 1)
+      return r
+    }
+    function runs(len,    r) {                    # As of PacBio HiFi
+      r = "";  while (length(r) < len)  r = r sprintf("%*s", 20+rnd(200), "")
+      gsub(/ /, substr("#5I", rnd(3)+1, 1), r)
+      return substr(r, 1, len)
+    }
+    function mutate(sq,    i) {                   # With SNPs
+      for (i = 1 + rnd(100); i < length(sq); i += 1 + rnd(200))
+        sq = substr(sq, 1, i-1) substr("ACGT", rnd(4)+1, 1) substr(sq, i+1)
+      return sq
+    }
+    function read(name, sq) {
+      print "@" name;  print sq;  print "+"
+      print kind == "fq_run" ? runs(length(sq)) : qs(length(sq))
+    }
+    BEGIN {
+      s = 12345
+      if (kind == "fq_fix")
+        for (n = 0; n != 3000; ++n)  read("SRR001." n " " n "/1", seq(100))
+      else if (kind == "fq_var" || kind == "fq_run")
+        for (n = 0; n != 3000; ++n)  read("SRR002." n, seq(50 + rnd(101)))
+      else if (kind == "fq_amp") {                # Few amplicons
+        for (a = 0; a != 20; ++a)    amp[a] = seq(150)
+        for (n = 0; n != 3000; ++n)  read("amp." n, amp[rnd(20)])
+      }
+      else if (kind == "fq_il")                   # Interleaved mates
+        for (n = 0; n != 1500; ++n) {
+          read("SRR003." n "/1", seq(100))
+          read("SRR003." n "/2", seq(100))
+        }
+      else if (kind == "fa_ml") {                 # Copies of a genome
+        genome = seq(20000)
+        for (n = 0; n != 20; ++n) {
+          print ">chr" n " some description " n
+          sq = mutate(substr(genome, 1 + rnd(10000), 1000 + rnd(10000)))
+          for (l = 0; l < length(sq); l += 60) {
+            line = substr(sq, l+1, 60)
+            if (!rnd(50))  line = substr(line, 1, 10) "NRY" substr(line, 14)
+            print line
+          }
+        }
+      }
+      else if (kind == "fa_long")                 # Lines longer than chunks
+        for (n = 0; n != 6; ++n) {
+          print ">long" n;  print seq(n % 2 ? 100 : 20000 + rnd(30000))
+        }
+      else if (kind == "fa_mix")                  # Wrapped, and a line not
+        for (n = 0; n != 20; ++n) {
+          print ">mix" n
+          sq = seq(n == 7 ? 50000 : 2000 + rnd(8000))
+          w  = n == 7 ? length(sq) : 60 + n % 11
+          for (l = 0; l < length(sq); l += w)  print substr(sq, l+1, w)
+        }
+      else if (kind == "fa_ref") {                # Reads of a reference
+        ref = seq(100000)
+        if (part == "ref") {
+          print ">ref"
+          for (l = 0; l < length(ref); l += 60)  print substr(ref, l+1, 60)
+        }
+        else
+          for (n = 0; n != 500; ++n) {
+            print ">read" n;  print substr(ref, 1 + rnd(99000), 1000)
+          }
+      }
+    }'
+}
+
+### Print the result of a test: report NAME STATUS DESCRIPTION. 0 is OK
+function report
+{
+    if [[ $2 -eq 0 ]]; then  result=OK;  else  result=FAIL;  ((++nFail));  fi
+    printf "%-6s %-16s %s\n" $result $1 "$3"
+}
+
+### Pack and unpack: roundtrip NAME FILE [OPTION]... [-- [UNPACK_OPTION]...].
+### With "--reorder free", the reads of the output are compared sorted. With
+### EXPECT set, the output is compared with that file, for lossy options
+function roundtrip
+{
+    name=$1;  in=$2;  shift 2
+    pkOpt=()
+    while [[ $# -ne 0 && $1 != "--" ]]; do  pkOpt+=("$1");  shift;  done
+    shift
+    upOpt=("$@")
+    rm -f CRYFA_*               # Left by a run killed on timeout
+
+    timeout $TIMEOUT $CRYFA -k $KEY --trace "${pkOpt[@]}" $in \
+      > $name.cry 2> $name.trace \
+    && timeout $TIMEOUT $CRYFA -k $KEY -d "${upOpt[@]}" $name.cry \
+      > $name.out 2> /dev/null
+    ok=$?
+    grep -o "codecs=.*" $name.trace | tr ',' '\n' >> codecs
+
+    if [[ $ok -eq 0 && " ${pkOpt[*]} " == *" --reorder free "* ]]; then
+        cmp -s <(paste - - - - < $in | sort) <(paste - - - - < $name.out | sort)
+        ok=$?
+    elif [[ $ok -eq 0 ]]; then
+        cmp -s ${EXPECT:-$in} $name.out
+        ok=$?
+    fi
+    report $name $ok "${pkOpt[*]} ${upOpt[*]}"
+}
+
+### Run a command, which has to succeed and to print a line matching the
+### pattern, on stdout or stderr: check NAME PATTERN COMMAND...
+function check
+{
+    name=$1;  pattern=$2;  shift 2
+    rm -f CRYFA_*
+    timeout $TIMEOUT "$@" > $name.out 2>&1 && grep -Eq "$pattern" $name.out
+    report $name $? "/$pattern/"
+}
+
+### Run a command, which has to fail with an error matching the pattern:
+### refuse NAME PATTERN COMMAND...
+function refuse
+{
+    name=$1;  pattern=$2;  shift 2
+    rm -f CRYFA_*
+    ! timeout $TIMEOUT "$@" > $name.out 2>&1 && grep -Eq "$pattern" $name.out
+    report $name $? "fails: /$pattern/"
+}
+
+### Unpack an archive: unpack NAME ARCHIVE ORIGINAL
+function unpack
+{
+    timeout $TIMEOUT $CRYFA -k $KEY -d $2 > $1.out 2> /dev/null \
+      && cmp -s $3 $1.out
+    report $1 $? "-d"
+}
+
+### Flip the bits of bytes of a file, as a corruption: flip FILE POSITION...
+function flip
+{
+    f=$1;  shift
+    for p in "$@"; do
+        b=$(od -An -tu1 -j $p -N 1 $f)
+        printf "\\x$(printf %02x $((b ^ 255)))" \
+          | dd of=$f bs=1 seek=$p conv=notrunc 2> /dev/null
+    done
+}
+
+### Canonical k-mers of the sequences, counted here, sorted: kmers K FILE
+function kmers
+{
+    awk -v k=$1 '
+    function count(sq,    i, j, w, r) {
+      for (i = 1; i + k - 1 <= length(sq); ++i) {
+        w = substr(sq, i, k)
+        if (w ~ /[^ACGT]/)  continue
+        r = "";  for (j = k; j; --j)  r = r comp[substr(w, j, 1)]
+        ++n[w < r ? w : r]
+      }
+    }
+    BEGIN  { comp["A"]="T";  comp["C"]="G";  comp["G"]="C";  comp["T"]="A" }
+    /^@/   { fq = 1 }
+    fq     { if (FNR % 4 == 2)  count(toupper($0));  next }
+    /^>/   { count(sq);  sq = "";  next }
+           { sq = sq toupper($0) }
+    END    { count(sq);  for (w in n)  print w, n[w] }' $2 | sort
+}
+
+### K-mers of a file of --kmer-count, sorted: kmer_file FILE
+function kmer_file
+{
+    k=$(( $(od -An -tu1 -N1 $1) ))
+    od -An -tu8 -j9 -v -w16 $1 | awk -v k=$k '{
+      w = "";  c = $1
+      for (i = 0; i != k; ++i) {
+        w = substr("ACGT", c%4 + 1, 1) w;  c = int(c/4)
+      }
+      print w, $2 }' | sort
+}
+
+### Statistics of the sequences, counted here, as printed by --stats-archive,
+### with the spaces squeezed: stats FILE
+function stats
+{
+    awk '
+    function add(sq,    i) {
+      ++len[length(sq)];  ++nSeq;  nBase += length(sq)
+      for (i = 1; i <= length(sq); ++i)  ++base[substr(sq, i, 1)]
+    }
+    /^@/ && FNR == 1  { fq = 1 }
+    fq && FNR % 4 == 2 { add($0) }
+    fq && FNR % 4 == 0 { for (i = 1; i <= length($0); ++i)
+                           ++qs[substr($0, i, 1)]
+                         nQs += length($0) }
+    fq                 { next }
+    /^>/               { if (FNR > 1)  add(sq);  sq = "";  next }
+                       { sq = sq $0 }
+    END {
+      if (!fq)  add(sq)
+      for (l in len) {
+        if (nLen++ == 0 || l+0 < lo)  lo = l+0
+        if (l+0 > hi)  hi = l+0
+      }
+      printf "  Sequences %d\n  Bases %d\n", nSeq, nBase
+      printf "  Length min %d, max %d, mean %.2f\n", lo, hi, nBase / nSeq
+      printf "  Bases by symbol"
+      for (s = 33; s != 127; ++s)
+        if (base[c = sprintf("%c", s)])  printf "  %s:%d", c, base[c]
+      print ""
+      gc = base["C"] + base["G"]
+      printf "  GC %.2f%%\n", 100 * gc / (gc + base["A"] + base["T"])
+      printf "  N %.2f%%\n", 100 * base["N"] / nBase
+      print "  Length histogram"
+      if (nLen <= 32) {
+        for (l = lo; l <= hi; ++l)
+          if (len[l])  printf "  %d  %d\n", l, len[l]
+      }
+      else {
+        w = int((hi - lo) / 32) + 1
+        for (l in len)  bin[int((l - lo) / w)] += len[l]
+        for (b = 0; b != 32; ++b)
+          if (bin[b])
+            printf "  %d - %d  %d\n", lo + b*w, lo + (b+1)*w - 1, bin[b]
+      }
+      if (!fq)  exit
+      print "  Quality histogram"
+      for (s = 33; s != 127; ++s)
+        if (qs[c = sprintf("%c", s)])
+          printf "  Q%d  %d (%.2f%%)\n", s - 33, qs[c], 100 * qs[c] / nQs
+    }' $1 | tr -s ' ' | sort
+}
+
+### Reads of FASTQ which pass the filters, picked here. CR at the ends of the
+### lines are kept: pick FILE MIN_LEN MIN_MEAN_QUAL MAX_N_FRAC NAME_PATTERN
+function pick
+{
+    awk -v minLen=$2 -v minQual=$3 -v maxN=$4 -v re="$5" '
+    BEGIN  { for (c = 33; c != 127; ++c)  phred[sprintf("%c", c)] = c - 33 }
+           { rec[FNR % 4] = $0 }
+    FNR % 4 == 0 {
+      hdr = rec[1];  sq = rec[2];  qs = $0
+      sub(/\r$/, "", hdr);  sub(/\r$/, "", sq);  sub(/\r$/, "", qs)
+      len = length(qs);  sum = 0
+      for (i = 1; i <= len; ++i)  sum += phred[substr(qs, i, 1)]
+      nN = gsub(/[Nn]/, "&", sq)
+      if (len >= minLen && (minQual <= 0 || (len && sum >= minQual * len)) &&
+          nN <= maxN * length(sq) && substr(hdr, 2) ~ re)
+        print rec[1] "\n" rec[2] "\n" rec[3] "\n" $0
+    }' $1
+}
+
+### Inputs
+for kind in fq_fix fq_var fq_run fq_amp fq_il fa_ml fa_long fa_mix; do
+    gen $kind > $kind
+done
+gen fa_ref ref > ref.fa
+gen fa_ref > fa_ref
+sed 's/$/\r/' fq_var > fq_crlf
+sed 's/$/\r/' fa_ml  > fa_crlf
+sed '1000,1010s/\r$//' fq_crlf > fq_mixed     # Some lines end with LF only
+sed '1000,$s/$/\r/' fq_var > fq_lf_crlf         # LF first, then CR LF
+sed '500,$s/$/\r/'  fa_ml  > fa_lf_crlf
+printf '@r1\nACGT\n+\nIIII\n@r2\r\nAC\r\n+\r\nII\r\n' > fq_lf_crlf.tiny
+
+### Formats, with 1 and 3 threads
+for in in $ROOT/example/in.fq fq_fix fq_var fq_run fq_il fa_ml fa_long \
+          fa_mix fa_ref $DATA/s.vcf $DATA/s.sam $DATA/s.bed $DATA/s.gff $DATA/s.gtf; do
+    for t in 1 3; do  roundtrip $(basename $in).t$t $in -t $t;  done
+done
+roundtrip force.vcf $DATA/s.vcf -f
+roundtrip stop_shuffle fq_var -s
+
+### CR LF
+roundtrip fq_crlf  fq_crlf  -t 3
+roundtrip fa_crlf  fa_crlf  -t 3
+roundtrip fq_mixed fq_mixed -t 3
+roundtrip fq_lf_crlf fq_lf_crlf -t 3
+roundtrip fa_lf_crlf fa_lf_crlf -t 3
+roundtrip fq_lf_crlf.tiny fq_lf_crlf.tiny
+
+### Sizes: a line as long as a piece doesn't make the chunks of the other
+### lines small. The archive is as of the same file, wrapped
+awk '!/^>/ { while (length($0) > 60) { print substr($0, 1, 60)
+                                       $0 = substr($0, 61) } }
+     { print }' fa_mix > fa_mix.wrap
+for f in fa_mix fa_mix.wrap; do  $CRYFA -k $KEY -t 3 $f > $f.cry 2> /dev/null; done
+[[ $(wc -c < fa_mix.cry) -le $(( $(wc -c < fa_mix.wrap.cry) * 11 / 10 )) ]]
+report size.fa_mix $? "archive of fa_mix <= 1.1 x archive of it wrapped"
+
+### Memory budget: fewer lines in a chunk, then fewer threads
+check mem.lines   "^Memory budget of 65536 bytes: 8 threads, [0-9]+ lines" \
+                  $CRYFA -k $KEY -v --max-memory 64K -t 8 fq_var
+check mem.threads "^Memory budget of 4096 bytes: [1-7] threads, 4 lines" \
+                  $CRYFA -k $KEY -v --max-memory 4K -t 8 fq_var
+roundtrip mem.fq   fq_var --max-memory 64K -t 8 -- --max-memory 64K -t 8
+roundtrip mem.fa   fa_ml  --max-memory 64K -t 8 -- --max-memory 64K -t 8
+roundtrip mem.tiny fq_var --max-memory 4K  -t 3 -- --max-memory 4K  -t 3
+roundtrip mem.s    fq_var --max-memory 4K  -t 3 -s
+
+### Locks, with --stats: mutxFQ and mutxSec are taken once a chunk
+$CRYFA -k $KEY --stats -t 3 fq_var > lock.cry 2> lock.fq
+n=$(awk '/^  Chunks / { print $2 }' lock.fq)
+grep -Eq "^  mutxFQ +acquired $n, contended [0-9]+ \(" lock.fq \
+  && grep -Eq "^  mutxSec +acquired $n, " lock.fq \
+  && grep -Eq "^ +hold +<256ns:[0-9]+" lock.fq
+report lock.fq $? "--stats: a lock a chunk, with a histogram of hold times"
+check lock.fa "^  mutxFA +acquired [1-9]" $CRYFA -k $KEY --stats -t 3 fa_ml
+check lock.d  "^  mutxFQ +acquired $n, " $CRYFA -k $KEY -d --stats lock.cry
+! $CRYFA -k $KEY -t 3 fq_var 2>&1 > /dev/null | grep -q "^Lock statistics"
+report lock.off $? "no --stats: no locks"
+
+### Bytes over 127, e.g., UTF-8
+printf '##gff-version 3\nchr1\tsrc\tgene\t1\t90\t.\t+\t.\tNote=caf\xc3\xa9\n' \
+  > utf8.gff
+roundtrip utf8.gff utf8.gff
+
+### No LF at the end
+for f in s.vcf s.sam s.bed s.gff s.gtf; do
+    head -c -1 $DATA/$f > noeol.$f
+    roundtrip noeol.$f noeol.$f -t 3
+done
+for f in fq_var fq_crlf fa_ml fa_long fa_mix fa_crlf; do
+    head -c -1 $f > noeol.$f
+    roundtrip noeol.$f noeol.$f -t 3
+done
+gen fa_long | head -n 4 | head -c -1 > noeol.fa_piece   # In pieces, at the end
+roundtrip noeol.piece  noeol.fa_piece -t 2
+roundtrip noeol.keep   noeol.fq_var --reorder keep -t 3
+roundtrip noeol.free   noeol.fq_var --reorder free -t 3
+EXPECT=noeol.fq_var  roundtrip noeol.head.fq noeol.fq_var -t 3 -- --head 3000
+EXPECT=noeol.fa_ml   roundtrip noeol.head.fa noeol.fa_ml  -t 3 -- --head 20
+
+### Codecs and modes
+roundtrip deflate0   fq_var --deflate 0
+roundtrip deflate9   fq_var --deflate 9
+awk 'NR > 8000 && NR % 4 == 2 { gsub(/A/, "N") }  { print }' fq_var > fq_shift
+roundtrip reuse      fq_shift -t 1                  # 2bit picked, then not
+roundtrip max.fq     fq_var --level max
+TIMEOUT=10 \
+roundtrip max.fa     fa_ml  --level max -t 2        # Once stuck on pieces
+roundtrip max.run    fq_run --level max
+roundtrip dedup      fq_amp --dedup -t 2
+sed '2~4s/A/R/5' fq_var > fq_iupac                # Escapes of packfix
+sed '/^>/!s/C/Y/3' fa_ml > fa_iupac
+roundtrip seekable.fq  fq_iupac --seekable -t 3
+roundtrip seekable.fix fq_fix   --seekable
+roundtrip seekable.fa  fa_iupac --seekable -t 2
+roundtrip reference  fa_ref --reference ref.fa -- --reference ref.fa
+roundtrip keep       fq_var --reorder keep -t 3
+roundtrip free       fq_var --reorder free -t 3
+roundtrip keep.il    fq_il  --reorder keep -t 2
+roundtrip free.il    fq_il  --reorder free -t 2
+roundtrip keep.mixed fq_mixed --reorder keep -t 3
+roundtrip free.crlf  fq_crlf  --reorder free -t 3
+refuse reorder.fa "only for FASTQ" $CRYFA -k $KEY --reorder keep fa_ml
+refuse reorder.fa.free "only for FASTQ" $CRYFA -k $KEY --reorder free fa_ml
+roundtrip keep.mem   fq_var --reorder keep --max-memory 64K -t 3 \
+                            -- --max-memory 64K     # Buckets of the budget
+if command -v prlimit > /dev/null; then             # Few open files
+    CRYFA="prlimit --nofile=24 $CRYFA" \
+    roundtrip keep.nofile fq_var --reorder keep --max-memory 64K -t 3 \
+                                 -- --max-memory 64K
+    CRYFA="prlimit --nofile=24 $CRYFA" \
+    roundtrip free.nofile fq_il  --reorder free --max-memory 64K -t 3
+    refuse keep.fd "open files" prlimit --nofile=17 \
+           $CRYFA -k $KEY --reorder keep -t 3 fq_var
+fi
+roundtrip profile    fq_var --profile save:fq.prof
+roundtrip profiled   fq_fix --profile load:fq.prof
+
+### Analyze: the format and the estimates, with no KEY_FILE
+printf '>s caf\xc3\xa9\nACGT\n' > utf8.fa
+printf '@r caf\xc3\xa9\nACGT\n+\nIIII\n' > utf8.fq
+check analyze.fq   "^Analysis of .*\(FASTQ\)"  $CRYFA --analyze fq_var
+check analyze.fa   "^Analysis of .*\(FASTA\)"  $CRYFA --analyze fa_ml
+check analyze.est  "Compaction ratio +[0-9.]+$" $CRYFA --analyze fq_var
+check analyze.ufa  "Output size"               $CRYFA --analyze utf8.fa
+check analyze.ufq  "Output size"               $CRYFA --analyze utf8.fq
+roundtrip utf8.fa utf8.fa
+roundtrip utf8.fq utf8.fq
+check analyze.vcf  "^Analysis of .*\(VCF\)"    $CRYFA --analyze $DATA/s.vcf
+check analyze.sam  "^Analysis of .*\(SAM\)"    $CRYFA --analyze $DATA/s.sam
+check analyze.gff  "^Analysis of .*\(BED/GFF/GTF\)" \
+                                               $CRYFA --analyze $DATA/s.gff
+# Predicted size within 10% of the archive. Over 4 MB, blocks are sampled,
+# here with no line as long as a piece, which is in the file
+for i in $(seq 50); do
+    cat fa_ml;  [[ $i -eq 25 ]] && awk '/^>/ { p = /^>mix7$/ }  p' fa_mix
+done > fa_big
+grep "^#" $DATA/s.vcf > vcf_big                    # Blocks sampled, too
+for i in $(seq 500); do  grep -v "^#" $DATA/s.vcf;  done >> vcf_big
+for in in fq_var fa_mix fa_big vcf_big $DATA/s.sam $DATA/s.bed; do
+    est=$($CRYFA --analyze $in 2>&1 | awk '/^  Output size/ { print $3 }')
+    out=$($CRYFA -k $KEY -t 3 $in 2> /dev/null | wc -c)
+    [[ -n $est && $(( est * 10 )) -ge $(( out * 9 )) &&
+       $(( est * 10 )) -le $(( out * 11 )) ]]
+    report analyze.size.$(basename $in) $? "predicted $est bytes, of $out"
+done
+
+### Quality scores in bins. Phred of fq_var: 2, 10, 20, 30, 37, 40 and 41
+BINS=custom:0-9=6,10-29=20,30-93=37
+awk -v q="'" 'NR % 4 == 0 { gsub(/#/, q);  gsub(/[+5]/, "5");
+                            gsub(/[?FIJ]/, "F") }
+              { print }' fq_var > fq_var.bin
+sed 's/$/\r/' fq_var.bin > fq_crlf.bin
+EXPECT=fq_var.bin  roundtrip qual_bin       fq_var  --qual-bin $BINS -t 3
+EXPECT=fq_crlf.bin roundtrip qual_bin.crlf  fq_crlf --qual-bin $BINS -t 3
+sed '1000,1010s/\r$//' fq_crlf.bin > fq_mixed.bin
+EXPECT=fq_mixed.bin roundtrip qual_bin.mixed fq_mixed --qual-bin $BINS -t 3
+check qual_bin.ill8 "^Done"  $CRYFA -k $KEY --qual-bin illumina8 fq_crlf
+check analyze.bin   "Output size" $CRYFA --analyze --qual-bin illumina8 fq_crlf
+n=0                         # Bad maps: refused before compacting
+for map in custom: custom:0-9=5,10-93=30junk "custom:0-9=5 " custom:0-9=5, \
+           custom:0-9=5,5-40=30; do
+    refuse qual_bin.bad$((++n)) "^Error: (quality score bins|the ranges)" \
+           $CRYFA -k $KEY --qual-bin "$map" fq_var
+    ! grep -q "Compacting" qual_bin.bad$n.out
+    report qual_bin.early$n $? "\"$map\""
+done
+refuse qual_bin.fa  "only for FASTQ" $CRYFA -k $KEY --qual-bin illumina8 fa_ml
+
+### Filters on reads, with -d only. Chunks of reads which all fail
+awk 'NR % 12 == 2 { gsub(/A/, "N") }  { print }' fq_var > fq_n
+pick fq_var 120 0  1 ""                    > fq_var.len
+pick fq_var 0   25 1 ""                    > fq_var.qual
+pick fq_n   0   0  0.1 ""                  > fq_n.n
+pick fq_var 0   0  1 '^SRR002\.1[0-9]*5$'  > fq_var.name
+pick fq_n   100 20 0.1 '^SRR002\.[0-9]*7'  > fq_n.all
+EXPECT=fq_var.len  roundtrip filter.len  fq_var -t 3 -- --min-len 120
+EXPECT=fq_var.qual roundtrip filter.qual fq_var -t 3 -- --min-mean-qual 25
+EXPECT=fq_n.n      roundtrip filter.n    fq_n   -t 3 -- --max-n-frac 0.1
+EXPECT=fq_var.name roundtrip filter.name fq_var -t 3 \
+                             -- --name-regex '^SRR002\.1[0-9]*5$'
+EXPECT=fq_n.all    roundtrip filter.all  fq_n   -t 3 \
+  -- --min-len 100 --min-mean-qual 20 --max-n-frac 0.1 \
+     --name-regex '^SRR002\.[0-9]*7'
+EXPECT=fq_var.len  roundtrip filter.keep fq_var --reorder keep -t 3 \
+                             -- --min-len 120
+EXPECT=/dev/null   roundtrip filter.none fq_var -t 3 -- --min-len 1000
+pick fq_crlf  120 25 1 "" > fq_crlf.pick
+pick fq_mixed 120 25 1 "" > fq_mixed.pick
+EXPECT=fq_crlf.pick  roundtrip filter.crlf  fq_crlf  -t 3 \
+                              -- --min-len 120 --min-mean-qual 25
+EXPECT=fq_mixed.pick roundtrip filter.mixed fq_mixed -t 3 \
+                              -- --min-len 120 --min-mean-qual 25
+refuse filter.re "bad pattern of names" \
+       $CRYFA -k $KEY -d --name-regex '(' filter.len.cry
+
+### Head and sample, with -d only
+head -n 400 fq_var > fq_var.head
+awk '/^>/ && ++n > 3 { exit }  { print }' fa_ml > fa_ml.head
+EXPECT=fq_var.head roundtrip head.fq fq_var -t 3 -- --head 100
+EXPECT=fa_ml.head  roundtrip head.fa fa_ml  -t 3 -- --head 3
+head -n 1400 fq_mixed > fq_mixed.head                 # Past the LF-only lines
+EXPECT=fq_mixed.head roundtrip head.mixed fq_mixed -t 3 -- --head 350
+sed 's/$/\r/' fa_ml.head > fa_crlf.head
+EXPECT=fa_crlf.head  roundtrip head.crlf  fa_crlf  -t 3 -- --head 3
+$CRYFA -k $KEY -t 3 fq_var > sample.cry 2> /dev/null
+timeout $TIMEOUT $CRYFA -k $KEY -d --sample 0.3 sample.cry \
+  > sample.out 2> /dev/null \
+  && [[ -s sample.out && $(wc -l < sample.out) -lt $(wc -l < fq_var) ]] \
+  && ! comm -23 <(paste - - - - < sample.out | sort) \
+                <(paste - - - - < fq_var | sort) | grep -q .
+report sample $? "--sample 0.3: some of the reads, as they are"
+refuse head.pack   "only for decrypting" $CRYFA -k $KEY --head 3 fq_var
+refuse sample.pack "only for decrypting" $CRYFA -k $KEY --sample 0.5 fq_var
+refuse filter.pack "only for decrypting" $CRYFA -k $KEY --min-len 9 fq_var
+refuse head.kmer   "can't be set with" \
+       $CRYFA -k $KEY -d --head 3 --kmer-count 4 -o kmers sample.cry
+cp sample.cry corrupt.cry
+flip corrupt.cry $(seq 4000 3000 60000)  # No tag is checked, with --head
+refuse head.corrupt "wrong key, or corrupted" \
+       $CRYFA -k $KEY -d --head 3000 corrupt.cry
+
+### Packfix counted with no unpacking, as the other codecs
+$CRYFA -k $KEY -t 2 --seekable fq_iupac > seek.cry 2> /dev/null
+$CRYFA -k $KEY -t 2            fq_iupac > rank.cry 2> /dev/null
+for a in seek rank; do
+    $CRYFA -k $KEY -d --kmer-count 5 -o $a.kmer $a.cry > /dev/null 2>&1
+    $CRYFA -k $KEY -d --stats-archive $a.cry 2>&1 \
+      | grep -v "^Done\|^Statistics of" > $a.stat
+done
+cmp -s seek.kmer rank.kmer && [[ -s seek.kmer ]]
+report seekable.kmer $? "--kmer-count of a --seekable archive"
+cmp -s seek.stat rank.stat && grep -q "R:3000" seek.stat
+report seekable.stat $? "--stats-archive of a --seekable archive"
+
+### K-mers counted by --kmer-count, across chunks and the lines of FASTA
+for t in fq_var.5 fa_ml.11 fa_long.7; do
+    in=${t%.*};  k=${t#*.}
+    $CRYFA -k $KEY -t 3 $in > $t.cry 2> /dev/null
+    timeout $TIMEOUT $CRYFA -k $KEY -d -t 3 --kmer-count $k -o $t.kmer $t.cry \
+      > /dev/null 2>&1 \
+      && cmp -s <(kmers $k $in) <(kmer_file $t.kmer) \
+      && [[ $(od -An -tu8 -j1 -N8 $t.kmer) -eq $(kmers $k $in | wc -l) ]]
+    report kmer.$t $? "--kmer-count $k: the counts of $in"
+done
+
+### Statistics of --stats-archive, computed, or kept by --cache-stats
+for t in fq_var fa_ml fq_iupac; do
+    for c in computed kept; do
+        opt=();  [[ $c == kept ]] && opt=(--cache-stats)
+        $CRYFA -k $KEY -t 3 "${opt[@]}" $t > $c.$t.cry 2> /dev/null
+        timeout $TIMEOUT $CRYFA -k $KEY -d -v --stats-archive $c.$t.cry \
+          > $c.$t.out 2>&1 \
+          && cmp -s <(stats $t) \
+                    <(sed -n '/^Statistics of/,/^[^ ]/p' $c.$t.out \
+                        | grep "^  " | tr -s ' ' | sort)
+        ok=$?
+        kept=$(grep -c "^Statistics had been kept" $c.$t.out)
+        [[ $ok -eq 0 && $kept -eq $([[ $c == kept ]] && echo 1 || echo 0) ]]
+        report stats.$c.$t $? "--stats-archive of $t, $c"
+    done
+done
+
+### Archives of the baseline, with no version
+unpack v1.fa $DATA/v1.fa.cry $DATA/v1.fa
+unpack v1.fq $DATA/v1.fq.cry $ROOT/example/in.fq
+
+### Codecs used
+for codec in $CODECS; do
+    grep -q ":$codec\*" codecs
+    report codec $? $codec
+done
+
+echo "$nFail failed"
+[[ $nFail -eq 0 ]]